@@ -0,0 +1,215 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include "async_output.h"
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "utilities.h"
+
+extern int Rank,np;
+
+void SharedFileJob::commit(void) {
+	
+	// Gather the section sizes of all ranks and assign the file offsets
+	int nSections=sections.size();
+	vector<long long> sizes (nSections),allSizes (nSections*np);
+	for (int s=0;s<nSections;++s) sizes[s]=sections[s].size();
+	MPI_Allgather(&sizes[0],nSections,MPI_LONG_LONG,&allSizes[0],nSections,MPI_LONG_LONG,MPI_COMM_WORLD);
+	
+	offsets.resize(nSections);
+	long long offset=0;
+	for (int s=0;s<nSections;++s) {
+		for (int p=0;p<np;++p) {
+			if (p==Rank) offsets[s]=offset;
+			offset+=allSizes[p*nSections+s];
+		}
+	}
+	
+	// Proc 0 creates the file
+	if (Rank==0) {
+		int fd=open(fileName.c_str(),O_WRONLY | O_CREAT | O_TRUNC,S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+		if (fd<0) cerr << "[E] Output file " << fileName << " couldn't be opened" << endl;
+		else close(fd);
+	}
+	MPI_Barrier(MPI_COMM_WORLD);
+	
+	return;
+}
+
+void SharedFileJob::write(void) {
+	
+	int fd=open(fileName.c_str(),O_WRONLY);
+	if (fd<0) {
+		cerr << "[E] Output file " << fileName << " couldn't be opened on rank " << Rank << endl;
+		return;
+	}
+	for (int s=0;s<sections.size();++s) {
+		long long done=0;
+		while (done<sections[s].size()) {
+			ssize_t count=pwrite(fd,sections[s].data()+done,sections[s].size()-done,offsets[s]+done);
+			if (count<=0) {
+				cerr << "[E] Writing to output file " << fileName << " failed on rank " << Rank << endl;
+				close(fd);
+				return;
+			}
+			done+=count;
+		}
+	}
+	close(fd);
+	// Release the memory right away
+	vector<string>().swap(sections);
+	
+	return;
+}
+
+AsyncOutput::AsyncOutput() {
+	async=false;
+	running=false;
+	finished=false;
+	pthread_mutex_init(&mutex,NULL);
+}
+
+void AsyncOutput::submit(OutputJob *job) {
+	
+	if (!async) {
+		job->format();
+		job->commit();
+		job->write();
+		delete job;
+		return;
+	}
+	pending.push_back(job);
+	
+	return;
+}
+
+extern "C" void *async_output_thread(void *output) {
+	((AsyncOutput *)output)->run();
+	return NULL;
+}
+
+void AsyncOutput::run(void) {
+	
+#ifdef _OPENMP
+	// Don't compete with the solver threads
+	omp_set_num_threads(1);
+#endif
+	for (int j=0;j<writing.size();++j) writing[j]->write();
+	for (int j=0;j<formatting.size();++j) formatting[j]->format();
+	
+	pthread_mutex_lock(&mutex);
+	finished=true;
+	pthread_mutex_unlock(&mutex);
+	
+	return;
+}
+
+void AsyncOutput::start(void) {
+	
+	finished=false;
+	if (pthread_create(&thread,NULL,async_output_thread,this)!=0) {
+		// Fall back to doing the work here
+		run();
+		return;
+	}
+	running=true;
+	
+	return;
+}
+
+void AsyncOutput::join(void) {
+	
+	if (running) {
+		pthread_join(thread,NULL);
+		running=false;
+	}
+	for (int j=0;j<writing.size();++j) delete writing[j];
+	writing.clear();
+	
+	return;
+}
+
+bool AsyncOutput::busy(void) {
+	
+	pthread_mutex_lock(&mutex);
+	bool state=running && !finished;
+	pthread_mutex_unlock(&mutex);
+	
+	return state;
+}
+
+void AsyncOutput::commit_formatted(void) {
+	
+	for (int j=0;j<formatting.size();++j) formatting[j]->commit();
+	writing=formatting;
+	formatting.clear();
+	
+	return;
+}
+
+void AsyncOutput::dispatch(void) {
+	
+	if (!async) return;
+	
+	// Once every rank is done formatting, commit and start writing
+	bool commit_now=false;
+	if (!formatting.empty()) {
+		if (!pending.empty()) {
+			// Backpressure: the new jobs need to wait for the previous ones anyway
+			commit_now=true;
+		} else {
+			int done=!busy();
+			int all_done;
+			MPI_Allreduce(&done,&all_done,1,MPI_INT,MPI_MIN,MPI_COMM_WORLD);
+			commit_now=all_done;
+		}
+	}
+	if (!commit_now && pending.empty()) return;
+	
+	join();
+	if (commit_now) commit_formatted();
+	formatting=pending;
+	pending.clear();
+	start();
+	
+	return;
+}
+
+void AsyncOutput::flush(void) {
+	
+	if (!async) return;
+	
+	// Jobs already in the background are formatted once the thread is joined
+	join();
+	for (int j=0;j<pending.size();++j) {
+		pending[j]->format();
+		formatting.push_back(pending[j]);
+	}
+	pending.clear();
+	commit_formatted();
+	for (int j=0;j<writing.size();++j) writing[j]->write();
+	join();
+	
+	return;
+}
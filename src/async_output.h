@@ -0,0 +1,82 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#ifndef ASYNC_OUTPUT_H
+#define ASYNC_OUTPUT_H
+
+#include <mpi.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Output goes through jobs in three stages:
+//   constructor: snapshots the solution on the main thread (cheap copies)
+//   format:      converts the snapshot to bytes, no MPI calls
+//   commit:      collective, decides where the bytes go
+//   write:       writes the bytes to disk, no MPI calls
+// In asynchronous mode, format and write run on a background thread while the solver carries on
+
+class OutputJob {
+public:
+	virtual ~OutputJob() {}
+	virtual void format(void)=0;
+	virtual void commit(void) {}
+	virtual void write(void) {}
+};
+
+// A job whose ranks all contribute to a single file
+// Each rank formats its part as a list of sections
+// Section s of rank p goes after section s of ranks<p and after all ranks' sections<s
+class SharedFileJob : public OutputJob {
+public:
+	string fileName;
+	vector<string> sections;
+	void commit(void);
+	void write(void);
+private:
+	vector<long long> offsets;
+};
+
+class AsyncOutput {
+public:
+	bool async;
+	AsyncOutput();
+	void submit(OutputJob *job); // Collective
+	void dispatch(void); // Collective, call once every time step
+	void flush(void); // Collective, returns after everything is on disk
+	void run(void); // Background thread body
+private:
+	vector<OutputJob *> pending; // Submitted, not yet started
+	vector<OutputJob *> formatting; // Being formatted in the background
+	vector<OutputJob *> writing; // Being written in the background
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	bool running; // The background thread is started and not joined yet
+	bool finished; // The background thread is done with its work
+	void start(void);
+	void join(void);
+	bool busy(void);
+	void commit_formatted(void);
+};
+
+#endif
@@ -24,6 +24,7 @@
 #include "interpolate.h"
 #include "inputs.h"
 #include <iomanip>
+#include <algorithm>
 using namespace std;
 
 extern vector<Grid> grid;
@@ -31,35 +32,39 @@ extern InputFile input;
 
 void face_interpolation_weights(int gid) {
 
-	Interpolate interpolation; // Declare interpolation object
-	
-	interpolation.init();
+	Interpolate settings; // Options shared by the per-thread interpolation objects
 
-	if (input.section("grid",0).subsection("interpolation").get_string("method")=="wtli") interpolation.method=WTLI;
-	if (input.section("grid",0).subsection("interpolation").get_string("method")=="idw") interpolation.method=IDW;
-	if (input.section("grid",0).subsection("interpolation").get_string("method")=="simple") interpolation.method=SIMPLE;
+	if (input.section("grid",0).subsection("interpolation").get_string("method")=="wtli") settings.method=WTLI;
+	if (input.section("grid",0).subsection("interpolation").get_string("method")=="idw") settings.method=IDW;
+	if (input.section("grid",0).subsection("interpolation").get_string("method")=="simple") settings.method=SIMPLE;
 	
-	interpolation.max_stencil_size=input.section("grid",gid).subsection("interpolation").get_int("stencilsize");
-	interpolation.skewness_tolerance=input.section("grid",gid).subsection("interpolation").get_double("skewnesstolerance");
-	interpolation.dimension=grid[gid].dimension;
+	settings.max_stencil_size=input.section("grid",gid).subsection("interpolation").get_int("stencilsize");
+	settings.skewness_tolerance=input.section("grid",gid).subsection("interpolation").get_double("skewnesstolerance");
+	settings.dimension=grid[gid].dimension;
 
-	if (interpolation.max_stencil_size<1) { // Means auto based on dimension
-		if (interpolation.dimension==3) interpolation.max_stencil_size=12;
-		else if (interpolation.dimension==2) interpolation.max_stencil_size=6; 
-		else if (interpolation.dimension==1) interpolation.max_stencil_size=2;
+	if (settings.max_stencil_size<1) { // Means auto based on dimension
+		if (settings.dimension==3) settings.max_stencil_size=12;
+		else if (settings.dimension==2) settings.max_stencil_size=6; 
+		else if (settings.dimension==1) settings.max_stencil_size=2;
 	}
 	
-	if (interpolation.method==IDW) interpolation.max_stencil_size=99;
+	if (settings.method==IDW) settings.max_stencil_size=99;
 
 	int tetra_intp_count=0;		
 	int tri_intp_count=0;		
 	int line_intp_count=0;		
 	int point_intp_count=0;
 	
-	set<int> stencil;
-	set<int>::iterator sit;
 	// Loop all the faces
+	// Each thread works with its own copy of the interpolation object and stencil scratch space
+	// Every face only writes its own average map
+	#pragma omp parallel reduction(+:tetra_intp_count,tri_intp_count,line_intp_count,point_intp_count)
+	{
+	Interpolate interpolation=settings;
+	interpolation.init();
+	vector<int> stencil;
 	bool is_internal=true;
+	#pragma omp for schedule(dynamic,64)
 	for (int f=0;f<grid[gid].faceCount;++f) {
 		interpolation.point=grid[gid].face[f].centroid;
 		int c=grid[gid].face[f].parent;
@@ -76,19 +81,22 @@ void face_interpolation_weights(int gid) {
 		if (extend_stencil) {
 			// Initialize stencil to nearest neighbor cells
 			// Loop face nodes and their neighboring cells
-			for (int nc=0;nc<grid[gid].cell[c].neighborCells.size();++nc) stencil.insert(grid[gid].cell[c].neighborCells[nc]);
+			stencil.assign(grid[gid].cell[c].neighborCells.begin(),grid[gid].cell[c].neighborCells.end());
 			if (grid[gid].face[f].bc==INTERNAL_FACE) {
 				c=grid[gid].face[f].neighbor;
 				// Add neighbor cell's neighbors
-				for (int nc=0;nc<grid[gid].cell[c].neighborCells.size();++nc) stencil.insert(grid[gid].cell[c].neighborCells[nc]);
+				stencil.insert(stencil.end(),grid[gid].cell[c].neighborCells.begin(),grid[gid].cell[c].neighborCells.end());
 			}
-			// Eliminate parent and neighbor from stencil set (those were directly inserted into interpolation class stencil)
-			stencil.erase(grid[gid].face[f].parent);
-			stencil.erase(grid[gid].face[f].neighbor);
+			// Sorted and unique, same as a set
+			sort(stencil.begin(),stencil.end());
+			stencil.erase(unique(stencil.begin(),stencil.end()),stencil.end());
+			// Eliminate parent and neighbor from stencil (those were directly inserted into interpolation class stencil)
+			stencil.erase(remove(stencil.begin(),stencil.end(),grid[gid].face[f].parent),stencil.end());
+			stencil.erase(remove(stencil.begin(),stencil.end(),grid[gid].face[f].neighbor),stencil.end());
 
-			for (sit=stencil.begin();sit!=stencil.end();sit++) {
-				interpolation.stencil_indices.push_back(*sit);
-				interpolation.stencil.push_back(grid[gid].cell[*sit].centroid);
+			for (int s=0;s<stencil.size();++s) {
+				interpolation.stencil_indices.push_back(stencil[s]);
+				interpolation.stencil.push_back(grid[gid].cell[stencil[s]].centroid);
 			}
 		}
 		
@@ -126,6 +134,7 @@ void face_interpolation_weights(int gid) {
 		interpolation.flush();
 		stencil.clear();
 	}
+	}
 	
 /*	
 	cout << "[I rank=" << Rank << "] Face centers for which tetra interpolation method was used = " << tetra_intp_count << endl; 
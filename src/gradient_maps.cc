@@ -52,6 +52,8 @@ void gradient_maps(int gid) {
 	else if (input.section("grid",0).subsection("gradients").get_string("othermethod")=="lsqr") other_method=LSQR;
 	else if (input.section("grid",0).subsection("gradients").get_string("othermethod")=="greengauss") other_method=GREENGAUSS;
 
+	// Each cell only fills its own gradient map, the cost per cell varies with its stencil
+	#pragma omp parallel for schedule(dynamic,64)
 	for (int c=0;c<grid[gid].cellCount;++c) {
 		if (grid[gid].cell[c].nodes.size()==8) {
 			if (hex_method==CURVILINEAR) curvilinear_grad_map(gid,c);
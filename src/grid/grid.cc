@@ -21,6 +21,7 @@
 
 *************************************************************************/
 #include "grid.h"
+#include "setup_profiler.h"
 
 string int2str(int number) ;
 
@@ -54,30 +55,42 @@ void Grid::read(string fname, string format) {
 
 void Grid::setup(void) {
       if (Rank==0) cout << "[I] Partitioning the grid" << endl;
+	setup_profiler.start(gid,"partition");
 	partition();
       if (Rank==0) cout << "[I] Creating nodes and cells" << endl;
+	setup_profiler.start(gid,"create nodes and cells");
 	create_nodes_cells();
 	raw.node.clear();
       if (Rank==0) cout << "[I] Computing mesh dual" << endl;
+	setup_profiler.start(gid,"mesh dual");
 	mesh2dual();
       if (Rank==0) cout << "[I] Creating faces" << endl;
+	setup_profiler.start(gid,"create faces");
 	if (raw.type==CELL) create_faces();
 	else if (raw.type==FACE) create_faces2();
       if (Rank==0) cout << "[I] Creating inter-partition ghost cells" << endl;
+	setup_profiler.start(gid,"partition ghosts");
 	create_partition_ghosts();
       if (Rank==0) cout << "[I] Computing output node id's" << endl;
+	setup_profiler.start(gid,"output node ids");
 	get_volume_output_ids();
 	get_bc_output_ids();
       if (Rank==0) cout << "[I] Trimming memory" << endl;
+	setup_profiler.start(gid,"trim memory");
 	trim_memory();
       if (Rank==0) cout << "[I] Calculating areas and volumes" << endl;
+	setup_profiler.start(gid,"areas and volumes");
 	areas_volumes();
       if (Rank==0) cout << "[I] Creating boundary ghost cells" << endl;
+	setup_profiler.start(gid,"boundary ghosts");
 	create_boundary_ghosts();
       if (Rank==0) cout << "[I] MPI handshake" << endl;
+	setup_profiler.start(gid,"MPI handshake");
 	mpi_handshake();
       if (Rank==0) cout << "[I] Getting ghost geometries" << endl;
+	setup_profiler.start(gid,"ghost geometry");
 	mpi_get_ghost_geometry();
+	setup_profiler.stop();
 	return;
 }
 	
@@ -111,6 +124,9 @@ void Grid::trim_memory() {
 	raw.cellConnectivity.clear();
 	raw.bocoNodes.clear();
 	raw.bocoNameMap.clear();
+	raw.bocoFaceConnIndex.clear();
+	raw.bocoFaceConnectivity.clear();
+	raw.bocoFaceBC.clear();
 	raw.faceNodeCount.clear();
 	raw.faceConnIndex.clear();
 	raw.faceConnectivity.clear();
@@ -389,6 +405,17 @@ void Grid::write_raw(void) {
 		file.write((char*) &bc_no,int_size);
 	}
 	
+	// Boundary face elements
+	int bocoFace_count=raw.bocoFaceBC.size();
+	file.write((char*) &bocoFace_count,int_size);
+	if (bocoFace_count>0) {
+		conn_size=raw.bocoFaceConnectivity.size();
+		file.write((char*) &conn_size,int_size);
+		file.write((char*) &raw.bocoFaceConnIndex[0],bocoFace_count*int_size);
+		file.write((char*) &raw.bocoFaceBC[0],bocoFace_count*int_size);
+		file.write((char*) &raw.bocoFaceConnectivity[0],conn_size*int_size);
+	}
+	
 	file.close();
 	
 	cout << "\n[I] Wrote grid.raw file" << endl;
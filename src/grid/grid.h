@@ -64,6 +64,8 @@ public:
 	std::vector<Vec3D> node;
 	std::vector< set<int> > bocoNodes; // Node list for each boundary condition region
 	std::map<string,int> bocoNameMap;
+	// Boundary faces given as elements (if any) and the region each belongs to
+	std::vector<int> bocoFaceConnIndex,bocoFaceConnectivity,bocoFaceBC;
 
 	// Either one of the following two sets need to be filled
 	
@@ -128,6 +130,8 @@ public:
 	bool HaveNodes(int const nodelistsize, int nodelist[]) ;
 };
 
+class CacheReader;
+
 class Grid {
 public:
 	int gid;
@@ -182,12 +186,21 @@ public:
 	void mpi_get_ghost_geometry(void);
 	bool read_raw(void);
 	void write_raw(void);
+	bool read_cache(string dir,unsigned long long key);
+	bool read_cache_data(CacheReader &reader);
+	void write_cache(string dir,unsigned long long key);
+	int agglomerate(int max_levels,int target_size,vector<vector<int> > &agglomerates);
 
 	Node& cellNode(int c, int n);
 	Face& cellFace(int c, int f);
 	Node& faceNode(int f, int n);
 };
 
+// 64 bit FNV-1a hashes, used as setup cache keys
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+unsigned long long fnv1a_hash(const void *data,size_t size,unsigned long long hash=FNV_OFFSET_BASIS);
+unsigned long long file_hash(string fileName);
+
 // Custom MPI type to exhange ghost centroids
 struct mpiGeomPack {
 	int ids[2]; // contains globalId and matrix_id;
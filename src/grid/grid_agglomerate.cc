@@ -0,0 +1,152 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer 
+ 
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include "grid.h"
+
+// Graph of the control volumes on one level, connections are weighted by the shared face area
+struct AgglomerationGraph {
+	int size;
+	vector<map<int,double> > neighbors;
+};
+
+// Groups the vertices of the graph into agglomerates of up to target_size vertices
+// Agglomerates grow from a front, each time taking the free neighbor with the largest connection
+static int agglomerate_level(AgglomerationGraph &graph,int target_size,vector<int> &coarse) {
+	
+	coarse.assign(graph.size,-1);
+	vector<int> members;
+	vector<int> front;
+	int front_position=0;
+	int next_seed=0;
+	int coarse_count=0;
+	map<int,double>::iterator it;
+	
+	while (true) {
+		// Seed from the front first, so that agglomerates are formed layer by layer
+		int seed=-1;
+		while (front_position<front.size() && seed<0) {
+			if (coarse[front[front_position]]<0) seed=front[front_position];
+			front_position++;
+		}
+		while (seed<0 && next_seed<graph.size) {
+			if (coarse[next_seed]<0) seed=next_seed;
+			next_seed++;
+		}
+		if (seed<0) break;
+		
+		members.clear();
+		members.push_back(seed);
+		coarse[seed]=coarse_count;
+		while (members.size()<target_size) {
+			// Free neighbor of the agglomerate with the largest connection
+			map<int,double> candidates;
+			for (int m=0;m<members.size();++m) {
+				for (it=graph.neighbors[members[m]].begin();it!=graph.neighbors[members[m]].end();it++) {
+					if (coarse[(*it).first]<0) candidates[(*it).first]+=(*it).second;
+				}
+			}
+			if (candidates.empty()) break;
+			int best=-1;
+			double best_weight=-1.;
+			for (it=candidates.begin();it!=candidates.end();it++) {
+				if ((*it).second>best_weight) {
+					best_weight=(*it).second;
+					best=(*it).first;
+				}
+			}
+			members.push_back(best);
+			coarse[best]=coarse_count;
+		}
+		
+		// A lone vertex joins the neighboring agglomerate it is connected to the most
+		if (members.size()==1) {
+			int best=-1;
+			double best_weight=-1.;
+			for (it=graph.neighbors[seed].begin();it!=graph.neighbors[seed].end();it++) {
+				if (coarse[(*it).first]>=0 && (*it).second>best_weight) {
+					best_weight=(*it).second;
+					best=coarse[(*it).first];
+				}
+			}
+			if (best>=0) {
+				coarse[seed]=best;
+				continue;
+			}
+		}
+		
+		for (int m=0;m<members.size();++m) {
+			for (it=graph.neighbors[members[m]].begin();it!=graph.neighbors[members[m]].end();it++) {
+				if (coarse[(*it).first]<0) front.push_back((*it).first);
+			}
+		}
+		coarse_count++;
+	}
+	
+	return coarse_count;
+}
+
+// Agglomerates the local cells into coarser control volumes, level by level
+// agglomerates[l][i] is the control volume on level l+1 containing control volume i of level l
+// Level 0 control volumes are the cells. Agglomerates never cross partition boundaries, so the
+// levels follow the existing partitioning. All ranks end up with the same number of levels.
+int Grid::agglomerate(int max_levels,int target_size,vector<vector<int> > &agglomerates) {
+	
+	agglomerates.clear();
+	
+	// Fine level graph from the internal faces between local cells
+	AgglomerationGraph graph;
+	graph.size=cellCount;
+	graph.neighbors.resize(cellCount);
+	for (int f=0;f<faceCount;++f) {
+		if (face[f].bc==INTERNAL_FACE && face[f].neighbor<cellCount) {
+			graph.neighbors[face[f].parent][face[f].neighbor]+=face[f].area;
+			graph.neighbors[face[f].neighbor][face[f].parent]+=face[f].area;
+		}
+	}
+	
+	int global_size=globalCellCount;
+	for (int level=0;level<max_levels;++level) {
+		vector<int> coarse;
+		int coarse_size=agglomerate_level(graph,target_size,coarse);
+		int global_coarse_size;
+		MPI_Allreduce(&coarse_size,&global_coarse_size,1,MPI_INT,MPI_SUM,MPI_COMM_WORLD);
+		// Stop if the level hardly gets any coarser
+		if (double(global_coarse_size)>0.8*double(global_size)) break;
+		agglomerates.push_back(coarse);
+		global_size=global_coarse_size;
+		
+		// Graph of the new level
+		AgglomerationGraph coarse_graph;
+		coarse_graph.size=coarse_size;
+		coarse_graph.neighbors.resize(coarse_size);
+		map<int,double>::iterator it;
+		for (int i=0;i<graph.size;++i) {
+			for (it=graph.neighbors[i].begin();it!=graph.neighbors[i].end();it++) {
+				if (coarse[i]!=coarse[(*it).first]) coarse_graph.neighbors[coarse[i]][coarse[(*it).first]]+=(*it).second;
+			}
+		}
+		graph.neighbors.swap(coarse_graph.neighbors);
+		graph.size=coarse_size;
+	}
+	
+	return agglomerates.size();
+}
@@ -0,0 +1,501 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include "grid.h"
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+
+#define SETUP_CACHE_VERSION 1
+
+string int2str(int number) ;
+
+// Per-rank cache of the fully set up local grid
+// Every array is stored as its length (long long) followed by the raw values, padded to 8 bytes
+// Element data is stored in columns, variable length lists in compressed row form (offsets and values)
+
+struct SetupCacheHeader {
+	char magic[8]; // "FCFDSET"
+	int version;
+	int np,rank;
+	int pad;
+	unsigned long long key;
+};
+
+unsigned long long fnv1a_hash(const void *data,size_t size,unsigned long long hash) {
+	const unsigned char *bytes=(const unsigned char *)data;
+	for (size_t i=0;i<size;++i) {
+		hash^=bytes[i];
+		hash*=1099511628211ULL;
+	}
+	return hash;
+}
+
+unsigned long long file_hash(string fileName) {
+	
+	// Rank 0 hashes the file contents and broadcasts
+	int Rank;
+	MPI_Comm_rank(MPI_COMM_WORLD,&Rank);
+	unsigned long long hash=FNV_OFFSET_BASIS;
+	if (Rank==0) {
+		ifstream file;
+		file.open(fileName.c_str(),ios::in | ios::binary);
+		vector<char> chunk (1<<22);
+		while (file.good()) {
+			file.read(&chunk[0],chunk.size());
+			hash=fnv1a_hash(&chunk[0],file.gcount(),hash);
+		}
+		file.close();
+	}
+	MPI_Bcast(&hash,1,MPI_UNSIGNED_LONG_LONG,0,MPI_COMM_WORLD);
+	
+	return hash;
+}
+
+class CacheWriter {
+public:
+	ofstream file;
+	template <class T> void put(const vector<T> &values) {
+		long long size=values.size();
+		file.write((char *)&size,sizeof(long long));
+		if (size>0) file.write((char *)&values[0],size*sizeof(T));
+		long long padding=(8-(size*sizeof(T))%8)%8;
+		char zeros[8]={0,0,0,0,0,0,0,0};
+		file.write(zeros,padding);
+	}
+	template <class T> void put(const vector<vector<T> > &lists) {
+		vector<int> offsets (lists.size()+1,0);
+		vector<T> values;
+		for (int i=0;i<lists.size();++i) {
+			offsets[i+1]=offsets[i]+lists[i].size();
+			values.insert(values.end(),lists[i].begin(),lists[i].end());
+		}
+		put(offsets);
+		put(values);
+	}
+};
+
+// Reads the arrays in place from the memory mapped file
+// A read that would go past the end of the mapping clears ok and returns an empty array
+class CacheReader {
+public:
+	char *begin,*position;
+	size_t size;
+	bool ok;
+	template <class T> const T *get(long long &count) {
+		count=0;
+		size_t left=size-(position-begin);
+		if (!ok || left<sizeof(long long)) {ok=false; return NULL;}
+		memcpy(&count,position,sizeof(long long));
+		left-=sizeof(long long);
+		if (count<0 || (unsigned long long)count>left/sizeof(T)) {ok=false; count=0; return NULL;}
+		position+=sizeof(long long);
+		const T *values=(const T *)position;
+		size_t bytes=count*sizeof(T);
+		position+=min(bytes+(8-bytes%8)%8,left);
+		return values;
+	}
+	template <class T> void get(vector<T> &values) {
+		long long count;
+		const T *data=get<T>(count);
+		values.assign(data,data+count);
+	}
+	template <class T> void get(vector<vector<T> > &lists) {
+		long long count,valueCount;
+		const int *offsets=get<int>(count);
+		const T *values=get<T>(valueCount);
+		lists.clear();
+		// Offsets start at 0, don't decrease and end at the value count
+		if (!ok || count<1 || offsets[0]!=0 || offsets[count-1]!=valueCount) {ok=false; return;}
+		for (long long i=1;i<count;++i) if (offsets[i]<offsets[i-1]) {ok=false; return;}
+		lists.resize(count-1);
+		for (int i=0;i<count-1;++i) lists[i].assign(values+offsets[i],values+offsets[i+1]);
+	}
+};
+
+string cache_file_name(string dir,int Rank) {
+	return dir+"/rank_"+int2str(Rank)+".bin";
+}
+
+void Grid::write_cache(string dir,unsigned long long key) {
+	
+	mkdir("./setup_cache",S_IRWXU);
+	mkdir(dir.c_str(),S_IRWXU);
+	
+	CacheWriter writer;
+	string name=cache_file_name(dir,Rank);
+	writer.file.open((name+".tmp").c_str(),ios::out | ios::binary | ios::trunc);
+	
+	SetupCacheHeader header;
+	memset(&header,0,sizeof(header));
+	strcpy(header.magic,"FCFDSET");
+	header.version=SETUP_CACHE_VERSION;
+	header.np=np;
+	header.rank=Rank;
+	header.key=key;
+	writer.file.write((char *)&header,sizeof(header));
+	
+	vector<int> ints;
+	vector<double> doubles;
+	
+	// Grid scalars
+	int scalarInts[]={dimension,bcCount,myOffset,node_output_offset,node_bc_output_offset,nodeCount,cellCount,faceCount,
+		partition_ghosts_begin,partition_ghosts_end,globalNodeCount,global_bc_nodeCount,globalCellCount,globalFaceCount,globalNumFaceNodes};
+	ints.assign(scalarInts,scalarInts+15);
+	writer.put(ints);
+	double scalarDoubles[]={lengthScale,globalTotalVolume};
+	doubles.assign(scalarDoubles,scalarDoubles+2);
+	writer.put(doubles);
+	
+	writer.put(partitionOffset);
+	writer.put(boundary_ghosts_begin);
+	writer.put(boundary_ghosts_end);
+	writer.put(boundaryFaceCount);
+	writer.put(globalBoundaryFaceCount);
+	writer.put(boundaryFaces);
+	writer.put(boundaryNodes);
+	writer.put(sendCells);
+	writer.put(recvCells);
+	
+	// Index maps
+	writer.put(maps.cellOwner);
+	writer.put(maps.face2bc);
+	ints.clear();
+	for (map<int,int>::iterator it=maps.nodeGlobal2Local.begin();it!=maps.nodeGlobal2Local.end();it++) {
+		ints.push_back(it->first);
+		ints.push_back(it->second);
+	}
+	writer.put(ints);
+	ints.clear();
+	for (map<int,int>::iterator it=maps.cellGlobal2Local.begin();it!=maps.cellGlobal2Local.end();it++) {
+		ints.push_back(it->first);
+		ints.push_back(it->second);
+	}
+	writer.put(ints);
+	
+	vector<vector<int> > lists;
+	vector<vector<double> > weights;
+	
+	// Nodes
+	ints.resize(3*node.size());
+	doubles.resize(3*node.size());
+	for (int n=0;n<node.size();++n) {
+		ints[3*n]=node[n].globalId;
+		ints[3*n+1]=node[n].output_id;
+		ints[3*n+2]=node[n].bc_output_id;
+		for (int i=0;i<3;++i) doubles[3*n+i]=node[n][i];
+	}
+	writer.put(ints);
+	writer.put(doubles);
+	lists.resize(node.size());
+	for (int n=0;n<node.size();++n) lists[n]=node[n].cells;
+	writer.put(lists);
+	for (int n=0;n<node.size();++n) lists[n]=node[n].faces;
+	writer.put(lists);
+	weights.resize(node.size());
+	for (int n=0;n<node.size();++n) {
+		lists[n].clear();
+		weights[n].clear();
+		for (map<int,double>::iterator it=node[n].average.begin();it!=node[n].average.end();it++) {
+			lists[n].push_back(it->first);
+			weights[n].push_back(it->second);
+		}
+	}
+	writer.put(lists);
+	writer.put(weights);
+	
+	// Faces
+	ints.resize(4*face.size());
+	doubles.resize(9*face.size());
+	for (int f=0;f<face.size();++f) {
+		ints[4*f]=face[f].bc;
+		ints[4*f+1]=face[f].symmetry;
+		ints[4*f+2]=face[f].parent;
+		ints[4*f+3]=face[f].neighbor;
+		for (int i=0;i<3;++i) {
+			doubles[9*f+i]=face[f].centroid[i];
+			doubles[9*f+3+i]=face[f].normal[i];
+		}
+		doubles[9*f+6]=face[f].area;
+		doubles[9*f+7]=face[f].closest_wall_distance;
+		doubles[9*f+8]=face[f].dissipation_factor;
+	}
+	writer.put(ints);
+	writer.put(doubles);
+	lists.resize(face.size());
+	weights.resize(face.size());
+	for (int f=0;f<face.size();++f) lists[f]=face[f].nodes;
+	writer.put(lists);
+	for (int f=0;f<face.size();++f) {
+		lists[f].clear();
+		weights[f].clear();
+		for (map<int,double>::iterator it=face[f].average.begin();it!=face[f].average.end();it++) {
+			lists[f].push_back(it->first);
+			weights[f].push_back(it->second);
+		}
+	}
+	writer.put(lists);
+	writer.put(weights);
+	
+	// Cells
+	ints.resize(7*cell.size());
+	doubles.resize(6*cell.size());
+	for (int c=0;c<cell.size();++c) {
+		ints[7*c]=cell[c].type;
+		ints[7*c+1]=cell[c].globalId;
+		ints[7*c+2]=cell[c].partition;
+		ints[7*c+3]=cell[c].matrix_id;
+		ints[7*c+4]=cell[c].id_in_owner;
+		ints[7*c+5]=cell[c].bc;
+		ints[7*c+6]=0;
+		doubles[6*c]=cell[c].volume;
+		doubles[6*c+1]=cell[c].lengthScale;
+		doubles[6*c+2]=cell[c].closest_wall_distance;
+		for (int i=0;i<3;++i) doubles[6*c+3+i]=cell[c].centroid[i];
+	}
+	writer.put(ints);
+	writer.put(doubles);
+	lists.resize(cell.size());
+	weights.resize(cell.size());
+	for (int c=0;c<cell.size();++c) lists[c]=cell[c].nodes;
+	writer.put(lists);
+	for (int c=0;c<cell.size();++c) lists[c]=cell[c].faces;
+	writer.put(lists);
+	for (int c=0;c<cell.size();++c) lists[c]=cell[c].neighborCells;
+	writer.put(lists);
+	for (int c=0;c<cell.size();++c) {
+		lists[c].clear();
+		weights[c].clear();
+		for (map<int,Vec3D>::iterator it=cell[c].gradMap.begin();it!=cell[c].gradMap.end();it++) {
+			lists[c].push_back(it->first);
+			for (int i=0;i<3;++i) weights[c].push_back(it->second[i]);
+		}
+	}
+	writer.put(lists);
+	writer.put(weights);
+	
+	bool written=writer.file.good();
+	writer.file.close();
+	written=written && !writer.file.fail();
+	// Only complete files are picked up
+	if (written) rename((name+".tmp").c_str(),name.c_str());
+	else remove((name+".tmp").c_str());
+	
+	int failed=!written;
+	MPI_Allreduce(MPI_IN_PLACE,&failed,1,MPI_INT,MPI_MAX,MPI_COMM_WORLD);
+	if (Rank==0) {
+		if (failed) cout << "[W grid=" << gid+1 << " ] Could not write the setup cache to " << dir << ", next run sets up from the grid file again" << endl;
+		else cout << "[I grid=" << gid+1 << " ] Wrote setup cache to " << dir << endl;
+	}
+	
+	return;
+}
+
+bool Grid::read_cache(string dir,unsigned long long key) {
+	
+	// Check the header first, everybody rebuilds unless all ranks have a valid cache
+	string name=cache_file_name(dir,Rank);
+	int valid=0;
+	int fd=open(name.c_str(),O_RDONLY);
+	struct stat status;
+	char *mapped=NULL;
+	if (fd>=0 && fstat(fd,&status)==0 && status.st_size>=sizeof(SetupCacheHeader)) {
+		mapped=(char *)mmap(NULL,status.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+		if (mapped==MAP_FAILED) {
+			mapped=NULL;
+		} else {
+			SetupCacheHeader *header=(SetupCacheHeader *)mapped;
+			valid=(strncmp(header->magic,"FCFDSET",8)==0 && header->version==SETUP_CACHE_VERSION 
+				&& header->np==np && header->rank==Rank && header->key==key);
+		}
+	}
+	if (fd>=0) close(fd);
+	MPI_Allreduce(MPI_IN_PLACE,&valid,1,MPI_INT,MPI_MIN,MPI_COMM_WORLD);
+	if (!valid) {
+		if (mapped!=NULL) munmap(mapped,status.st_size);
+		if (Rank==0) cout << "[I grid=" << gid+1 << " ] No valid setup cache, setting up from the grid file" << endl;
+		return false;
+	}
+	
+	if (Rank==0) cout << "[I grid=" << gid+1 << " ] Loading setup cache from " << dir << endl;
+	
+	CacheReader reader;
+	reader.begin=mapped;
+	reader.size=status.st_size;
+	reader.position=mapped+sizeof(SetupCacheHeader);
+	reader.ok=true;
+	
+	int complete=read_cache_data(reader);
+	munmap(mapped,reader.size);
+	
+	// A truncated or inconsistent file on any rank makes everybody set up from the grid file
+	MPI_Allreduce(MPI_IN_PLACE,&complete,1,MPI_INT,MPI_MIN,MPI_COMM_WORLD);
+	if (!complete) {
+		partitionOffset.clear(); boundary_ghosts_begin.clear(); boundary_ghosts_end.clear();
+		boundaryFaceCount.clear(); globalBoundaryFaceCount.clear(); boundaryFaces.clear(); boundaryNodes.clear();
+		sendCells.clear(); recvCells.clear();
+		maps.cellOwner.clear(); maps.face2bc.clear(); maps.nodeGlobal2Local.clear(); maps.cellGlobal2Local.clear();
+		node.clear(); face.clear(); cell.clear();
+		if (Rank==0) cout << "[W grid=" << gid+1 << " ] Setup cache in " << dir << " is damaged, setting up from the grid file" << endl;
+		return false;
+	}
+	
+	return true;
+}
+
+bool Grid::read_cache_data(CacheReader &reader) {
+	
+	long long count;
+	const int *ints;
+	const double *doubles;
+	
+	ints=reader.get<int>(count);
+	if (!reader.ok || count!=15) return false;
+	dimension=ints[0]; bcCount=ints[1]; myOffset=ints[2];
+	node_output_offset=ints[3]; node_bc_output_offset=ints[4];
+	nodeCount=ints[5]; cellCount=ints[6]; faceCount=ints[7];
+	partition_ghosts_begin=ints[8]; partition_ghosts_end=ints[9];
+	globalNodeCount=ints[10]; global_bc_nodeCount=ints[11]; globalCellCount=ints[12]; globalFaceCount=ints[13]; globalNumFaceNodes=ints[14];
+	doubles=reader.get<double>(count);
+	if (!reader.ok || count!=2) return false;
+	lengthScale=doubles[0];
+	globalTotalVolume=doubles[1];
+	
+	reader.get(partitionOffset);
+	reader.get(boundary_ghosts_begin);
+	reader.get(boundary_ghosts_end);
+	reader.get(boundaryFaceCount);
+	reader.get(globalBoundaryFaceCount);
+	reader.get(boundaryFaces);
+	reader.get(boundaryNodes);
+	reader.get(sendCells);
+	reader.get(recvCells);
+	
+	reader.get(maps.cellOwner);
+	reader.get(maps.face2bc);
+	ints=reader.get<int>(count);
+	if (!reader.ok || count%2!=0) return false;
+	for (long long i=0;i<count;i+=2) maps.nodeGlobal2Local.insert(maps.nodeGlobal2Local.end(),pair<int,int>(ints[i],ints[i+1]));
+	ints=reader.get<int>(count);
+	if (!reader.ok || count%2!=0) return false;
+	for (long long i=0;i<count;i+=2) maps.cellGlobal2Local.insert(maps.cellGlobal2Local.end(),pair<int,int>(ints[i],ints[i+1]));
+	
+	vector<vector<int> > lists;
+	vector<vector<double> > weights;
+	
+	// Nodes
+	ints=reader.get<int>(count);
+	if (!reader.ok || count%3!=0) return false;
+	node.resize(count/3);
+	for (int n=0;n<node.size();++n) {
+		node[n].globalId=ints[3*n];
+		node[n].output_id=ints[3*n+1];
+		node[n].bc_output_id=ints[3*n+2];
+	}
+	doubles=reader.get<double>(count);
+	if (!reader.ok || count!=3*node.size()) return false;
+	for (int n=0;n<node.size();++n) for (int i=0;i<3;++i) node[n][i]=doubles[3*n+i];
+	reader.get(lists);
+	if (!reader.ok || lists.size()!=node.size()) return false;
+	for (int n=0;n<node.size();++n) node[n].cells.swap(lists[n]);
+	reader.get(lists);
+	if (!reader.ok || lists.size()!=node.size()) return false;
+	for (int n=0;n<node.size();++n) node[n].faces.swap(lists[n]);
+	reader.get(lists);
+	reader.get(weights);
+	if (!reader.ok || lists.size()!=node.size() || weights.size()!=node.size()) return false;
+	for (int n=0;n<node.size();++n) {
+		if (weights[n].size()!=lists[n].size()) return false;
+		for (int i=0;i<lists[n].size();++i) node[n].average.insert(node[n].average.end(),pair<int,double>(lists[n][i],weights[n][i]));
+	}
+	
+	// Faces
+	ints=reader.get<int>(count);
+	if (!reader.ok || count%4!=0) return false;
+	face.resize(count/4);
+	doubles=reader.get<double>(count);
+	if (!reader.ok || count!=9*face.size()) return false;
+	for (int f=0;f<face.size();++f) {
+		face[f].bc=ints[4*f];
+		face[f].symmetry=ints[4*f+1];
+		face[f].parent=ints[4*f+2];
+		face[f].neighbor=ints[4*f+3];
+		for (int i=0;i<3;++i) {
+			face[f].centroid[i]=doubles[9*f+i];
+			face[f].normal[i]=doubles[9*f+3+i];
+		}
+		face[f].area=doubles[9*f+6];
+		face[f].closest_wall_distance=doubles[9*f+7];
+		face[f].dissipation_factor=doubles[9*f+8];
+	}
+	reader.get(lists);
+	if (!reader.ok || lists.size()!=face.size()) return false;
+	for (int f=0;f<face.size();++f) face[f].nodes.swap(lists[f]);
+	reader.get(lists);
+	reader.get(weights);
+	if (!reader.ok || lists.size()!=face.size() || weights.size()!=face.size()) return false;
+	for (int f=0;f<face.size();++f) {
+		if (weights[f].size()!=lists[f].size()) return false;
+		for (int i=0;i<lists[f].size();++i) face[f].average.insert(face[f].average.end(),pair<int,double>(lists[f][i],weights[f][i]));
+	}
+	
+	// Cells
+	ints=reader.get<int>(count);
+	if (!reader.ok || count%7!=0) return false;
+	cell.resize(count/7);
+	doubles=reader.get<double>(count);
+	if (!reader.ok || count!=6*cell.size()) return false;
+	for (int c=0;c<cell.size();++c) {
+		cell[c].type=ints[7*c];
+		cell[c].globalId=ints[7*c+1];
+		cell[c].partition=ints[7*c+2];
+		cell[c].matrix_id=ints[7*c+3];
+		cell[c].id_in_owner=ints[7*c+4];
+		cell[c].bc=ints[7*c+5];
+		cell[c].volume=doubles[6*c];
+		cell[c].lengthScale=doubles[6*c+1];
+		cell[c].closest_wall_distance=doubles[6*c+2];
+		for (int i=0;i<3;++i) cell[c].centroid[i]=doubles[6*c+3+i];
+	}
+	reader.get(lists);
+	if (!reader.ok || lists.size()!=cell.size()) return false;
+	for (int c=0;c<cell.size();++c) cell[c].nodes.swap(lists[c]);
+	reader.get(lists);
+	if (!reader.ok || lists.size()!=cell.size()) return false;
+	for (int c=0;c<cell.size();++c) cell[c].faces.swap(lists[c]);
+	reader.get(lists);
+	if (!reader.ok || lists.size()!=cell.size()) return false;
+	for (int c=0;c<cell.size();++c) cell[c].neighborCells.swap(lists[c]);
+	reader.get(lists);
+	reader.get(weights);
+	if (!reader.ok || lists.size()!=cell.size() || weights.size()!=cell.size()) return false;
+	for (int c=0;c<cell.size();++c) {
+		if (weights[c].size()!=3*lists[c].size()) return false;
+		for (int i=0;i<lists[c].size();++i) {
+			cell[c].gradMap.insert(cell[c].gradMap.end(),pair<int,Vec3D>(lists[c][i],Vec3D(weights[c][3*i],weights[c][3*i+1],weights[c][3*i+2])));
+		}
+	}
+	
+	// Everything written was read back
+	return (reader.position==reader.begin+reader.size);
+}
@@ -20,10 +20,85 @@
     see <http://www.gnu.org/licenses/>.
 
 *************************************************************************/
+#include <algorithm>
 #include "grid.h"
 
 using namespace std;
 
+// Faces are identified by their sorted node list, padded with -1 up to four nodes
+struct FaceKey {
+	int nodes[4];
+};
+
+static FaceKey face_key(int count,const int *nodes) {
+	FaceKey key;
+	for (int i=0;i<4;++i) key.nodes[i]=(i<count) ? nodes[i] : -1;
+	// Insertion sort of the actual nodes
+	for (int i=1;i<count;++i) {
+		int temp=key.nodes[i];
+		int j=i-1;
+		while (j>=0 && key.nodes[j]>temp) {
+			key.nodes[j+1]=key.nodes[j];
+			--j;
+		}
+		key.nodes[j+1]=temp;
+	}
+	return key;
+}
+
+static bool operator==(const FaceKey &a,const FaceKey &b) {
+	return a.nodes[0]==b.nodes[0] && a.nodes[1]==b.nodes[1] && a.nodes[2]==b.nodes[2] && a.nodes[3]==b.nodes[3];
+}
+
+// Open addressing hash table from face keys to integer values (face index or bc)
+class FaceHashTable {
+public:
+	FaceHashTable() { reserve(0); }
+	void reserve(int count);
+	int find(const FaceKey &key) const;
+	void insert(const FaceKey &key,int value);
+private:
+	vector<FaceKey> keys;
+	vector<int> values; // -1 marks an empty slot
+	size_t mask;
+	int size;
+	size_t slot(const FaceKey &key) const;
+};
+
+void FaceHashTable::reserve(int count) {
+	size_t capacity=16;
+	while (capacity<2*size_t(count)) capacity*=2;
+	vector<FaceKey> oldKeys;
+	vector<int> oldValues;
+	oldKeys.swap(keys);
+	oldValues.swap(values);
+	keys.resize(capacity);
+	values.assign(capacity,-1);
+	mask=capacity-1;
+	size=0;
+	for (size_t i=0;i<oldValues.size();++i) if (oldValues[i]>=0) insert(oldKeys[i],oldValues[i]);
+	return;
+}
+
+size_t FaceHashTable::slot(const FaceKey &key) const {
+	size_t i=fnv1a_hash(key.nodes,sizeof(key.nodes)) & mask;
+	while (values[i]>=0 && !(keys[i]==key)) i=(i+1) & mask;
+	return i;
+}
+
+int FaceHashTable::find(const FaceKey &key) const {
+	return values[slot(key)];
+}
+
+void FaceHashTable::insert(const FaceKey &key,int value) {
+	if (2*(size+1)>values.size()) reserve(2*(size+1));
+	size_t i=slot(key);
+	if (values[i]<0) ++size;
+	keys[i]=key;
+	values[i]=value;
+	return;
+}
+
 int Grid::create_nodes_cells() {
 
 	// Reserve the right amount of memory beforehand
@@ -177,6 +252,26 @@ int Grid::create_nodes_cells() {
 		temp.clear();
 	}
 	
+	// Keep only the boundary face elements with all their nodes in this partition, in local node ids
+	vector<int> localConnIndex,localConnectivity,localBC;
+	for (int bf=0;bf<raw.bocoFaceBC.size();++bf) {
+		int end=(bf<raw.bocoFaceBC.size()-1) ? raw.bocoFaceConnIndex[bf+1] : raw.bocoFaceConnectivity.size();
+		bool local=true;
+		for (int i=raw.bocoFaceConnIndex[bf];i<end;++i) {
+			if (maps.nodeGlobal2Local.find(raw.bocoFaceConnectivity[i])==maps.nodeGlobal2Local.end()) {
+				local=false;
+				break;
+			}
+		}
+		if (!local) continue;
+		localConnIndex.push_back(localConnectivity.size());
+		localBC.push_back(raw.bocoFaceBC[bf]);
+		for (int i=raw.bocoFaceConnIndex[bf];i<end;++i) localConnectivity.push_back(maps.nodeGlobal2Local[raw.bocoFaceConnectivity[i]]);
+	}
+	raw.bocoFaceConnIndex.swap(localConnIndex);
+	raw.bocoFaceConnectivity.swap(localConnectivity);
+	raw.bocoFaceBC.swap(localBC);
+	
 	return 0;
 	
 } //end Grid::create_nodes_cells
@@ -216,53 +311,46 @@ int Grid::create_faces() {
 	// Search and construct faces
 	faceCount=0;
 	
-	// Time the face search
-	double timeRef, timeEnd;
-	if (Rank==0) timeRef=MPI_Wtime();
+	// Boundary face elements, if the grid file provides them
+	FaceHashTable bocoFaces;
+	bocoFaces.reserve(raw.bocoFaceBC.size());
+	vector<bool> bocoHasFaces (raw.bocoNameMap.size(),false);
+	vector<int> boco_nodes;
+	for (int bf=0;bf<raw.bocoFaceBC.size();++bf) {
+		int end=(bf<raw.bocoFaceBC.size()-1) ? raw.bocoFaceConnIndex[bf+1] : raw.bocoFaceConnectivity.size();
+		// Repeated nodes are dropped, the same way as for the faces of the cells below
+		boco_nodes.clear();
+		for (int i=raw.bocoFaceConnIndex[bf];i<end;++i) {
+			if (find(boco_nodes.begin(),boco_nodes.end(),raw.bocoFaceConnectivity[i])==boco_nodes.end()) {
+				boco_nodes.push_back(raw.bocoFaceConnectivity[i]);
+			}
+		}
+		if (boco_nodes.size()<3) continue; // degenerate, no matching face is created
+		bocoFaces.insert(face_key(boco_nodes.size(),&boco_nodes[0]),raw.bocoFaceBC[bf]);
+		bocoHasFaces[raw.bocoFaceBC[bf]]=true;
+	}
+	
+	// Each face is inserted once with its parent cell. When the same node tuple
+	// comes up again from another cell, that cell becomes the neighbor.
+	FaceHashTable faceTable;
+	faceTable.reserve(3*cellCount);
 	vector<int> unique_nodes;
 	set<int> repeated_node_cells;
+	vector<int> degenerate_face_count (cellCount,0);
+	int tempNodes[4];
 	// Loop through all the cells
 	for (int c=0;c<cellCount;++c) {
-		int degenerate_face_count=0;
 		// Loop through the faces of the current cell
 		for (int cf=0;cf<cell[c].faces.size();++cf) {
-			bool degenerate=false;
-			Face tempFace;
-			int *tempNodes;
+			int faceNodeCount;
 			switch (cell[c].nodes.size()) {
-				case 4: // Tetrahedra
-					tempFace.nodes.resize(3);
-					tempNodes= new int[3];
-					break;
-				case 5: // Pyramid
-					if (cf<1) {
-						tempFace.nodes.resize(4);
-						tempNodes= new int[4];
-					} else {
-						tempFace.nodes.resize(3);
-						tempNodes= new int[3];
-					}
-					break;
-				case 6: // Prism
-					if (cf<2) {
-						tempFace.nodes.resize(3);
-						tempNodes= new int[3];
-					} else {
-						tempFace.nodes.resize(4);
-						tempNodes= new int[4];
-					}
-					break;
-				case 8: // Brick 
-					tempFace.nodes.resize(4);
-					tempNodes= new int[4];
-					break;
+				case 4: faceNodeCount=3; break; // Tetrahedra
+				case 5: faceNodeCount=(cf<1) ? 4 : 3; break; // Pyramid
+				case 6: faceNodeCount=(cf<2) ? 3 : 4; break; // Prism
+				case 8: faceNodeCount=4; break; // Brick
 			}
-			// Assign current cell as the parent cell
-			tempFace.parent=c;
-			// Assign boundary type as internal by default, will be overwritten later
-			tempFace.bc=INTERNAL_FACE;
 			// Store the node local ids of the current face	
-			for (int fn=0;fn<tempFace.nodes.size();++fn) {
+			for (int fn=0;fn<faceNodeCount;++fn) {
 				switch (cell[c].nodes.size()) {
 					case 4: tempNodes[fn]=cell[c].nodes[tetraFaces[cf][fn]]; break;
 					case 5: tempNodes[fn]=cell[c].nodes[pyraFaces[cf][fn]]; break;
@@ -273,7 +361,7 @@ int Grid::create_faces() {
 			// Check if there is a repeated node
 			unique_nodes.clear();
 			bool skip;
-			for (int fn=0;fn<tempFace.nodes.size();++fn) {
+			for (int fn=0;fn<faceNodeCount;++fn) {
 				skip=false;
 				for (int i=0;i<fn;++i) {
 					if (tempNodes[fn]==tempNodes[i]) {
@@ -283,105 +371,102 @@ int Grid::create_faces() {
 				}
 				if (!skip) unique_nodes.push_back(tempNodes[fn]);
 			}
-			if (unique_nodes.size()!=tempFace.nodes.size()) {
+			if (unique_nodes.size()!=faceNodeCount) {
 				repeated_node_cells.insert(c); // mark the owner cell (it has repeated nodes)
-				if (unique_nodes.size()==2) { // If a face only has two unique nodes, mark as degenerate
-					degenerate=true;
-					degenerate_face_count++;
+				if (unique_nodes.size()==2) { // If a face only has two unique nodes, it is degenerate
+					degenerate_face_count[c]++;
+					continue;
 				}
-				tempFace.nodes.resize(unique_nodes.size());
-				for (int fn=0;fn<tempFace.nodes.size();++fn) tempNodes[fn]=unique_nodes[fn];
+				faceNodeCount=unique_nodes.size();
+				for (int fn=0;fn<faceNodeCount;++fn) tempNodes[fn]=unique_nodes[fn];
+			}
+			FaceKey key=face_key(faceNodeCount,tempNodes);
+			int f=faceTable.find(key);
+			if (f>=0) { // The face was created by a previous cell
+				if (face[f].neighbor<0) face[f].neighbor=c;
+				continue;
 			}
-			// Find the neighbor cell
-			bool internal=false;
-			bool unique=true;
+			// A new face
+			Face tempFace;
+			// Assign current cell as the parent cell
+			tempFace.parent=c;
 			tempFace.neighbor=-1;
-			// Loop cells neighboring the first node of the current face
-			for (int nc=0;nc<node[tempNodes[0]].cells.size();++nc) {
-				// i is the neighbor cell index
-				int i=node[tempNodes[0]].cells[nc];
-				// If neighbor cell is not the current cell itself, and it has the same nodes as the face
-				if (i!=c && i<cellCount && cell[i].HaveNodes(tempFace.nodes.size(),tempNodes)) {
-					// If the neighbor cell index is smaller then the current cell index,
-					// it has already been processed so skip it
-					if (i>c) {
-						tempFace.neighbor=i;
-						internal=true;
-					} else {
-						unique=false;
-					}
+			// Assign boundary type as internal by default, will be overwritten later
+			tempFace.bc=INTERNAL_FACE;
+			tempFace.nodes.assign(tempNodes,tempNodes+faceNodeCount);
+			faceTable.insert(key,face.size());
+			face.push_back(tempFace);
+			++faceCount;
+		} //for face cf
+	} // for cells c
+	
+	// Faces without a neighbor are either at inter-partition or boundary
+	for (int f=0;f<faceCount;++f) {
+		if (face[f].neighbor>=0) continue;
+		face[f].bc=UNASSIGNED_FACE; // yet
+		int bc=bocoFaces.find(face_key(face[f].nodes.size(),&face[f].nodes[0]));
+		if (bc>=0) {
+			face[f].bc=bc;
+			continue;
+		}
+		// Regions given as point lists can only be matched by their nodes
+		int c=face[f].parent;
+		vector<int> face_matched_bcs;
+		int cell_matched_bc=-1;
+		bool match;
+		for (int nbc=0;nbc<raw.bocoNameMap.size();++nbc) { // For each boundary condition region
+			if (bocoHasFaces[nbc]) continue;
+			match=true;
+			for (int i=0;i<face[f].nodes.size();++i) { // For each node of the current face
+				if (raw.bocoNodes[nbc].find(face[f].nodes[i])==raw.bocoNodes[nbc].end()) {
+					match=false;
+					break;
 				}
 			}
-			if (unique && !degenerate) { // If a new face
-				// Insert the node list
-				for (int fn=0;fn<tempFace.nodes.size();++fn) tempFace.nodes[fn]=tempNodes[fn];
-				if (!internal) { // If the face is either at inter-partition or boundary
-					tempFace.bc=UNASSIGNED_FACE; // yet
-					vector<int> face_matched_bcs;
-					int cell_matched_bc=-1;
-					bool match;
-					for (int nbc=0;nbc<raw.bocoNameMap.size();++nbc) { // For each boundary condition region
-						match=true;
-						for (int i=0;i<tempFace.nodes.size();++i) { // For each node of the current face
-							if (raw.bocoNodes[nbc].find(tempNodes[i])==raw.bocoNodes[nbc].end()) {
-								match=false;
-								break;
-							}
-						}
-						if (match) { // This means that all the face nodes are on the current bc node list
-							face_matched_bcs.push_back(nbc);
-						}
-						// There can be situations like back and front symmetry BC's in which
-						// face nodes will match more than one boundary condition
-						// Check if the owner cell has all its nodes on one of those bc's
-						// and eliminate those
-						if (cell_matched_bc==-1) {
-							match=true;
-							for (int i=0;i<cell[c].nodes.size();++i) { 
-								if (raw.bocoNodes[nbc].find(cell[c].nodes[i])==raw.bocoNodes[nbc].end()) {
-									match=false;
-									break;
-								}
-							}
-							if (match) { // This means that all the cell nodes are on the current bc node list
-								cell_matched_bc=nbc;
-							}
-						}	
-					}
-					if (face_matched_bcs.size()>1) {
-						for (int fbc=0;fbc<face_matched_bcs.size();++fbc) {
-							if(face_matched_bcs[fbc]!=cell_matched_bc) {
-								tempFace.bc=face_matched_bcs[fbc];
-								break;
-							}
-						}
-					} else if (face_matched_bcs.size()==1) {
-						tempFace.bc=face_matched_bcs[0];
-					}
-					// Some of these bc values will be overwritten later if the face is at a partition interface
-
-				} // if not internal
-				for (int i=0;i<cell[c].faces.size();++i)  {
-					if (cell[c].faces[i]<0) {
-						cell[c].faces[i]=face.size();
+			if (match) { // This means that all the face nodes are on the current bc node list
+				face_matched_bcs.push_back(nbc);
+			}
+			// There can be situations like back and front symmetry BC's in which
+			// face nodes will match more than one boundary condition
+			// Check if the owner cell has all its nodes on one of those bc's
+			// and eliminate those
+			if (cell_matched_bc==-1) {
+				match=true;
+				for (int i=0;i<cell[c].nodes.size();++i) { 
+					if (raw.bocoNodes[nbc].find(cell[c].nodes[i])==raw.bocoNodes[nbc].end()) {
+						match=false;
 						break;
 					}
 				}
-				if (internal) {
-					for (int i=0;i<cell[tempFace.neighbor].faces.size();++i) {
-						if (cell[tempFace.neighbor].faces[i]<0) {
-							cell[tempFace.neighbor].faces[i]=face.size();
-							break;
-						}
-					}
+				if (match) { // This means that all the cell nodes are on the current bc node list
+					cell_matched_bc=nbc;
+				}
+			}	
+		}
+		if (face_matched_bcs.size()>1) {
+			for (int fbc=0;fbc<face_matched_bcs.size();++fbc) {
+				if(face_matched_bcs[fbc]!=cell_matched_bc) {
+					face[f].bc=face_matched_bcs[fbc];
+					break;
 				}
-				face.push_back(tempFace);
-				++faceCount;
 			}
-			delete [] tempNodes;
-		} //for face cf
-		cell[c].faces.resize(cell[c].faces.size()-degenerate_face_count);
-	} // for cells c
+		} else if (face_matched_bcs.size()==1) {
+			face[f].bc=face_matched_bcs[0];
+		}
+		// Some of these bc values will be overwritten later if the face is at a partition interface
+	}
+	
+	// Fill in the cell face lists in face order
+	for (int c=0;c<cellCount;++c) {
+		cell[c].faces.resize(cell[c].faces.size()-degenerate_face_count[c]);
+		for (int i=0;i<cell[c].faces.size();++i) cell[c].faces[i]=-1;
+	}
+	vector<int> filled (cellCount,0);
+	for (int f=0;f<faceCount;++f) {
+		cell[face[f].parent].faces[filled[face[f].parent]++]=f;
+		if (face[f].neighbor>=0) cell[face[f].neighbor].faces[filled[face[f].neighbor]++]=f;
+	}
+	
 	// Loop cells that has repeated nodes and fix the node list
 	set<int>::iterator sit;
 	vector<int> repeated_nodes;
@@ -427,10 +512,6 @@ int Grid::create_faces() {
 	}		
  	repeated_node_cells.clear();
 	
-	if (Rank==0) {
-		timeEnd=MPI_Wtime();
-		cout << "[I] Time spent on finding faces= " << timeEnd-timeRef << " sec" << endl;
-	}
 
 	for (int f=0;f<faceCount;++f) {
 		for (int n=0;n<face[f].nodes.size();++n) faceNode(f,n).faces.push_back(f);	
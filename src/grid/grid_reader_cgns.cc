@@ -371,14 +371,18 @@ int Grid::readCGNS() {
 				} else { // If not a volume element	
 					
 					// Scan all the boundary condition regions
+					// Faces of element list regions are also kept as face elements for matching in create_faces
 					for (int nbc=0;nbc<raw.bocoNameMap.size();++nbc) {
 						if (bc_method[nbc]==ELEMENT_LIST) {
 							for (int elem=0;elem<=(elemEnd-elemStart);++elem) {
 								if (bc_element_list[nbc].find(elemStart+elem)!=bc_element_list[nbc].end()) {
+									connIndex=elem*elemNodeCount;
+									raw.bocoFaceConnIndex.push_back(raw.bocoFaceConnectivity.size());
+									raw.bocoFaceBC.push_back(nbc);
 									for (int n=0;n<elemNodeCount;++n) {
 										raw.bocoNodes[nbc].insert(zoneCoordMap[zoneIndex-1][elemNodes[connIndex+n]-1]);
+										raw.bocoFaceConnectivity.push_back(zoneCoordMap[zoneIndex-1][elemNodes[connIndex+n]-1]);
 									}
-									connIndex+=elemNodeCount;
 								}
 							}
 						}
@@ -483,6 +487,19 @@ bool Grid::read_raw(void) {
 		raw.bocoNameMap.insert(pair<string,int>(bc_name,bc_no));
 		if (Rank==0) cout << "[I] Boundary condition " << bc_name << " -> BC_" << bc_no+1 << endl;
 	}
+	
+	// Boundary face elements (older raw files end before this)
+	int bocoFace_count=0;
+	if (file.peek()!=EOF) file.read((char*) &bocoFace_count,int_size);
+	if (bocoFace_count>0) {
+		file.read((char*) &conn_size,int_size);
+		raw.bocoFaceConnIndex.resize(bocoFace_count);
+		raw.bocoFaceBC.resize(bocoFace_count);
+		raw.bocoFaceConnectivity.resize(conn_size);
+		file.read((char*) &raw.bocoFaceConnIndex[0],bocoFace_count*int_size);
+		file.read((char*) &raw.bocoFaceBC[0],bocoFace_count*int_size);
+		file.read((char*) &raw.bocoFaceConnectivity[0],conn_size*int_size);
+	}
 
 	file.close();
 	
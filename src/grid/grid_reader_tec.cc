@@ -21,259 +21,545 @@
 
 *************************************************************************/
 #include "grid.h"
-#include "kdtree.h"
+#include "utilities.h"
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
 
 void strip_white_spaces(string &data);
 void strip_quotes(string &data);
-bool is_first_numeric(ifstream &file);
 extern void StringExplode(string str, string separator, vector<string>* results);
 extern GridRawData raw;
 /*
  * Reads a tecplot grid file in FEPolhedron format
  *
+ * Rank 0 maps the file into memory and parses it, the raw data is then broadcast.
+ * The numeric blocks are split at line boundaries into chunks that are parsed by
+ * all the threads. Lines that don't start with a number are comments and skipped.
  */
 
+// Walks the numbers in a piece of the mapped file
+struct TecScanner {
+	const char *pos,*end;
+	bool line_start;
+	TecScanner(const char *begin,const char *finish) : pos(begin), end(finish), line_start(true) {}
+	// Moves to the start of the next number, returns false at the end of the range
+	bool next(void);
+	void skip(void) { while (pos<end && !isspace(*pos)) ++pos; }
+	void get(int &value);
+	void get(double &value);
+};
+
+bool TecScanner::next(void) {
+	while (pos<end) {
+		char c=*pos;
+		if (c=='\n') {
+			line_start=true;
+			++pos;
+		} else if (isspace(c)) {
+			++pos;
+		} else if (line_start && c!='-' && !isdigit(c)) {
+			// A comment or header line
+			while (pos<end && *pos!='\n') ++pos;
+		} else {
+			line_start=false;
+			return true;
+		}
+	}
+	return false;
+}
+
+void TecScanner::get(int &value) {
+	bool negative=(*pos=='-');
+	if (negative) ++pos;
+	value=0;
+	while (pos<end && isdigit(*pos)) value=10*value+(*pos++-'0');
+	if (negative) value=-value;
+	skip();
+	return;
+}
+
+void TecScanner::get(double &value) {
+	// The mapped file is not null terminated, copy the token before conversion
+	char token[64];
+	int length=0;
+	while (pos<end && !isspace(*pos) && length<63) token[length++]=*pos++;
+	token[length]='\0';
+	value=strtod(token,NULL);
+	skip();
+	return;
+}
+
+// A piece of the numeric data, starting at a line start
+struct TecChunk {
+	const char *begin,*end;
+	long long first; // global index of its first number
+	long long count;
+};
+
+// Parses numbers [first,first+count) of the chunked data into values
+template <class T> static void parse_block(vector<TecChunk> &chunks,long long first,long long count,T *values) {
+	#pragma omp parallel for schedule(dynamic)
+	for (int c=0;c<chunks.size();++c) {
+		long long begin=max(first,chunks[c].first);
+		long long end=min(first+count,chunks[c].first+chunks[c].count);
+		if (begin>=end) continue;
+		TecScanner scanner(chunks[c].begin,chunks[c].end);
+		for (long long i=chunks[c].first;i<begin;++i) { scanner.next(); scanner.skip(); }
+		for (long long i=begin;i<end;++i) {
+			scanner.next();
+			scanner.get(values[i-first]);
+		}
+	}
+	return;
+}
+
+// Returns the next line and moves past it
+static string read_line(const char *&pos,const char *end) {
+	const char *line_end=pos;
+	while (line_end<end && *line_end!='\n') ++line_end;
+	string line(pos,line_end);
+	pos=(line_end<end) ? line_end+1 : end;
+	return line;
+}
+
+// True if the first non-whitespace character from pos is a number or "-"
+static bool first_numeric(const char *pos,const char *end) {
+	while (pos<end && isspace(*pos)) ++pos;
+	return (pos<end && (*pos=='-' || isdigit(*pos)));
+}
+
+// True if the line at pos starts a new zone
+static bool zone_line(const char *pos,const char *end) {
+	while (pos<end && (*pos==' ' || *pos=='\t')) ++pos;
+	return (end-pos>=4 && strncmp(pos,"ZONE",4)==0);
+}
+
+// Splits a header line into its a=b entries
+static void header_entries(string line,vector<pair<string,string> > &entries) {
+	entries.clear();
+	// Strip white spaces in the line
+	strip_white_spaces(line);
+	// Split the line into expressions separated with commas
+	vector<string> expression;
+	StringExplode(line,",",&expression);
+	// Each expressions is in a=b or a="b" format. Now get a and b for each
+	vector<string> temp;
+	for (int i=0;i<expression.size();++i) {
+		StringExplode(expression[i],"=",&temp);
+		if (temp.size()==2) entries.push_back(pair<string,string>(temp[0],temp[1]));
+		temp.clear();
+	}
+	return;
+}
+
+// Kd-tree built once over a fixed point set by median splits, stored implicitly in the point order
+class StaticKDTree {
+public:
+	void build(vector<Vec3D> &points,vector<int> &ids);
+	int nearest(Vec3D &point);
+private:
+	vector<Vec3D> points;
+	vector<int> ids;
+	vector<int> order;
+	void build(int begin,int end,int axis);
+	void search(int begin,int end,int axis,Vec3D &point,int &best,double &best_distance);
+};
+
+struct AxisLess {
+	const vector<Vec3D> *points;
+	int axis;
+	bool operator()(int a,int b) const { return (*points)[a].comp[axis]<(*points)[b].comp[axis]; }
+};
+
+void StaticKDTree::build(vector<Vec3D> &points_in,vector<int> &ids_in) {
+	order.resize(points_in.size());
+	for (int i=0;i<order.size();++i) order[i]=i;
+	points.swap(points_in);
+	build(0,order.size(),0);
+	// Store the points in tree order
+	vector<Vec3D> sorted_points (order.size());
+	vector<int> sorted_ids (order.size());
+	for (int i=0;i<order.size();++i) {
+		sorted_points[i]=points[order[i]];
+		sorted_ids[i]=ids_in[order[i]];
+	}
+	points.swap(sorted_points);
+	ids.swap(sorted_ids);
+	order.clear();
+	return;
+}
+
+void StaticKDTree::build(int begin,int end,int axis) {
+	if (end-begin<2) return;
+	int middle=(begin+end)/2;
+	AxisLess less;
+	less.points=&points;
+	less.axis=axis;
+	nth_element(order.begin()+begin,order.begin()+middle,order.begin()+end,less);
+	build(begin,middle,(axis+1)%3);
+	build(middle+1,end,(axis+1)%3);
+	return;
+}
+
+int StaticKDTree::nearest(Vec3D &point) {
+	int best=-1;
+	double best_distance=1.e300;
+	search(0,points.size(),0,point,best,best_distance);
+	return (best<0) ? -1 : ids[best];
+}
+
+void StaticKDTree::search(int begin,int end,int axis,Vec3D &point,int &best,double &best_distance) {
+	if (begin>=end) return;
+	int middle=(begin+end)/2;
+	double distance=0.;
+	for (int i=0;i<3;++i) distance+=(points[middle].comp[i]-point.comp[i])*(points[middle].comp[i]-point.comp[i]);
+	if (distance<best_distance) {
+		best_distance=distance;
+		best=middle;
+	}
+	double offset=point.comp[axis]-points[middle].comp[axis];
+	// Search the side of the point first, the other side only if it can be closer
+	if (offset<0.) {
+		search(begin,middle,(axis+1)%3,point,best,best_distance);
+		if (offset*offset<best_distance) search(middle+1,end,(axis+1)%3,point,best,best_distance);
+	} else {
+		search(middle+1,end,(axis+1)%3,point,best,best_distance);
+		if (offset*offset<best_distance) search(begin,middle,(axis+1)%3,point,best,best_distance);
+	}
+	return;
+}
+
+template <class T> static void bcast_vector(vector<T> &values,MPI_Datatype type,int width) {
+	int size=values.size();
+	MPI_Bcast(&size,1,MPI_INT,0,MPI_COMM_WORLD);
+	values.resize(size);
+	if (size>0) MPI_Bcast(&values[0],width*size,type,0,MPI_COMM_WORLD);
+	return;
+}
+
 int Grid::readTEC() {
 
 	raw.type=FACE;
 
+	int counts[3];
+	
+	if (Rank==0) {
+		
 	int TotalNumFaceNodes,NumConnectedBoundaryFaces,TotalNumBoundaryConnections;
-	string line;
-
-	// Open the grid file
-	ifstream file;
-	file.open(fileName.c_str(),ios::in | ios::binary);	
-
+	
+	// Map the grid file
+	int fd=open(fileName.c_str(),O_RDONLY);
+	struct stat file_stat;
+	if (fd<0 || fstat(fd,&file_stat)!=0) {
+		cerr << "[E] Error reading grid file: " << fileName << endl;
+		MPI_Abort(MPI_COMM_WORLD,1);
+	}
+	size_t file_size=file_stat.st_size;
+	void *map=mmap(NULL,file_size,PROT_READ,MAP_PRIVATE,fd,0);
+	close(fd);
+	if (map==MAP_FAILED) {
+		cerr << "[E] Error mapping grid file: " << fileName << endl;
+		MPI_Abort(MPI_COMM_WORLD,1);
+	}
+	madvise(map,file_size,MADV_SEQUENTIAL);
+	const char *pos=(const char *)map;
+	const char *file_end=pos+file_size;
+	
+	vector<pair<string,string> > entries;
 	while (true)  {
 		// Break the loop if first non-whitespace character of the line is a number or "-"
-		if (is_first_numeric(file)) break;
-		
-		// Grab a line from the file
-		if (!getline(file,line)) {
+		if (first_numeric(pos,file_end)) break;
+		if (pos>=file_end) {
 			cerr << "[E] Error reading grid file: " << fileName << endl;
-			exit(1);
+			MPI_Abort(MPI_COMM_WORLD,1);
 		}
-		// Strip white spaces in the line
-		strip_white_spaces(line);
-		// Split the line into expressions separated with commas
-		vector<string> expression;
-		StringExplode(line,",",&expression);
-		// Each expressions is in a=b or a="b" format. Now get a and b for each
-		vector<string> temp;
-		for (int i=0;i<expression.size();++i) {
-			StringExplode(expression[i],"=",&temp);
-			if (temp.size()==2) { // If a=b is  found
-				if (temp[0]=="Nodes") {
-					globalNodeCount=atoi(temp[1].c_str());
-					if (Rank==0) cout << "[I] Global node count = " << globalNodeCount << endl;
-				} else if (temp[0]=="Elements") {
-					globalCellCount=atoi(temp[1].c_str());
-					if (Rank==0) cout << "[I] Global cell count = " << globalCellCount << endl;
-				} else if (temp[0]=="Faces") {
-					globalFaceCount=atoi(temp[1].c_str());
-					if (Rank==0) cout << "[I] Global face count = " << globalFaceCount << endl;
-				}  else if (temp[0]=="ZONETYPE") {
-					if (temp[1]!="FEPolyhedron") {
-						cerr << "[E] ZONETYPE=" << temp[1] << " is not supported" << endl;
-						exit(1);
-					}
-				}  else if (temp[0]=="DATAPACKING") {
-					if (temp[1]!="BLOCK") {
-						cerr << "[E] DATAPACKING=" << temp[1] << " is not supported" << endl;
-						exit(1);
-					}
-				} else if (temp[0]=="TotalNumFaceNodes") {
-					TotalNumFaceNodes=atoi(temp[1].c_str());
-					if (Rank==0) cout << "[I] TotalNumFaceNodes = " << TotalNumFaceNodes << endl;
-				} else if (temp[0]=="NumConnectedBoundaryFaces") {
-					NumConnectedBoundaryFaces=atoi(temp[1].c_str());
-					if (NumConnectedBoundaryFaces!=0) {
-						cerr << "[E] NumConnectedBoundaryFaces>0 is not supported" << endl;
-						exit(1);
-					}
-				} else if (temp[0]=="TotalNumBoundaryConnections") {
-					TotalNumBoundaryConnections=atoi(temp[1].c_str());
-					if (TotalNumBoundaryConnections!=0) {
-						cerr << "[E] TotalNumBoundaryConnections>0 is not supported" << endl;
-						exit(1);
-					}
+		header_entries(read_line(pos,file_end),entries);
+		for (int i=0;i<entries.size();++i) {
+			string &key=entries[i].first;
+			string &value=entries[i].second;
+			if (key=="Nodes") {
+				globalNodeCount=atoi(value.c_str());
+				cout << "[I] Global node count = " << globalNodeCount << endl;
+			} else if (key=="Elements") {
+				globalCellCount=atoi(value.c_str());
+				cout << "[I] Global cell count = " << globalCellCount << endl;
+			} else if (key=="Faces") {
+				globalFaceCount=atoi(value.c_str());
+				cout << "[I] Global face count = " << globalFaceCount << endl;
+			}  else if (key=="ZONETYPE") {
+				if (value!="FEPolyhedron") {
+					cerr << "[E] ZONETYPE=" << value << " is not supported" << endl;
+					MPI_Abort(MPI_COMM_WORLD,1);
+				}
+			}  else if (key=="DATAPACKING") {
+				if (value!="BLOCK") {
+					cerr << "[E] DATAPACKING=" << value << " is not supported" << endl;
+					MPI_Abort(MPI_COMM_WORLD,1);
+				}
+			} else if (key=="TotalNumFaceNodes") {
+				TotalNumFaceNodes=atoi(value.c_str());
+				cout << "[I] TotalNumFaceNodes = " << TotalNumFaceNodes << endl;
+			} else if (key=="NumConnectedBoundaryFaces") {
+				NumConnectedBoundaryFaces=atoi(value.c_str());
+				if (NumConnectedBoundaryFaces!=0) {
+					cerr << "[E] NumConnectedBoundaryFaces>0 is not supported" << endl;
+					MPI_Abort(MPI_COMM_WORLD,1);
+				}
+			} else if (key=="TotalNumBoundaryConnections") {
+				TotalNumBoundaryConnections=atoi(value.c_str());
+				if (TotalNumBoundaryConnections!=0) {
+					cerr << "[E] TotalNumBoundaryConnections>0 is not supported" << endl;
+					MPI_Abort(MPI_COMM_WORLD,1);
 				}
 			}
-			temp.clear();
 		}
-		expression.clear();
 	}
 	// Now the tecplot file header is read
+	
+	// Split the rest of the file into chunks at line boundaries
+	int nChunks=4*thread_count();
+	vector<TecChunk> chunks (nChunks);
+	size_t chunk_size=(file_end-pos)/nChunks+1;
+	const char *chunk_begin=pos;
+	for (int c=0;c<nChunks;++c) {
+		chunks[c].begin=chunk_begin;
+		const char *chunk_end=min(file_end,chunk_begin+chunk_size);
+		while (chunk_end<file_end && *(chunk_end-1)!='\n') ++chunk_end;
+		chunks[c].end=chunk_end;
+		chunk_begin=chunk_end;
+	}
+	
+	// Count the numbers in each chunk, the volume zone data ends at the first boundary zone
+	#pragma omp parallel for schedule(dynamic)
+	for (int c=0;c<nChunks;++c) {
+		const char *line=chunks[c].begin;
+		// Find the first zone line in the chunk
+		while (line<chunks[c].end && !zone_line(line,chunks[c].end)) {
+			while (line<chunks[c].end && *line!='\n') ++line;
+			if (line<chunks[c].end) ++line;
+		}
+		chunks[c].end=line;
+		TecScanner scanner(chunks[c].begin,chunks[c].end);
+		chunks[c].count=0;
+		while (scanner.next()) {
+			scanner.skip();
+			chunks[c].count++;
+		}
+	}
+	const char *zone_begin=file_end;
+	for (int c=0;c<nChunks;++c) {
+		chunks[c].first=(c==0) ? 0 : chunks[c-1].first+chunks[c-1].count;
+		if (chunks[c].end<((c<nChunks-1) ? chunks[c+1].begin : file_end)) {
+			zone_begin=chunks[c].end;
+			chunks.resize(c+1);
+			break;
+		}
+	}
+	
 	// Read the node coordinates
-	if (Rank==0) cout << "[I] Reading node coordinates" << endl;
+	cout << "[I] Reading node coordinates" << endl;
+	long long first=0;
+	vector<double> coordinates (3*globalNodeCount);
+	parse_block(chunks,first,3*globalNodeCount,&coordinates[0]);
+	first+=3*globalNodeCount;
 	raw.node.resize(globalNodeCount);
-	for (int i=0;i<3;++i) for (int n=0;n<globalNodeCount;++n) file >> raw.node[n][i];
+	for (int i=0;i<3;++i) for (int n=0;n<globalNodeCount;++n) raw.node[n][i]=coordinates[i*globalNodeCount+n];
+	coordinates.clear();
 
-	// Skip the comment line
-	if (!is_first_numeric(file)) getline(file,line);
 	// Read number of nodes for each face
-	if (Rank==0) cout << "[I] Reading node counts for each face" << endl;
+	cout << "[I] Reading node counts for each face" << endl;
 	raw.faceNodeCount.resize(globalFaceCount);
 	raw.faceConnIndex.resize(globalFaceCount);
+	parse_block(chunks,first,globalFaceCount,&raw.faceNodeCount[0]);
+	first+=globalFaceCount;
 	int faceNodeListSize=0;
 	for (int f=0;f<globalFaceCount;++f) {
-		file >> raw.faceNodeCount[f];
 		raw.faceConnIndex[f]=faceNodeListSize;
 		faceNodeListSize+=raw.faceNodeCount[f];
 	}
 
-
-	// Skip the comment line
-	if (!is_first_numeric(file)) getline(file,line);
 	// Read the node list for each face 
-	if (Rank==0) cout << "[I] Reading node lists for each face" << endl;
+	cout << "[I] Reading node lists for each face" << endl;
 	raw.faceConnectivity.resize(faceNodeListSize);
-	for (int i=0;i<faceNodeListSize;++i) file >> raw.faceConnectivity[i];
-	// Reduce indexing to start from 0
-	for (int i=0;i<faceNodeListSize;++i) raw.faceConnectivity[i]--;
+	parse_block(chunks,first,faceNodeListSize,&raw.faceConnectivity[0]);
+	first+=faceNodeListSize;
 
 	// Read the left and right neighbors for each face
-	// Skip the comment line
-	if (!is_first_numeric(file)) getline(file,line);
-	if (Rank==0) cout << "[I] Reading the left neighbors for each face" << endl;
+	cout << "[I] Reading the left and right neighbors for each face" << endl;
 	raw.left.resize(globalFaceCount);
-	for (int f=0;f<globalFaceCount;++f) file >> raw.left[f]; 
-	if (!is_first_numeric(file)) getline(file,line);
-	if (Rank==0) cout << "[I] Reading the right neighbors for each face" << endl;
 	raw.right.resize(globalFaceCount);
-	for (int f=0;f<globalFaceCount;++f) file >> raw.right[f]; 
+	parse_block(chunks,first,globalFaceCount,&raw.left[0]);
+	first+=globalFaceCount;
+	parse_block(chunks,first,globalFaceCount,&raw.right[0]);
+	first+=globalFaceCount;
+	
+	if (chunks.back().first+chunks.back().count<first) {
+		cerr << "[E] Error reading grid file: " << fileName << endl;
+		MPI_Abort(MPI_COMM_WORLD,1);
+	}
+	
 	// Reduce indexing to start from 0
+	#pragma omp parallel for
+	for (int i=0;i<faceNodeListSize;++i) raw.faceConnectivity[i]--;
+	#pragma omp parallel for
 	for (int f=0;f<globalFaceCount;++f) {raw.right[f]--; raw.left[f]--;}
 
-	// Create a kdtree and insert all the nodes that lie in the boundaries
-	kdtree *kd;
-	kdres *kdres; // results
-	int *data;
-	kd = kd_create(3);	
-
-	if (Rank==0) cout << "[I] Inserting boundary nodes to kdtree" << endl;	
+	// Build a kdtree of all the nodes that lie in the boundaries
+	cout << "[I] Building kdtree of boundary nodes" << endl;	
+	vector<bool> boundary_node (globalNodeCount,false);
 	for (int f=0;f<globalFaceCount;++f) {
 		if (raw.right[f]<0 || raw.left[f]<0) { // Boundary face
-			// Insert all nodes of the face to kdtree
-			int n;
-			for (int fn=0;fn<raw.faceNodeCount[f];++fn) {
-				n=raw.faceConnectivity[raw.faceConnIndex[f]+fn];
-				data=&raw.faceConnectivity[raw.faceConnIndex[f]+fn];
-				kd_insert3(kd,raw.node[n][0],raw.node[n][1],raw.node[n][2],data);	
-			}
+			for (int fn=0;fn<raw.faceNodeCount[f];++fn) boundary_node[raw.faceConnectivity[raw.faceConnIndex[f]+fn]]=true;
+		}
+	}
+	vector<Vec3D> tree_points;
+	vector<int> tree_ids;
+	for (int n=0;n<globalNodeCount;++n) {
+		if (boundary_node[n]) {
+			tree_points.push_back(raw.node[n]);
+			tree_ids.push_back(n);
 		}
 	}
+	boundary_node.clear();
+	StaticKDTree kd;
+	kd.build(tree_points,tree_ids);
 
 	// Read Each Boundary Zone
 	int bc_count=0;
-	bool line_grabbed=false;
-	while (true) {
+	pos=zone_begin;
+	while (pos<file_end) {
 		int bcNodeCount=0;
 		// Read header
-		while (true)  {
-			if (is_first_numeric(file)) break;
-			// Grab a line from the file
-			if (!line_grabbed) {
-				if (!getline(file,line)) {
-					cerr << "[E] Error reading grid file: " << fileName << endl;
-					exit(1);
-				}
+		while (!first_numeric(pos,file_end))  {
+			if (pos>=file_end) {
+				cerr << "[E] Error reading grid file: " << fileName << endl;
+				MPI_Abort(MPI_COMM_WORLD,1);
 			}
-			line_grabbed=false;
-			// Strip white spaces in the line
-			strip_white_spaces(line);
-			// Split the line into expressions separated with commas
-			vector<string> expression;
-			StringExplode(line,",",&expression);
-			// Each expressions is in a=b or a="b" format. Now get a and b for each
-			vector<string> temp;
-			for (int i=0;i<expression.size();++i) {
-				StringExplode(expression[i],"=",&temp);
-				if (temp.size()==2) { // If a=b is  found
-					if (temp[0]=="ZONET") {
-						strip_quotes(temp[1]);
-						raw.bocoNameMap.insert(pair<string,int>(temp[1],bc_count));
-						bc_count++;
-						if (Rank==0) cout << "[I] Found BC_" << bc_count << " :" << temp[1] << endl;
-					} else if (temp[0]=="Nodes") {
-						bcNodeCount=atoi(temp[1].c_str());
-						if (Rank==0) cout << "[I] BC_" << bc_count << " node count = " << bcNodeCount << endl;
-					}
+			header_entries(read_line(pos,file_end),entries);
+			for (int i=0;i<entries.size();++i) {
+				if (entries[i].first=="ZONET") {
+					strip_quotes(entries[i].second);
+					raw.bocoNameMap.insert(pair<string,int>(entries[i].second,bc_count));
+					bc_count++;
+					cout << "[I] Found BC_" << bc_count << " :" << entries[i].second << endl;
+				} else if (entries[i].first=="Nodes") {
+					bcNodeCount=atoi(entries[i].second.c_str());
+					cout << "[I] BC_" << bc_count << " node count = " << bcNodeCount << endl;
 				}
-				temp.clear();
 			}
-			expression.clear();
 		}
 	
 		// Now the BC zone header is read
 		// Read the BC node coordinates
-		if (Rank==0) cout << "[I] Reading BC_" << bc_count << " node coordinates" << endl;
+		cout << "[I] Reading BC_" << bc_count << " node coordinates" << endl;
 		vector<Vec3D> bcnodes;
 		bcnodes.resize(bcNodeCount);
-		for (int i=0;i<3;++i) for (int n=0;n<bcNodeCount;++n) file >> bcnodes[n][i];
+		TecScanner scanner(pos,file_end);
+		for (int i=0;i<3;++i) for (int n=0;n<bcNodeCount;++n) {
+			if (!scanner.next()) {
+				cerr << "[E] Error reading grid file: " << fileName << endl;
+				MPI_Abort(MPI_COMM_WORLD,1);
+			}
+			scanner.get(bcnodes[n][i]);
+		}
+		pos=scanner.pos;
 		
 		// Search kdtree to find global node number
-		if (Rank==0) cout << "[I] Searching kdtree to find BC_" << bc_count << " global node numbers" << endl;
+		cout << "[I] Searching kdtree to find BC_" << bc_count << " global node numbers" << endl;
 		raw.bocoNodes.resize(bc_count);
-		for (int n=0;n<bcNodeCount;++n) {
-			kdres = kd_nearest3(kd,bcnodes[n][0],bcnodes[n][1],bcnodes[n][2]);
-			data=(int *)kd_res_item_data(kdres);
-			raw.bocoNodes[bc_count-1].insert(*data);	
-		}
+		vector<int> found (bcNodeCount);
+		#pragma omp parallel for
+		for (int n=0;n<bcNodeCount;++n) found[n]=kd.nearest(bcnodes[n]);
+		for (int n=0;n<bcNodeCount;++n) raw.bocoNodes[bc_count-1].insert(found[n]);
 		// Empty bcnodes array
 		bcnodes.clear();
 		// Seek until another ZONE statement or EOF is reached
-		while (true) {
-			getline(file,line);
-			strip_white_spaces(line);
-			line_grabbed=true;
-			if (line.substr(0,4)=="ZONE") break;
-			if (file.eof()) break;
-		}
-		
-		if (file.eof()) break;
+		read_line(pos,file_end);
+		while (pos<file_end && !zone_line(pos,file_end)) read_line(pos,file_end);
 	}
 
-	// Destroy the kdtree
-	kd_res_free(kdres);
-	kd_free(kd);
-	// Close the grid file
-	file.close();
-
-	globalNumFaceNodes=raw.faceConnectivity.size();
+	// Unmap the grid file
+	munmap(map,file_size);
 
 	// Now fill in cell connectivity (needed for partitioning)
-	// Declare a temporary set of nodes for each cell
-	vector<set<int> > cellnodes;
-	cellnodes.resize(globalCellCount);
+	// Collect the nodes of each cell from its faces, then sort and remove the duplicates
+	vector<int> cell_count (globalCellCount+1,0);
+	for (int f=0;f<globalFaceCount;++f) {
+		if (raw.left[f]>=0)  cell_count[raw.left[f]+1]+=raw.faceNodeCount[f];
+		if (raw.right[f]>=0) cell_count[raw.right[f]+1]+=raw.faceNodeCount[f];
+	}
+	for (int c=0;c<globalCellCount;++c) cell_count[c+1]+=cell_count[c];
+	vector<int> cellnodes (cell_count[globalCellCount]);
+	vector<int> filled (cell_count.begin(),cell_count.end()-1);
 	for (int f=0;f<globalFaceCount;++f) {
-		int ibegin=raw.faceConnIndex[f];
-		int iend;
-		if (f<globalFaceCount) iend=raw.faceConnIndex[f+1]-1;
-		else iend=raw.faceConnectivity.size();
-		for (int i=ibegin;i<=iend;++i) {
-			if (raw.left[f]>=0)  cellnodes[raw.left[f]].insert(raw.faceConnectivity[i]);
-			if (raw.right[f]>=0) cellnodes[raw.right[f]].insert(raw.faceConnectivity[i]);
+		for (int i=raw.faceConnIndex[f];i<raw.faceConnIndex[f]+raw.faceNodeCount[f];++i) {
+			if (raw.left[f]>=0)  cellnodes[filled[raw.left[f]]++]=raw.faceConnectivity[i];
+			if (raw.right[f]>=0) cellnodes[filled[raw.right[f]]++]=raw.faceConnectivity[i];
 		}
 	}
+	#pragma omp parallel for
+	for (int c=0;c<globalCellCount;++c) {
+		sort(cellnodes.begin()+cell_count[c],cellnodes.begin()+cell_count[c+1]);
+		filled[c]=unique(cellnodes.begin()+cell_count[c],cellnodes.begin()+cell_count[c+1])-cellnodes.begin()-cell_count[c];
+	}
 	
-	// Count the entries needed for cell connectivities
-	int cell_conn_count=0;
-	for (int c=0;c<globalCellCount;++c) cell_conn_count+=cellnodes[c].size();
-
-	raw.cellConnectivity.resize(cell_conn_count);
-	raw.cellConnIndex.resize(globalCellCount);
 	// Fill in the cell connectivity array
-	set<int>::iterator sit;
-	int count=0;
+	raw.cellConnIndex.resize(globalCellCount);
+	raw.cellConnectivity.clear();
 	for (int c=0;c<globalCellCount;++c) {
-		raw.cellConnIndex[c]=count;
-		for (sit=cellnodes[c].begin();sit!=cellnodes[c].end();sit++) {
-			raw.cellConnectivity[count]=*sit;
-			count++;
+		raw.cellConnIndex[c]=raw.cellConnectivity.size();
+		raw.cellConnectivity.insert(raw.cellConnectivity.end(),cellnodes.begin()+cell_count[c],cellnodes.begin()+cell_count[c]+filled[c]);
+	}
+	
+	counts[0]=globalNodeCount;
+	counts[1]=globalCellCount;
+	counts[2]=globalFaceCount;
+	
+	} // if Rank==0
+	
+	// Send the raw data to the other ranks
+	MPI_Bcast(counts,3,MPI_INT,0,MPI_COMM_WORLD);
+	globalNodeCount=counts[0];
+	globalCellCount=counts[1];
+	globalFaceCount=counts[2];
+	bcast_vector(raw.node,MPI_DOUBLE,3);
+	bcast_vector(raw.faceNodeCount,MPI_INT,1);
+	bcast_vector(raw.faceConnIndex,MPI_INT,1);
+	bcast_vector(raw.faceConnectivity,MPI_INT,1);
+	bcast_vector(raw.left,MPI_INT,1);
+	bcast_vector(raw.right,MPI_INT,1);
+	bcast_vector(raw.cellConnIndex,MPI_INT,1);
+	bcast_vector(raw.cellConnectivity,MPI_INT,1);
+	
+	int bc_count=raw.bocoNameMap.size();
+	MPI_Bcast(&bc_count,1,MPI_INT,0,MPI_COMM_WORLD);
+	raw.bocoNodes.resize(bc_count);
+	map<string,int>::iterator mit=raw.bocoNameMap.begin();
+	for (int b=0;b<bc_count;++b) {
+		// Boundary name and index
+		string name;
+		int bc_no;
+		if (Rank==0) {
+			name=(*mit).first;
+			bc_no=(*mit).second;
+			mit++;
 		}
+		vector<char> name_chars (name.begin(),name.end());
+		bcast_vector(name_chars,MPI_CHAR,1);
+		MPI_Bcast(&bc_no,1,MPI_INT,0,MPI_COMM_WORLD);
+		if (Rank!=0) raw.bocoNameMap.insert(pair<string,int>(string(name_chars.begin(),name_chars.end()),bc_no));
+		// Boundary nodes
+		vector<int> nodes (raw.bocoNodes[b].begin(),raw.bocoNodes[b].end());
+		bcast_vector(nodes,MPI_INT,1);
+		if (Rank!=0) raw.bocoNodes[b].insert(nodes.begin(),nodes.end());
 	}
 
+	globalNumFaceNodes=raw.faceConnectivity.size();
+
 	return 1;
 }
 
@@ -296,21 +582,3 @@ void strip_quotes(string &data) {
         }
 	return;
 }
-
-bool is_first_numeric(ifstream &file) {
-
-	char c='\0';
-	int pos=0;
-	pos=file.tellg();
-	c=file.peek();
-	while(isspace(c)) {
-		file.seekg(pos++);
-		c=file.peek();
-	}
-	if (c=='-' || isdigit(c)) {
-		return true;
-	}
-
-	return false;
-}
-
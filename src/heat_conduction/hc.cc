@@ -35,6 +35,7 @@ void HeatConduction::initialize (void) {
 	abstol=input.section("grid",gid).subsection("heatconduction").get_double("absolutetolerance");
 	// Max linear solver iterations
 	maxits=input.section("grid",gid).subsection("heatconduction").get_int("maximumiterations");
+	assemble_jacobian=true;
 
 	mpi_init();
 	material.set(gid);
@@ -52,7 +53,8 @@ void HeatConduction::initialize (void) {
 void HeatConduction::solve (int ts) {
 	
 	timeStep=ts;
-	initialize_linear_system();
+	assemble_jacobian=!(reuse_operator && operator_current());
+	if (assemble_jacobian) initialize_linear_system();
 	assemble_linear_system();
 	petsc_solve();
 	update_variables();
@@ -63,6 +65,28 @@ void HeatConduction::solve (int ts) {
 	return;
 }
 
+bool HeatConduction::operator_current(void) {
+	
+	int changed=0,global_changed;
+	if (operator_dt.size()!=grid[gid].cellCount) {
+		changed=1;
+		operator_dt.resize(grid[gid].cellCount);
+	} else {
+		for (int c=0;c<grid[gid].cellCount;++c) {
+			if (operator_dt[c]!=dt[gid].cell(c)) {
+				changed=1;
+				break;
+			}
+		}
+	}
+	MPI_Allreduce(&changed,&global_changed,1,MPI_INT,MPI_MAX,MPI_COMM_WORLD);
+	
+	if (global_changed==0) return true;
+	for (int c=0;c<grid[gid].cellCount;++c) operator_dt[c]=dt[gid].cell(c);
+	
+	return false;
+}
+
 void HeatConduction::create_vars (void) {
 	// Allocate variables
 	// Default option is to store on cell centers and ghosts only
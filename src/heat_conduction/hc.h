@@ -29,12 +29,14 @@
 #include "grid.h"
 #include "inputs.h"
 #include "variable.h"
+#include "restart_file.h"
 #include "utilities.h"
 #include "bc.h"
 #include "hc_state_cache.h"
 #include "commons.h"
 #include "bc_interface.h"
 #include "material.h"
+#include "linear_solver.h"
 
 extern InputFile input;
 extern vector<Grid> grid;
@@ -51,6 +53,7 @@ public:
 	int timeStep;
 	int nIter;
 	double rNorm,res;
+	double linear_reduction; // achieved by the last linear solve
 
 	// MPI exchange buffer
 	vector<double> sendBuffer;
@@ -64,6 +67,13 @@ public:
 	int maxits;
 	double sqrt_machine_error;
 	
+	// With constant material properties the operator only changes with the time step.
+	// It is then assembled and its preconditioner set up once, later steps only
+	// rebuild the right hand side.
+	bool reuse_operator;
+	bool assemble_jacobian; // false while the assembled operator is still current
+	vector<double> operator_dt; // time step the operator was assembled with
+	
 	// Total residuals
 	double first_residual;
 
@@ -76,6 +86,9 @@ public:
 	
 	// PETSC variables
 	KSP ksp; // linear solver context
+	KrylovRecycler recycler;
+	ForcingTerm forcing;
+	InitialGuess initial_guess;
 	Vec deltaU,rhs; // solution, residual vectors
 	Mat impOP; // implicit operator matrix
 	
@@ -97,6 +110,7 @@ public:
 	void solve(int timeStep);
 	
 	void initialize_linear_system();
+	bool operator_current(void);
 	void assemble_linear_system(void);
 
 	void get_jacobians(void);
@@ -118,8 +132,8 @@ public:
 	void symmetry(HC_Cell_State &left,HC_Cell_State &right,HC_Face_State &face);
 	
 	void update_variables(void);
-	void write_restart(int timeStep);
-	void read_restart(int restart_step,vector<vector<int> > &partitionMap);
+	void write_restart(RestartFile &restart);
+	void read_restart(RestartFile &restart);
 };
 
 #endif
@@ -95,6 +95,8 @@ void HeatConduction::assemble_linear_system(void) {
 		}
 
 		//if (implicit) { // TODO: Get this working
+		
+		if (!assemble_jacobian) continue;
 
 		sourceJacLeft=0.;
 		sourceJacRight=0.;
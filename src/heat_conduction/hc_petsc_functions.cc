@@ -70,9 +70,20 @@ void HeatConduction::petsc_init(void) {
 	KSPSetOperators(ksp,impOP,impOP,SAME_NONZERO_PATTERN);
 	KSPSetTolerances(ksp,rtol,abstol,1.e15,maxits);
 	KSPSetInitialGuessKnoll(ksp,PETSC_TRUE);
-	KSPSetType(ksp,KSPFGMRES);
-	KSPGMRESSetRestart(ksp,100);
+	set_linear_solver_options(ksp,gid,"heatconduction","hc"+int2str(gid+1)+"_");
+	// Heat flux is linear in T for constant conductivity and Cp. Solid density is a
+	// single input value with no model, so it can't make the operator depend on T.
+	// The operator is a finite difference Jacobian, not exactly symmetric, so the
+	// Krylov solver is left to the input (cg can be chosen there)
+	reuse_operator=(input.section("grid",gid).subsection("heatconduction").get_string("operatorreuse")=="auto"
+			&& material.lambda_model==CONSTANT && material.Cp_model==CONSTANT);
+	if (reuse_operator) {
+		if (Rank==0) cout << "[I grid=" << gid+1 << " ] Heat conduction operator is constant, it is reused until the time step changes" << endl;
+	}
 	KSPSetFromOptions(ksp);
+	recycler.init(gid,"heatconduction",impOP);
+	initial_guess.init(gid,"heatconduction",impOP);
+	forcing.init(gid,"heatconduction",rtol);
 	
 	return;
 } 
@@ -85,11 +96,24 @@ void HeatConduction::petsc_solve(void) {
 	VecAssemblyBegin(rhs);
 	VecAssemblyEnd(rhs);
 	
-	KSPSetOperators(ksp,impOP,impOP,SAME_NONZERO_PATTERN);
-	KSPSolve(ksp,rhs,deltaU);
+	// Rhs is the nonlinear residual the linear tolerance is adapted to
+	PetscReal rhs_norm;
+	VecNorm(rhs,NORM_2,&rhs_norm);
+	KSPSetTolerances(ksp,forcing.tolerance(rhs_norm),abstol,1.e15,maxits);
 	
-	KSPGetIterationNumber(ksp,&nIter);
-	KSPGetResidualNorm(ksp,&rNorm); 
+	// An unchanged operator keeps its preconditioner (factorization, multigrid hierarchy)
+	MatStructure structure=(assemble_jacobian) ? SAME_NONZERO_PATTERN : SAME_PRECONDITIONER;
+	initial_guess.guess(ksp,rhs,deltaU,timeStep,true);
+	if (recycler.active()) {
+		recycler.solve(ksp,rhs,deltaU,nIter,rNorm,structure);
+	} else {
+		KSPSetOperators(ksp,impOP,impOP,structure);
+		KSPSolve(ksp,rhs,deltaU);
+		KSPGetIterationNumber(ksp,&nIter);
+		KSPGetResidualNorm(ksp,&rNorm); 
+	}
+	linear_reduction=(rhs_norm>0.) ? rNorm/rhs_norm : 0.;
+	initial_guess.store(deltaU,nIter);
 	
 	int index;
 	for (int c=0;c<grid[gid].cellCount;++c) {
@@ -104,6 +128,8 @@ void HeatConduction::petsc_solve(void) {
 
 void HeatConduction::petsc_destroy(void) {
 	KSPDestroy(ksp);
+	recycler.destroy();
+	initial_guess.destroy();
 	MatDestroy(impOP);
 	VecDestroy(rhs);
 	VecDestroy(deltaU);
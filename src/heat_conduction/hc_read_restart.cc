@@ -22,12 +22,10 @@
 *************************************************************************/
 #include "hc.h"
 
-void HeatConduction::read_restart(int restart_step,vector<vector<int> > &partitionMap) {
+void HeatConduction::read_restart(RestartFile &restart) {
 
-	string dirname="./restart/"+int2str(restart_step)+"/";
-	string gs="."+int2str(gid+1);
-	
-	T.read_cell_data(dirname+"T"+gs,partitionMap);
+	first_residual=restart.header.first_residuals[5];
+	restart.read("T",T);
 
 	mpi_update_ghost_primitives();
 	calc_cell_grads();
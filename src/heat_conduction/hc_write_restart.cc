@@ -22,11 +22,10 @@
 *************************************************************************/
 #include "hc.h"
 
-void HeatConduction::write_restart(int timeStep) {
+void HeatConduction::write_restart(RestartFile &restart) {
 
-	string dirname="./restart/"+int2str(timeStep)+"/";
-	string gs="."+int2str(gid+1);
-	T.dump_cell_data(dirname+"T"+gs);
+	restart.header.first_residuals[5]=first_residual;
+	restart.add("T",T);
 	
 }
 
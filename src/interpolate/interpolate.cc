@@ -22,13 +22,48 @@
 *************************************************************************/
 #include "interpolate.h"
 
+// Gaussian elimination with row swapping on zero pivots, for the fixed size systems below
+// Returns 1 if the system is singular
+template <int N> static int gelim(double (&a)[N][N],double (&b)[N],double (&x)[N]) {
+	
+	double tmp,pvt;
+	int i,j,k;
+	
+	for (i=0;i<N;i++) {
+		pvt=a[i][i];
+		if (fabs(pvt)<EPS) {
+			for (j=i+1;j<N;j++) {
+				if (fabs(pvt=a[j][i])>=EPS) break;
+			}
+			if (fabs(pvt)<EPS) return 1;
+			for (k=0;k<N;k++) swap(a[i][k],a[j][k]);
+			swap(b[i],b[j]);
+		}
+		for (k=i+1;k<N;k++) {
+			tmp=a[k][i]/pvt;
+			for (j=i+1;j<N;j++) a[k][j]-=tmp*a[i][j];
+			b[k]-=tmp*b[i];
+		}
+	}
+	for (i=N-1;i>=0;i--) {
+		x[i]=b[i];
+		for (j=N-1;j>i;j--) x[i]-=a[i][j]*x[j];
+		x[i]/=a[i][i];
+	}
+	return 0;
+}
+
+// Closer points first, ties go to the later stencil entry
+static bool closer(const pair<double,int> &left,const pair<double,int> &right) {
+	if (left.first!=right.first) return left.first<right.first;
+	return left.second>right.second;
+}
+
 void Interpolate::init(void) {
 	
-	a3.resize(3); b3.resize(3); weights3.resize(3);
-	for (int i=0;i<3;++i) a3[i].resize(3);
-	
-	a4.resize(4); b4.resize(4); weights4.resize(4);
-	for (int i=0;i<4;++i) a4[i].resize(4);
+	order.reserve(64);
+	sorted_stencil.reserve(64);
+	sorted_indices.reserve(64);
 	
 	return;
 }
@@ -62,60 +97,24 @@ void Interpolate::flush(void) {
 void Interpolate::sort_stencil(bool is_internal) {
 
 	int stencil_size=stencil.size();
-	vector<double> distances;
-	vector<int> order (min(stencil_size,max_stencil_size),0);
-	vector<double> min_distances (order.size(),1.e20);
-	
-	// Store distances to the point
-	for (vit=stencil.begin();vit!=stencil.end();vit++) distances.push_back(fabs(*vit-point));
+	int keep=min(stencil_size,max_stencil_size);
+	// For internal faces, keep the first 2 (parent and neighbor) in the stencil unchanged
+	int fixed=(is_internal) ? min(2,keep) : 0;
 	
-	vector<Vec3D> new_stencil (order.size(),0.);
-	vector<int> new_stencil_indices (order.size(),0);
-
-	//is_internal=false;
-	
-	// Sort distances
-	if (is_internal) { // Keep the first 2 (parent and neighbor) in the stencil unchanged
-		order[0]=0;
-		order[1]=1;
-		for (int d=2;d<distances.size();++d) {
-			for (int m=2;m<min_distances.size();++m) {
-				if (distances[d]<=min_distances[m]) {
-					for (int i=order.size()-1;i>m;--i) order[i]=order[i-1];
-					for (int i=order.size()-1;i>m;--i) min_distances[i]=min_distances[i-1];
-					order[m]=d;
-					min_distances[m]=distances[d];
-					break;
-				}
-			}
-		}
-	} else {
-		for (int d=0;d<distances.size();++d) {
-			for (int m=0;m<min_distances.size();++m) {
-				if (distances[d]<=min_distances[m]) {
-					for (int i=order.size()-1;i>m;--i) order[i]=order[i-1];
-					for (int i=order.size()-1;i>m;--i) min_distances[i]=min_distances[i-1];
-					order[m]=d;
-					min_distances[m]=distances[d];
-					break;
-				}
-			}
-		}
-
-	}
-
-	for (int i=0;i<order.size();++i) {
-		new_stencil[i]=stencil[order[i]];
-		new_stencil_indices[i]=stencil_indices[order[i]];
+	// Only the closest keep-fixed of the remaining points need to be in order
+	order.clear();
+	for (int d=fixed;d<stencil_size;++d) order.push_back(pair<double,int>(fabs(stencil[d]-point),d));
+	partial_sort(order.begin(),order.begin()+(keep-fixed),order.end(),closer);
+	
+	sorted_stencil.assign(stencil.begin(),stencil.begin()+fixed);
+	sorted_indices.assign(stencil_indices.begin(),stencil_indices.begin()+fixed);
+	for (int i=0;i<keep-fixed;++i) {
+		sorted_stencil.push_back(stencil[order[i].second]);
+		sorted_indices.push_back(stencil_indices[order[i].second]);
 	}
 
-	stencil=new_stencil;
-	stencil_indices=new_stencil_indices;
-	
-	distances.clear();
-	order.clear();
-	min_distances.clear();
-	new_stencil.clear();
+	stencil.swap(sorted_stencil);
+	stencil_indices.swap(sorted_indices);
 	
 	return;
 }
@@ -215,7 +214,7 @@ bool Interpolate::interpolate_tetra(void) {
 					//b4[3]=1.;
 					
 					// Solve the 4x4 linear system by Gaussion Elimination
-					gelimd(a4,b4,weights4);
+					if (gelim(a4,b4,weights4)) continue;
 					// Let's see if the linear system solution is good
 					weightSum=0.;
 					for (int i=0;i<4;++i) weightSum+=weights4[i];
@@ -294,7 +293,7 @@ bool Interpolate::interpolate_tri(void) {
 				b3[2]=1.;
 				
 				// Solve the 3x3 linear system by Gaussion Elimination
-				gelimd(a3,b3,weights3);
+				if (gelim(a3,b3,weights3)) continue;
 				// Let's see if the linear system solution is good
 				weightSum=0.;
 				for (int i=0;i<3;++i) weightSum+=weights3[i];
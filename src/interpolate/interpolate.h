@@ -33,6 +33,8 @@
 
 #include <iomanip>
 #include <cmath>
+#include <vector>
+#include <algorithm>
 using namespace std;
 
 #include "vec3d.h"
@@ -41,9 +43,13 @@ using namespace std;
 
 class Interpolate {
 private:
-	vector<Vec3D>::iterator vit;
-	vector<vector<double> > a3,a4;
-	vector<double> b3,b4,weights3,weights4;
+	// Small linear systems are kept in fixed size arrays
+	double a3[3][3],b3[3],weights3[3];
+	double a4[4][4],b4[4],weights4[4];
+	// Scratch space reused by sort_stencil (distance, stencil position)
+	vector<pair<double,int> > order;
+	vector<Vec3D> sorted_stencil;
+	vector<int> sorted_indices;
 	
 	Vec3D planeNormal,edge1,edge2,edge3,edge4,edge5,edge6,p_point,centroid;
 	Vec3D basis1,basis2,basis3;
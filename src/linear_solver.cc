@@ -0,0 +1,592 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer 
+ 
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <vector>
+#include <cmath>
+#include <mpi.h>
+#include "linear_solver.h"
+#include "utilities.h"
+
+extern InputFile input;
+extern int Rank;
+
+void register_linear_solver_options(Subsection &options) {
+	bool optional=false;
+	options.register_string("linearsolver",optional,"fgmres");
+	options.register_int("restart",optional,0);
+	options.register_double("krylovmemory",optional,1000.);
+	options.register_int("augmentation",optional,2);
+	options.register_int("recycle",optional,0);
+	options.register_string("forcing",optional,"fixed");
+	options.register_double("maxforcing",optional,0.1);
+	options.register_string("initialguess",optional,"knoll");
+	options.register_int("guesshistory",optional,3);
+	options.register_string("linearpreconditioner",optional,"bjacobi");
+	options.register_int("asmoverlap",optional,1);
+	options.register_string("subsolver",optional,"preonly");
+	options.register_string("subpreconditioner",optional,"ilu");
+	options.register_int("ilulevels",optional,0);
+	options.register_double("ilufill",optional,1.);
+	options.register_string("iluordering",optional,"natural");
+	return;
+}
+
+// Sub-block solvers of bjacobi and asm only exist after the first KSPSetUp,
+// so their settings go through the options database under the solver prefix.
+// Anything already given on the command line is kept.
+void set_sub_option(string prefix,string name,string value) {
+	PetscTruth found;
+	PetscOptionsHasName(PETSC_NULL,("-"+prefix+name).c_str(),&found);
+	if (!found) PetscOptionsSetValue(("-"+prefix+name).c_str(),value.c_str());
+	return;
+}
+
+void set_linear_solver_options(KSP ksp,int gid,string subsection,string prefix,bool set_pc) {
+	
+	Subsection &options=input.section("grid",gid).subsection(subsection);
+	
+	string ksp_type=options.get_string("linearsolver");
+	int restart=options.get_int("restart");
+	double memory=options.get_double("krylovmemory");
+	int augmentation=options.get_int("augmentation");
+	int recycle=max(options.get_int("recycle").value,0);
+	string pc_type=options.get_string("linearpreconditioner");
+	int overlap=options.get_int("asmoverlap");
+	string sub_ksp_type=options.get_string("subsolver");
+	string sub_pc_type=options.get_string("subpreconditioner");
+	int ilu_levels=options.get_int("ilulevels");
+	double ilu_fill=options.get_double("ilufill");
+	string ilu_ordering=options.get_string("iluordering");
+	
+	if (restart<0) {
+		if (Rank==0) cerr << "[E] Input entry grid_" << gid+1 << " -> " << subsection << " -> restart can't be negative" << endl;
+		exit(1);
+	}
+	if (ilu_levels<0) {
+		if (Rank==0) cerr << "[E] Input entry grid_" << gid+1 << " -> " << subsection << " -> ilu levels can't be negative" << endl;
+		exit(1);
+	}
+	
+	// GMRES keeps restart+1 basis vectors (twice as many for fgmres) on top of a few
+	// work vectors, lgmres augmentation vectors and the recycled subspace.
+	// A restart longer than the iteration limit only reserves memory that is never used.
+	Mat A,P;
+	MatStructure flag;
+	PetscReal rtol,abstol,dtol;
+	PetscInt maxits;
+	int local_rows,local_cols,max_rows;
+	KSPGetOperators(ksp,&A,&P,&flag);
+	KSPGetTolerances(ksp,&rtol,&abstol,&dtol,&maxits);
+	MatGetLocalSize(A,&local_rows,&local_cols);
+	MPI_Allreduce(&local_rows,&max_rows,1,MPI_INT,MPI_MAX,MPI_COMM_WORLD);
+	double vector_memory=double(max_rows)*sizeof(PetscScalar)/1048576.; // MB
+	int per_iteration=(ksp_type=="fgmres") ? 2 : 1;
+	int fixed=3+2*recycle;
+	if (ksp_type=="lgmres") fixed+=2*augmentation;
+	double budget_restart=(memory/vector_memory-fixed)/double(per_iteration);
+	
+	if (restart==0 || restart>maxits) restart=maxits;
+	if (restart>budget_restart) {
+		restart=max(int(budget_restart),1);
+		if (Rank==0 && ksp_type.find("gmres")!=string::npos) cout << "[W grid=" << gid+1 << " ] " << subsection << " krylov memory budget limits the restart to " << restart << endl;
+	}
+	
+	KSPSetOptionsPrefix(ksp,prefix.c_str());
+	KSPSetType(ksp,ksp_type.c_str());
+	// No-op for solvers other than the GMRES family
+	KSPGMRESSetRestart(ksp,restart);
+	if (ksp_type=="lgmres") KSPLGMRESSetAugDim(ksp,augmentation);
+
+	string summary=ksp_type;
+	if (ksp_type.find("gmres")!=string::npos) summary+="("+int2str(restart)+")";
+	
+	if (set_pc) {
+		PC pc;
+		KSPGetPC(ksp,&pc);
+		PCSetType(pc,pc_type.c_str());
+		if (pc_type=="bjacobi" || pc_type=="asm") {
+			if (pc_type=="asm") PCASMSetOverlap(pc,overlap);
+			set_sub_option(prefix,"sub_ksp_type",sub_ksp_type);
+			set_sub_option(prefix,"sub_pc_type",sub_pc_type);
+			if (sub_pc_type=="ilu") {
+				ostringstream fill; fill << ilu_fill;
+				set_sub_option(prefix,"sub_pc_factor_levels",int2str(ilu_levels));
+				set_sub_option(prefix,"sub_pc_factor_fill",fill.str());
+				set_sub_option(prefix,"sub_pc_factor_mat_ordering_type",ilu_ordering);
+			}
+			summary+=" + "+pc_type;
+			if (pc_type=="asm") summary+="("+int2str(overlap)+")";
+			summary+="/"+sub_pc_type;
+			if (sub_pc_type=="ilu") summary+="("+int2str(ilu_levels)+")";
+		} else if (pc_type=="ilu") {
+			// Only available on a single partition
+			PCFactorSetLevels(pc,ilu_levels);
+			PCFactorSetFill(pc,ilu_fill);
+			PCFactorSetMatOrderingType(pc,ilu_ordering.c_str());
+			summary+=" + ilu("+int2str(ilu_levels)+")";
+		} else {
+			summary+=" + "+pc_type;
+		}
+	}
+	
+	if (Rank==0) cout << "[I grid=" << gid+1 << " ] " << subsection << " linear solver: " << summary << ", options prefix -" << prefix << endl;
+	
+	return;
+}
+
+PetscErrorCode deflated_mult(Mat deflated,Vec x,Vec y) {
+	void *context;
+	MatShellGetContext(deflated,&context);
+	KrylovRecycler &recycler=*((KrylovRecycler*) context);
+	MatMult(recycler.A,x,y);
+	if (recycler.size>0) {
+		vector<PetscScalar> h(recycler.size);
+		VecMDot(y,recycler.size,recycler.C,&h[0]);
+		for (int j=0;j<recycler.size;++j) h[j]=-h[j];
+		VecMAXPY(y,recycler.size,&h[0],recycler.C);
+	}
+	return 0;
+}
+
+KrylovRecycler::KrylovRecycler() {
+	max_size=0;
+	size=0;
+	return;
+}
+
+void KrylovRecycler::init(int gid,string subsection,Mat A_in) {
+	
+	max_size=max(input.section("grid",gid).subsection(subsection).get_int("recycle").value,0);
+	size=0;
+	if (max_size==0) return;
+	
+	A=A_in;
+	int m,n,M,N;
+	MatGetLocalSize(A,&m,&n);
+	MatGetSize(A,&M,&N);
+	MatCreateShell(PETSC_COMM_WORLD,m,n,M,N,(void*)this,&deflated);
+	MatShellSetOperation(deflated,MATOP_MULT,(void(*)(void))deflated_mult);
+	MatGetVecs(A,&work,&projected_rhs);
+	VecDuplicateVecs(work,max_size,&U);
+	VecDuplicateVecs(work,max_size,&C);
+	
+	if (Rank==0) cout << "[I grid=" << gid+1 << " ] " << subsection << " linear solver recycles up to " << max_size << " solution vectors" << endl;
+	
+	return;
+}
+
+// Orthonormalizes C[n] against C[0..n-1] (classical Gram-Schmidt, done twice),
+// U[n] follows along so that C=A*U still holds. False if C[n] is (nearly) dependent.
+bool KrylovRecycler::orthogonalize(int n) {
+	PetscReal norm0,norm;
+	VecNorm(C[n],NORM_2,&norm0);
+	// Also rejects NaN (e.g. the solution of a diverged step)
+	if (!(norm0>0.)) return false;
+	if (n>0) {
+		vector<PetscScalar> h(n);
+		for (int pass=0;pass<2;++pass) {
+			VecMDot(C[n],n,C,&h[0]);
+			for (int j=0;j<n;++j) h[j]=-h[j];
+			VecMAXPY(C[n],n,&h[0],C);
+			VecMAXPY(U[n],n,&h[0],U);
+		}
+	}
+	VecNorm(C[n],NORM_2,&norm);
+	if (!(norm>=1.e-8*norm0)) return false;
+	VecScale(C[n],1./norm);
+	VecScale(U[n],1./norm);
+	return true;
+}
+
+void KrylovRecycler::orthonormalize(void) {
+	// The matrix changed since the last solve, rebuild C=A*U for it
+	// Vectors that became dependent are dropped, the order (oldest first) is kept
+	int kept=0;
+	for (int i=0;i<size;++i) {
+		swap(U[i],U[kept]);
+		swap(C[i],C[kept]);
+		MatMult(A,U[kept],C[kept]);
+		if (orthogonalize(kept)) kept++;
+	}
+	size=kept;
+	return;
+}
+
+void KrylovRecycler::append(Vec x,Vec Ax) {
+	if (size==max_size) {
+		// Drop the oldest direction
+		Vec u=U[0],c=C[0];
+		for (int i=1;i<max_size;++i) {
+			U[i-1]=U[i];
+			C[i-1]=C[i];
+		}
+		U[max_size-1]=u;
+		C[max_size-1]=c;
+		size--;
+	}
+	VecCopy(x,U[size]);
+	VecCopy(Ax,C[size]);
+	if (orthogonalize(size)) size++;
+	return;
+}
+
+void KrylovRecycler::solve(KSP ksp,Vec b,Vec x,int &nIter,double &rNorm,MatStructure flag) {
+	
+	orthonormalize();
+	
+	// beta=C^T*b and the part of b the Krylov solver still has to resolve
+	vector<PetscScalar> beta(max_size,0.),h(max_size,0.);
+	VecCopy(b,projected_rhs);
+	if (size>0) {
+		VecMDot(b,size,C,&beta[0]);
+		for (int j=0;j<size;++j) h[j]=-beta[j];
+		VecMAXPY(projected_rhs,size,&h[0],C);
+	}
+	
+	PetscReal b_norm,projected_norm;
+	VecNorm(b,NORM_2,&b_norm);
+	VecNorm(projected_rhs,NORM_2,&projected_norm);
+	
+	PetscReal rtol,abstol,dtol;
+	PetscInt maxits;
+	KSPGetTolerances(ksp,&rtol,&abstol,&dtol,&maxits);
+	
+	if (projected_norm<=max(rtol*b_norm,abstol)) {
+		// The recycled subspace alone resolves the system
+		VecSet(x,0.);
+		if (size>0) VecMAXPY(x,size,&beta[0],U);
+		nIter=0;
+		rNorm=projected_norm;
+		return;
+	}
+	
+	// Keep the convergence target relative to the original right hand side
+	KSPSetTolerances(ksp,min(rtol*b_norm/projected_norm,0.99),abstol,dtol,maxits);
+	KSPSetOperators(ksp,deflated,A,flag);
+	KSPSolve(ksp,projected_rhs,x);
+	KSPGetIterationNumber(ksp,&nIter);
+	KSPGetResidualNorm(ksp,&rNorm);
+	KSPSetTolerances(ksp,rtol,abstol,dtol,maxits);
+	
+	// Add the U component: x+=U*C^T*(b-A*x)=U*(beta-C^T*A*x)
+	// work ends up as A*x of the completed solution since A*U=C
+	MatMult(A,x,work);
+	if (size>0) {
+		VecMDot(work,size,C,&h[0]);
+		for (int j=0;j<size;++j) h[j]=beta[j]-h[j];
+		VecMAXPY(x,size,&h[0],U);
+		VecMAXPY(work,size,&h[0],C);
+	}
+	
+	append(x,work);
+	
+	return;
+}
+
+void KrylovRecycler::destroy(void) {
+	if (max_size==0) return;
+	MatDestroy(deflated);
+	VecDestroy(work);
+	VecDestroy(projected_rhs);
+	VecDestroyVecs(U,max_size);
+	VecDestroyVecs(C,max_size);
+	return;
+}
+
+ForcingTerm::ForcingTerm() {
+	adaptive=false;
+	reset();
+	return;
+}
+
+void ForcingTerm::init(int gid,string subsection,double rtol) {
+	
+	Subsection &options=input.section("grid",gid).subsection(subsection);
+	string forcing=options.get_string("forcing");
+	eta_min=rtol;
+	eta_max=options.get_double("maxforcing");
+	
+	if (forcing=="fixed") adaptive=false;
+	else if (forcing=="adaptive") adaptive=true;
+	else {
+		if (Rank==0) cerr << "[E] Input entry grid_" << gid+1 << " -> " << subsection << " -> forcing=" << forcing << " is not recognized" << endl;
+		exit(1);
+	}
+	if (adaptive && (eta_max<=0. || eta_max>=1.)) {
+		if (Rank==0) cerr << "[E] Input entry grid_" << gid+1 << " -> " << subsection << " -> max forcing should be between 0 and 1" << endl;
+		exit(1);
+	}
+	eta_max=max(eta_max,eta_min);
+	reset();
+	
+	return;
+}
+
+void ForcingTerm::reset(void) {
+	first_residual=-1.;
+	last_residual=-1.;
+	eta=eta_max;
+	return;
+}
+
+double ForcingTerm::tolerance(double residual) {
+	
+	if (!adaptive) return eta_min;
+	
+	const double gamma=0.9;
+	const double alpha=0.5*(1.+sqrt(5.));
+	
+	if (last_residual<=0. || first_residual<=0.) {
+		first_residual=residual;
+		eta=eta_max;
+	} else {
+		double previous_eta=eta;
+		eta=gamma*pow(residual/last_residual,alpha);
+		// Don't let the tolerance drop much faster than the previous one unless it is already small
+		double safeguard=gamma*pow(previous_eta,alpha);
+		if (safeguard>0.1) eta=max(eta,safeguard);
+		eta=min(eta,residual/first_residual);
+	}
+	last_residual=residual;
+	eta=max(eta_min,min(eta,eta_max));
+	
+	return eta;
+}
+
+InitialGuess::InitialGuess() {
+	max_size=0;
+	size=0;
+	current_first=false;
+	guessed=false;
+	guess_residual=1.;
+	step_residual=1.;
+	step_iterations=0;
+	guessed_solves=0; guessed_iterations=0;
+	plain_solves=0; plain_iterations=0;
+	guess_residual_sum=0.;
+	return;
+}
+
+void InitialGuess::init(int g,string s,Mat A_in) {
+	
+	gid=g;
+	subsection=s;
+	Subsection &options=input.section("grid",gid).subsection(subsection);
+	string type=options.get_string("initialguess");
+	int history=options.get_int("guesshistory");
+	size=0;
+	
+	if (type=="knoll") {
+		max_size=0;
+		return;
+	} else if (type=="extrapolate") {
+		projection=false;
+		// Higher order extrapolation in time only amplifies noise
+		if (history<2 || history>3) {
+			if (Rank==0) cerr << "[E] Input entry grid_" << gid+1 << " -> " << subsection << " -> guess history should be 2 or 3 for extrapolation" << endl;
+			exit(1);
+		}
+	} else if (type=="projection") {
+		projection=true;
+		if (history<1) {
+			if (Rank==0) cerr << "[E] Input entry grid_" << gid+1 << " -> " << subsection << " -> guess history should be at least 1" << endl;
+			exit(1);
+		}
+	} else {
+		if (Rank==0) cerr << "[E] Input entry grid_" << gid+1 << " -> " << subsection << " -> initial guess=" << type << " is not recognized" << endl;
+		exit(1);
+	}
+	
+	max_size=history;
+	A=A_in;
+	Vec work;
+	MatGetVecs(A,&work,&residual);
+	VecDuplicateVecs(work,max_size,&X);
+	if (projection) VecDuplicateVecs(work,max_size,&W);
+	VecDestroy(work);
+	steps.resize(max_size);
+	
+	if (Rank==0) cout << "[I grid=" << gid+1 << " ] " << subsection << " initial guess: " << type << " from the last " << max_size << " time steps" << endl;
+	
+	return;
+}
+
+void InitialGuess::extrapolate(Vec x,int step) {
+	// Lagrange polynomial through the last (up to three) solutions, evaluated at step
+	int n=min(size,3);
+	int first=size-n;
+	vector<PetscScalar> weight(n,1.);
+	for (int i=0;i<n;++i) {
+		for (int j=0;j<n;++j) {
+			if (j==i) continue;
+			weight[i]*=double(step-steps[first+j])/double(steps[first+i]-steps[first+j]);
+		}
+	}
+	VecSet(x,0.);
+	VecMAXPY(x,n,&weight[0],&X[first]);
+	return;
+}
+
+void InitialGuess::project(Vec b,Vec x) {
+	// x=X*y minimizing ||b-A*X*y||: with A*X=Q*R (modified Gram-Schmidt), R*y=Q^T*b
+	vector<double> R(size*size,0.);
+	vector<bool> kept(size,false);
+	for (int i=0;i<size;++i) {
+		MatMult(A,X[i],W[i]);
+		PetscReal norm0,norm;
+		VecNorm(W[i],NORM_2,&norm0);
+		if (!(norm0>0.)) continue;
+		for (int j=0;j<i;++j) {
+			if (!kept[j]) continue;
+			PetscScalar h;
+			VecDot(W[i],W[j],&h);
+			R[j*size+i]=h;
+			VecAXPY(W[i],-h,W[j]);
+		}
+		VecNorm(W[i],NORM_2,&norm);
+		// Drop solutions that are (nearly) dependent on the previous ones
+		if (!(norm>=1.e-8*norm0)) continue;
+		VecScale(W[i],1./norm);
+		R[i*size+i]=norm;
+		kept[i]=true;
+	}
+	vector<PetscScalar> y(size,0.);
+	for (int i=size-1;i>=0;--i) {
+		if (!kept[i]) continue;
+		PetscScalar c;
+		VecDot(b,W[i],&c);
+		for (int j=i+1;j<size;++j) if (kept[j]) c-=R[i*size+j]*y[j];
+		y[i]=c/R[i*size+i];
+	}
+	VecSet(x,0.);
+	VecMAXPY(x,size,&y[0],X);
+	return;
+}
+
+void InitialGuess::guess(KSP ksp,Vec b,Vec x,int step,bool first) {
+	
+	current_step=step;
+	current_first=first;
+	guessed=false;
+	
+	// Solutions of a time step that is being retried (or of later ones) no longer apply
+	if (first) while (size>0 && steps[size-1]>=step) size--;
+	
+	if (active() && first && size>0) {
+		if (projection) project(b,x);
+		else extrapolate(x,step);
+		// Only keep the guess if it is better than starting from zero
+		PetscReal b_norm,r_norm;
+		VecNorm(b,NORM_2,&b_norm);
+		MatMult(A,x,residual);
+		VecAYPX(residual,-1.,b);
+		VecNorm(residual,NORM_2,&r_norm);
+		if (b_norm>0. && r_norm<b_norm) {
+			guessed=true;
+			guess_residual=r_norm/b_norm;
+		}
+	}
+	
+	if (first) step_residual=(guessed) ? guess_residual : 1.;
+	
+	if (guessed) {
+		KSPSetInitialGuessKnoll(ksp,PETSC_FALSE);
+		KSPSetInitialGuessNonzero(ksp,PETSC_TRUE);
+	} else {
+		KSPSetInitialGuessNonzero(ksp,PETSC_FALSE);
+		KSPSetInitialGuessKnoll(ksp,PETSC_TRUE);
+	}
+	
+	return;
+}
+
+void InitialGuess::store(Vec x,int nIter) {
+	
+	if (!current_first) return;
+	
+	step_iterations=nIter;
+	if (guessed) {
+		guessed_solves++;
+		guessed_iterations+=nIter;
+		guess_residual_sum+=guess_residual;
+	} else {
+		plain_solves++;
+		plain_iterations+=nIter;
+	}
+	
+	if (!active()) return;
+	
+	PetscReal norm;
+	VecNorm(x,NORM_2,&norm);
+	// Also rejects NaN (e.g. the solution of a diverged step)
+	if (!(norm>0.) || isinf(norm)) return;
+	
+	if (size==max_size) {
+		// Drop the oldest solution
+		Vec oldest=X[0];
+		for (int i=1;i<max_size;++i) {
+			X[i-1]=X[i];
+			steps[i-1]=steps[i];
+		}
+		X[max_size-1]=oldest;
+		size--;
+	}
+	VecCopy(x,X[size]);
+	steps[size]=current_step;
+	size++;
+	
+	return;
+}
+
+void InitialGuess::write_step(ostream &out) {
+	if (!active()) return;
+	out << "\t" << step_residual << "\t" << step_iterations;
+	return;
+}
+
+void InitialGuess::report(void) {
+	if (!active()) return;
+	if (Rank==0) {
+		cout << "[I grid=" << gid+1 << " ] " << subsection << " first solves of time steps: ";
+		if (guessed_solves>0) {
+			cout << guessed_solves << " from the initial guess, " << double(guessed_iterations)/double(guessed_solves) << " linear iterations";
+			cout << " on average, starting from " << guess_residual_sum/double(guessed_solves) << " of the rhs norm";
+		}
+		if (guessed_solves>0 && plain_solves>0) cout << "; ";
+		if (plain_solves>0) {
+			cout << plain_solves << " without, " << double(plain_iterations)/double(plain_solves) << " linear iterations on average";
+		}
+		cout << endl;
+	}
+	return;
+}
+
+void InitialGuess::destroy(void) {
+	if (max_size==0) return;
+	VecDestroy(residual);
+	VecDestroyVecs(X,max_size);
+	if (projection) VecDestroyVecs(W,max_size);
+	return;
+}
@@ -0,0 +1,134 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer 
+ 
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#ifndef LINEAR_SOLVER_H
+#define LINEAR_SOLVER_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+using namespace std;
+
+#include "petscksp.h"
+#include "inputs.h"
+
+// Registers the linear solver options shared by the navierstokes, turbulence
+// and heatconduction subsections
+void register_linear_solver_options(Subsection &options);
+
+// Gives the KSP of an equation set its own options prefix (e.g. ns1_, rans1_, hc2_)
+// and applies the linear solver choices of its input subsection.
+// The GMRES restart length is limited by the iteration limit and the per rank
+// Krylov memory budget, so operators and tolerances need to be set before.
+// Call before KSPSetFromOptions so that the command line still has the last word.
+// set_pc=false leaves the preconditioner to the caller (e.g. multigrid)
+void set_linear_solver_options(KSP ksp,int gid,string subsection,string prefix,bool set_pc=true);
+
+// Carries a subspace of solutions across consecutive linear solves (GCRO style).
+// With C=A*U orthonormal, the Krylov solver works on (I-C*C^T)*A, which only
+// has to resolve the part of the right hand side outside of span(C), and the
+// solution is completed by the U component. Each solve contributes its new
+// direction to U, the oldest one is dropped when full.
+// C is rebuilt for the current matrix at every solve (one product per vector).
+class KrylovRecycler {
+public:
+	KrylovRecycler();
+	void init(int gid,string subsection,Mat A);
+	bool active(void) {return max_size>0;}
+	// Replaces KSPSolve, fills in the iteration count and residual norm of the solve
+	// flag is passed on to KSPSetOperators (SAME_PRECONDITIONER keeps the preconditioner)
+	void solve(KSP ksp,Vec b,Vec x,int &nIter,double &rNorm,MatStructure flag=SAME_NONZERO_PATTERN);
+	void destroy(void);
+	
+	Mat A,deflated; // deflated is (I-C*C^T)*A as a shell matrix
+	Vec *U,*C;
+	Vec projected_rhs,work;
+	int max_size,size;
+private:
+	bool orthogonalize(int n);
+	void orthonormalize(void);
+	void append(Vec x,Vec Ax);
+};
+
+// Eisenstat-Walker (choice 2) forcing term: relative tolerance of each linear solve
+// of an inexact Newton iteration, from the ratio of consecutive nonlinear residuals.
+// It is also kept below the drop of the residual since the first solve, so solves
+// are loose while the residual is large and tighten to the input relative tolerance
+// near convergence. With forcing=fixed the input relative tolerance is always used.
+class ForcingTerm {
+public:
+	ForcingTerm();
+	void init(int gid,string subsection,double rtol);
+	// Starts a new nonlinear solve (e.g. a new physical time step in dual time stepping)
+	void reset(void);
+	double tolerance(double residual);
+	
+	bool adaptive;
+	double eta,eta_min,eta_max;
+	double first_residual,last_residual;
+};
+
+// Initial guess of the first linear solve of each time step from the solutions of the
+// first solves of previous time steps, which are strongly correlated in time accurate runs.
+// "extrapolate" fits a polynomial (linear or quadratic in the step number) through the
+// last two or three of them, "projection" takes the combination of all stored ones that
+// minimizes the residual of the new system (projection onto their POD basis).
+// A guess that leaves a larger residual than a zero guess is discarded. The other solves,
+// and all of them with initial guess=knoll, start from the preconditioned rhs (Knoll).
+class InitialGuess {
+public:
+	InitialGuess();
+	void init(int gid,string subsection,Mat A);
+	bool active(void) {return max_size>0;}
+	// Fills x and sets the initial guess mode of ksp before the solve
+	// first is true for the first solve of time step step
+	void guess(KSP ksp,Vec b,Vec x,int step,bool first);
+	// Keeps the solution of the first solve of a time step and counts the linear iterations
+	void store(Vec x,int nIter);
+	// Relative residual of the starting point and linear iterations of the first solve of the
+	// current time step, written as two extra columns of the convergence history
+	void write_step(ostream &out);
+	// Average linear iterations of the first solves with and without a guess
+	void report(void);
+	void destroy(void);
+	
+	Mat A;
+	Vec *X,*W; // Stored solutions (oldest first) and work space for A*X
+	Vec residual;
+	vector<int> steps; // Time step of each stored solution
+	int max_size,size;
+	bool projection;
+	int gid;
+	string subsection;
+	int current_step;
+	bool current_first,guessed;
+	double guess_residual; // ||b-A*x0||/||b|| of the last guess
+	double step_residual; // Same for the first solve of the current time step, 1 without a guess
+	int step_iterations;
+	int guessed_solves,guessed_iterations,plain_solves,plain_iterations;
+	double guess_residual_sum;
+private:
+	void extrapolate(Vec x,int step);
+	void project(Vec b,Vec x);
+};
+
+#endif
@@ -41,20 +41,28 @@ using namespace std;
 #include "commons.h"
 #include "bc_interface.h"
 #include "loads.h"
+#include "async_output.h"
+#include "statistics.h"
+#include "monitors.h"
+#include "setup_profiler.h"
 
 // Function prototypes
 void read_inputs(void);
-void set_bcs(int gid);
+void set_bcs(int gid,bool cached);
 void write_volume_output(int gid, int step);
 void write_surface_output(int gid, int step);
+void write_volume_statistics(int gid, int step);
+void write_surface_statistics(int gid, int step);
 void write_restart(int gid,int timeStep,double time);
 void write_loads(int gid,int timeStep,double time);
 void read_restart(int gid,int restart_step,double &time);
 void set_lengthScales(int gid);
+unsigned long long setup_cache_key(int gid);
 
 void set_time_step_options(void);
 void update_time_step_options(void);
 void update_time_step(int timeStep,double &time,double &max_cfl,int gid);
+bool rollback_time_step(int timeStep,double &time,double &max_cfl,int gid);
 
 void set_pseudo_time_step_options(void);
 void update_pseudo_time_step_options(void);
@@ -80,6 +88,10 @@ vector<Variable<double> > dtau;
 vector<int> equations;
 vector<vector<BC_Interface> > interface; // for each grid
 vector<Loads> loads;
+AsyncOutput output_queue;
+vector<Statistics> statistics;
+vector<Monitors> monitors;
+SetupProfiler setup_profiler;
 
 int Rank,np;
 int gradient_test;
@@ -98,7 +110,9 @@ int PetscPrintError(const char error[],...){
 int main(int argc, char *argv[]) {
 
 	// Initialize mpi
-	MPI_Init(&argc,&argv);
+	// Cell loops may be threaded within a rank, but only the master thread makes MPI calls
+	int thread_support;
+	MPI_Init_thread(&argc,&argv,MPI_THREAD_FUNNELED,&thread_support);
 	MPI_Comm_rank(MPI_COMM_WORLD, &Rank);
 	MPI_Comm_size(MPI_COMM_WORLD, &np);
 	
@@ -131,6 +145,29 @@ int main(int argc, char *argv[]) {
 	input.setFile(inputFileName);
 	read_inputs();
 	
+	// Set the number of threads per rank
+	// If not specified in the input file, OMP_NUM_THREADS environment variable is respected
+	if (input.section("parallel").get_int("threads").is_found) {
+#ifdef _OPENMP
+		omp_set_num_threads(max(1,int(input.section("parallel").get_int("threads"))));
+#endif
+	}
+	if (thread_count()>1 && thread_support<MPI_THREAD_FUNNELED) {
+		if (Rank==0) cerr << "[E] MPI library doesn't provide the thread support needed for multiple threads per rank" << endl;
+		MPI_Abort(MPI_COMM_WORLD,1);
+	}
+	if (Rank==0) cout << "[I] Running with " << np << " ranks and " << thread_count() << " threads per rank" << endl;
+	
+	// Output may be written in the background while the solver carries on
+	if (input.section("parallel").get_string("output")=="asynchronous") {
+		if (thread_support<MPI_THREAD_FUNNELED) {
+			if (Rank==0) cerr << "[W] MPI library doesn't provide the thread support needed for asynchronous output, writing synchronously" << endl;
+		} else {
+			output_queue.async=true;
+			if (Rank==0) cout << "[I] Output is written asynchronously" << endl;
+		}
+	}
+	
 	equations.resize(input.section("grid",0).count);
 	turbulent.resize(input.section("grid",0).count);
 	for (int gid=0;gid<input.section("grid",0).count;++gid) {
@@ -147,6 +184,8 @@ int main(int argc, char *argv[]) {
 	ns.resize(grid.size());
 	rans.resize(grid.size());
 	hc.resize(grid.size());
+	statistics.resize(grid.size());
+	monitors.resize(grid.size());
 	bc.resize(grid.size());
 	interface.resize(grid.size());
 	
@@ -154,11 +193,31 @@ int main(int argc, char *argv[]) {
 	for (int gid=0;gid<grid.size();++gid) {
 		grid[gid].dimension=input.section("grid",gid).get_int("dimension");
 		grid[gid].gid=gid;
+		
+		// A valid setup cache replaces everything up to the gradient maps
+		bool use_cache=(input.section("grid",gid).get_string("setupcache")=="on" && !PREP);
+		bool cached=false;
+		string cache_dir="./setup_cache/grid_"+int2str(gid+1);
+		unsigned long long cache_key=0;
+		if (use_cache) {
+			setup_profiler.start(gid,"read setup cache");
+			cache_key=setup_cache_key(gid);
+			cached=grid[gid].read_cache(cache_dir,cache_key);
+		}
+		if (cached) {
+			setup_profiler.start(gid,"set BCs");
+			set_bcs(gid,true);
+			setup_profiler.stop();
+			continue;
+		}
+		
 		// Read the grid raw data from file
+		setup_profiler.start(gid,"read grid");
 		grid[gid].read(input.section("grid",gid).get_string("file"),input.section("grid",gid).get_string("format"));
 		if (PREP && Rank==0) {grid[gid].write_raw(); continue;}
 		// Do the transformations
 		int tcount=input.section("grid",gid).subsection("transform",0).count;
+		if (tcount>0) setup_profiler.start(gid,"transform");
 		
 		for (int t=0;t<tcount;++t) {
 			if (input.section("grid",gid).subsection("transform",t).get_string("function")=="translate") {
@@ -179,23 +238,35 @@ int main(int argc, char *argv[]) {
 
 		// Establish connectivity, area, volume etc... all the needed information
 		grid[gid].setup();
-		set_bcs(gid);
+		setup_profiler.start(gid,"set BCs");
+		set_bcs(gid,false);
 		
+		setup_profiler.start(gid,"length scales");
 		set_lengthScales(gid);
 		if (Rank==0) cout << "[I grid=" << gid+1 << " ] Calculating face averaging metrics" << endl;
 
+		setup_profiler.start(gid,"face interpolation weights");
 		face_interpolation_weights(gid);
+		setup_profiler.start(gid,"node interpolation weights");
 		node_interpolation_weights(gid);
+		setup_profiler.start(gid,"gradient maps");
 		gradient_maps(gid);
+		if (use_cache) {
+			setup_profiler.start(gid,"write setup cache");
+			grid[gid].write_cache(cache_dir,cache_key);
+		}
+		setup_profiler.stop();
 	}
 
 	if (PREP) return 0;
 	
 	for (int gid=0;gid<grid.size();++gid) {
+		setup_profiler.start(gid,"interface setup");
 		for (int i=0;i<interface[gid].size();++i) {
 			interface[gid][i].setup();
 		}
 	}
+	setup_profiler.stop();
 
 	vector<double> time (grid.size(),0.);
 	vector<double> max_cfl (grid.size(),0.);
@@ -208,20 +279,32 @@ int main(int argc, char *argv[]) {
 		if (equations[gid]==NS) {
 			if (Rank==0) cout << "[I grid=" << gid+1 << " ] Initializing Navier Stokes solver" << endl; 
 			ns[gid].gid=gid;
+			setup_profiler.start(gid,"navier stokes initialize");
 			ns[gid].initialize(ps_step_max);
 			if (turbulent[gid]) {
 				if (Rank==0) cout << "[I grid=" << gid+1 << " ] Initializing RANS solver" << endl; 
 				rans[gid].gid=gid;
+				setup_profiler.start(gid,"rans initialize");
 				rans[gid].initialize(ps_step_max);
+				if (ns[gid].coupled) ns[gid].coupled_init();
 			}
 		}
 		if (equations[gid]==HEAT) {
 			if (Rank==0) cout << "[I grid=" << gid+1 << " ] Initializing Heat Conduction solver" << endl;
 			hc[gid].gid=gid;
+			setup_profiler.start(gid,"heat conduction initialize");
 			hc[gid].initialize();
 		}
-		if (restart_step>0) read_restart(gid,restart_step,time[gid]);
+		setup_profiler.stop();
+		statistics[gid].initialize(gid);
+		if (restart_step>0) {
+			setup_profiler.start(gid,"read restart");
+			read_restart(gid,restart_step,time[gid]);
+			setup_profiler.stop();
+		}
+		monitors[gid].initialize(gid,restart_step>0);
 	}
+	setup_profiler.report();
 
 	set_time_step_options();
 	set_pseudo_time_step_options();
@@ -259,6 +342,7 @@ int main(int argc, char *argv[]) {
 		input.section("grid",0).subsection("writeoutput").stringLists["volumevariables"].value.push_back("percent_grad_error");
 		input.section("grid",0).subsection("writeoutput").stringLists["volumevariables"].value.push_back("volume");
 		write_volume_output(0,0);
+		output_queue.flush();
 		exit(1);
 	}
 	
@@ -288,6 +372,7 @@ int main(int argc, char *argv[]) {
 			if (Rank==0) cout << "[I] Writing volume output for grid=" << gid+1 << endl;
 			write_volume_output(gid, restart_step);
 		}
+		output_queue.flush();
 		exit(0);
 	}
 
@@ -301,7 +386,33 @@ int main(int argc, char *argv[]) {
 	cout << setprecision(3) << scientific;
 	fstream convergence;
 	if (fexists("convergence.dat") && restart_step>0) convergence.open("convergence.dat",fstream::out | fstream::app);
-	else convergence.open("convergence.dat",fstream::out);
+	else {
+		convergence.open("convergence.dat",fstream::out);
+		// Same layout as the screen output with the linear residual reduction added after the linear iterations
+		// The columns depend on the equations of each grid, so they are listed per grid
+		if (Rank==0) {
+			convergence << "# Time step lines: step grid-no time, followed by the columns of that grid:" << endl;
+			for (int gid=0;gid<grid.size();++gid) {
+				convergence << "#   grid " << gid+1 << ":";
+				if (equations[gid]==NS) {
+					convergence << " cfl-max ns-linear-iterations ns-linear-reduction ns-residual";
+					if (ns[gid].initial_guess.active()) convergence << " ns-guess-residual ns-guess-linear-iterations";
+					if (turbulent[gid]) {
+						convergence << " rans-linear-iterations rans-linear-reduction rans-residual";
+						if (rans[gid].initial_guess.active()) convergence << " rans-guess-residual rans-guess-linear-iterations";
+					}
+				}
+				if (equations[gid]==HEAT) {
+					convergence << " hc-linear-iterations hc-linear-reduction hc-residual";
+					if (hc[gid].initial_guess.active()) convergence << " hc-guess-residual hc-guess-linear-iterations";
+				}
+				convergence << endl;
+			}
+			convergence << "# guess columns are the relative residual of the initial guess and the linear iterations of the first solve of the time step" << endl;
+			convergence << "# Pseudo time lines (pseudo time steps>1) start with a tab and come before the time step line of their grid:" << endl;
+			convergence << "#   ps-step ps-cfl-max ns-linear-iterations ns-linear-reduction ns-residual [rans-linear-iterations rans-linear-reduction rans-residual]" << endl;
+		}
+	}
 	convergence << setprecision(3) << scientific;
 
 	/*****************************************************************************************/
@@ -329,10 +440,10 @@ int main(int argc, char *argv[]) {
 					// Write screen output for pseudo time iteration
 					if (Rank==0 && ps_step_max>1) {
 						cout        << "\t" << ps_step << "\t" << ps_max_cfl[gid] << "\t" << ns[gid].nIter << "\t" << ns[gid].ps_res;
-						convergence << "\t" << ps_step << "\t" << ps_max_cfl[gid] << "\t" << ns[gid].nIter << "\t" << ns[gid].ps_res;
+						convergence << "\t" << ps_step << "\t" << ps_max_cfl[gid] << "\t" << ns[gid].nIter << "\t" << ns[gid].linear_reduction << "\t" << ns[gid].ps_res;
 						if (turbulent[gid]) {
 							cout        << "\t" << rans[gid].nIter << "\t" << rans[gid].ps_res;
-							convergence << "\t" << rans[gid].nIter << "\t" << rans[gid].ps_res;
+							convergence << "\t" << rans[gid].nIter << "\t" << rans[gid].linear_reduction << "\t" << rans[gid].ps_res;
 
 						}
 						cout        << endl;
@@ -345,24 +456,42 @@ int main(int argc, char *argv[]) {
 						}
 					}
 				}
+				// A diverged step is retried from the last accepted state with a smaller CFL
+				while (ns[gid].diverged) {
+					if (!rollback_time_step(timeStep,time[gid],max_cfl[gid],gid)) {
+						if (Rank==0) cerr << "[E] Divergence detected at the minimum CFL!...exiting" << endl;
+						MPI_Abort(MPI_COMM_WORLD,1);
+					}
+					if (Rank==0) cout << "[W grid=" << gid+1 << " ] Step " << timeStep << " diverged, retrying with CFL=" << max_cfl[gid] << endl;
+					for (int b=0;b<loads[gid].include_bcs.size();++b) {
+						loads[gid].force[b]=0.;
+						loads[gid].moment[b]=0.;
+					}
+					ns[gid].solve(timeStep,1);
+				}
 			}
 			if (equations[gid]==HEAT) hc[gid].solve(timeStep);
 			bc_interface_sync();
+			statistics[gid].update(timeStep);
+			monitors[gid].sample(timeStep,time[gid]);
 			// Screen output
 			if (Rank==0) {
 				cout        << timeStep << "\t" << gid+1 << "\t" << time[gid];
 				convergence << timeStep << "\t" << gid+1 << "\t" << time[gid];
 				if (equations[gid]==NS) {
 					cout        << "\t" << max_cfl[gid] << "\t" << ns[gid].nIter << "\t" << ns[gid].res;
-					convergence << "\t" << max_cfl[gid] << "\t" << ns[gid].nIter << "\t" << ns[gid].res;
+					convergence << "\t" << max_cfl[gid] << "\t" << ns[gid].nIter << "\t" << ns[gid].linear_reduction << "\t" << ns[gid].res;
+					ns[gid].initial_guess.write_step(convergence);
 					if (turbulent[gid]) {
 						cout        << "\t" << rans[gid].nIter << "\t" << rans[gid].res;
-						convergence << "\t" << rans[gid].nIter << "\t" << rans[gid].res;
+						convergence << "\t" << rans[gid].nIter << "\t" << rans[gid].linear_reduction << "\t" << rans[gid].res;
+						rans[gid].initial_guess.write_step(convergence);
 					}
 				}
 				if (equations[gid]==HEAT) {
 					cout        << "\t" << hc[gid].nIter << "\t" << hc[gid].res;
-					convergence << "\t" << hc[gid].nIter << "\t" << hc[gid].res;
+					convergence << "\t" << hc[gid].nIter << "\t" << hc[gid].linear_reduction << "\t" << hc[gid].res;
+					hc[gid].initial_guess.write_step(convergence);
 				}
 				cout        << endl;
 				convergence << endl;
@@ -375,6 +504,11 @@ int main(int argc, char *argv[]) {
 				if (Rank==0) cout << "[I] Writing surface output for grid=" << gid+1 << endl;
 				write_surface_output(gid,timeStep);
 			} // end if
+			if (lastTimeStep && statistics[gid].active()) {
+				if (Rank==0) cout << "[I] Writing time statistics for grid=" << gid+1 << endl;
+				if (!statistics[gid].cellFields.empty()) write_volume_statistics(gid,timeStep);
+				if (!statistics[gid].faceFields.empty()) write_surface_statistics(gid,timeStep);
+			} // end if
 			if (timeStep%restart_freq[gid]==0 || lastTimeStep) {
 				if (Rank==0) cout << "[I] Writing restart for grid=" << gid+1 << endl;
 				write_restart(gid,timeStep,time[gid]);
@@ -435,11 +569,22 @@ int main(int argc, char *argv[]) {
 			MPI_Barrier(MPI_COMM_WORLD);
 			if (Rank==0) remove("dump_all");
 		} 	
+		// Start the output jobs submitted in this step, commit the ones that are formatted
+		output_queue.dispatch();
 	}
 	/*****************************************************************************************/
 	// End time loop
 	/*****************************************************************************************/	
 	convergence.close();	
+	for (int gid=0;gid<grid.size();++gid) monitors[gid].flush();
+	for (int gid=0;gid<grid.size();++gid) {
+		if (equations[gid]==NS) {
+			ns[gid].initial_guess.report();
+			if (turbulent[gid]) rans[gid].initial_guess.report();
+		}
+		if (equations[gid]==HEAT) hc[gid].initial_guess.report();
+	}
+	output_queue.flush();
 	MPI_Barrier(MPI_COMM_WORLD);
 
       	if (Rank==0) {
@@ -453,6 +598,28 @@ int main(int argc, char *argv[]) {
 	return 0;
 }                	
                  	
+// Everything the grid setup depends on goes into the setup cache key
+unsigned long long setup_cache_key(int gid) {
+	
+	Section &section=input.section("grid",gid);
+	string signature="np="+int2str(np)+";"+section.get_string("file").value+";"+section.get_string("format").value+";"+int2str(section.get_int("dimension"))+";";
+	for (int t=0;t<section.subsection("transform",0).count;++t) signature+=section.subsection("transform",t).rawData+";";
+	for (int b=0;b<section.subsection("BC",0).count;++b) signature+=section.subsection("BC",b).rawData+";";
+	signature+=section.subsection("gradients").rawData+";";
+	signature+=section.subsection("interpolation").rawData+";";
+	signature+=input.section("grid",0).subsection("interpolation").rawData+";";
+	
+	unsigned long long key=fnv1a_hash(signature.data(),signature.size());
+	unsigned long long mesh=file_hash(section.get_string("file"));
+	key=fnv1a_hash(&mesh,sizeof(mesh),key);
+	if (fexists("grid.raw")) {
+		mesh=file_hash("grid.raw");
+		key=fnv1a_hash(&mesh,sizeof(mesh),key);
+	}
+	
+	return key;
+}
+
 void set_lengthScales(int gid) {
 	// Loop through the cells and calculate length scales for each cell
 	for (int c=0;c<grid[gid].cellCount;++c) {
@@ -0,0 +1,317 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <map>
+using namespace std;
+
+#include "utilities.h"
+#include "grid.h"
+#include "inputs.h"
+#include "ns.h"
+#include "rans.h"
+#include "hc.h"
+#include "commons.h"
+#include "monitors.h"
+
+#define MONITOR_NAME_LENGTH 32
+
+extern vector<Grid> grid;
+extern InputFile input;
+extern vector<NavierStokes> ns;
+extern vector<HeatConduction> hc;
+extern vector<RANS> rans;
+extern vector<bool> turbulent;
+extern vector<int> equations;
+
+Monitors::Monitors() {
+	frequency=1;
+	samples=0;
+}
+
+void Monitors::initialize(int g,bool restart) {
+	
+	gid=g;
+	frequency=max(1,input.section("grid",gid).subsection("writeoutput").get_int("monitorfrequency").value);
+	
+	int count=input.section("grid",gid).subsection("probe",0).count;
+	probes.resize(count);
+	for (int p=0;p<count;++p) {
+		probes[p].point=input.section("grid",gid).subsection("probe",p).get_Vec3D("point");
+		probes[p].varList=input.section("grid",gid).subsection("probe",p).get_stringList("variables");
+		for (int var=0;var<probes[p].varList.size();++var) {
+			string name=probes[p].varList[var];
+			bool valid=(name=="T");
+			if (equations[gid]==NS && (name=="p" || name=="rho" || name=="V")) valid=true;
+			if (turbulent[gid] && (name=="k" || name=="omega" || name=="mu_t")) valid=true;
+			if (!valid) {
+				if (Rank==0) cerr << "[E] Variable " << name << " is not available for probe " << p+1 << " of grid " << gid+1 << endl;
+				exit(1);
+			}
+			if (name=="V") {
+				columns.push_back("probe"+int2str(p+1)+"_V_x");
+				columns.push_back("probe"+int2str(p+1)+"_V_y");
+				columns.push_back("probe"+int2str(p+1)+"_V_z");
+				divisors.resize(columns.size(),1.);
+			} else {
+				columns.push_back("probe"+int2str(p+1)+"_"+name);
+				divisors.push_back(1.);
+			}
+		}
+		locate(probes[p]);
+	}
+	
+	count=input.section("grid",gid).subsection("monitor",0).count;
+	surfaces.resize(count);
+	for (int m=0;m<count;++m) {
+		surfaces[m].bc=input.section("grid",gid).subsection("monitor",m).get_int("BC")-1;
+		surfaces[m].varList=input.section("grid",gid).subsection("monitor",m).get_stringList("variables");
+		int b=surfaces[m].bc;
+		if (b<0 || b>=grid[gid].bcCount) {
+			if (Rank==0) cerr << "[E] Monitor " << m+1 << " of grid " << gid+1 << " refers to BC_" << b+1 << ", which doesn't exist" << endl;
+			exit(1);
+		}
+		double area=0.;
+		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) area+=grid[gid].face[grid[gid].boundaryFaces[b][bf]].area;
+		MPI_Allreduce(&area,&surfaces[m].area,1,MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
+		for (int var=0;var<surfaces[m].varList.size();++var) {
+			string name=surfaces[m].varList[var];
+			bool valid=(name=="T" || name=="qdot");
+			if (equations[gid]==NS && (name=="p" || name=="rho" || name=="mdot" || name=="p_total" || name=="T_total" || name=="Mach")) valid=true;
+			if (!valid) {
+				if (Rank==0) cerr << "[E] Variable " << name << " is not available for monitor " << m+1 << " of grid " << gid+1 << endl;
+				exit(1);
+			}
+			columns.push_back("BC"+int2str(b+1)+"_"+name);
+			divisors.push_back((name=="mdot" || name=="qdot") ? 1. : surfaces[m].area);
+		}
+	}
+	
+	if (!active()) return;
+	
+	for (int col=0;col<columns.size();++col) {
+		if (columns[col].size()>=MONITOR_NAME_LENGTH) {
+			if (Rank==0) cerr << "[E] Monitor column name " << columns[col] << " is too long" << endl;
+			exit(1);
+		}
+	}
+	
+	buffer.resize(frequency*(columns.size()+2));
+	samples=0;
+	
+	// A restarted run carries on with the same file
+	fileName="./monitors_"+int2str(gid+1)+".dat";
+	if (Rank==0 && (!restart || !fexists(fileName.c_str()))) {
+		ofstream file;
+		file.open(fileName.c_str(),ios::out | ios::binary | ios::trunc);
+		char magic[8]="FCFDMON";
+		int nColumns=columns.size();
+		file.write(magic,8);
+		file.write((char *)&nColumns,sizeof(int));
+		for (int col=0;col<columns.size();++col) {
+			char name[MONITOR_NAME_LENGTH];
+			memset(name,0,MONITOR_NAME_LENGTH);
+			strncpy(name,columns[col].c_str(),MONITOR_NAME_LENGTH-1);
+			file.write(name,MONITOR_NAME_LENGTH);
+		}
+		file.close();
+	}
+	
+	if (Rank==0) cout << "[I grid=" << gid+1 << " ] Monitoring " << columns.size() << " quantities, written every " << frequency << " time steps" << endl;
+	
+	return;
+}
+
+bool Monitors::inside(int c,Vec3D &point,int &exit_face) {
+	
+	// Assumes convex cells, the point is behind all the faces
+	double furthest=0.;
+	exit_face=-1;
+	for (int cf=0;cf<grid[gid].cell[c].faces.size();++cf) {
+		int f=grid[gid].cell[c].faces[cf];
+		Vec3D normal=grid[gid].face[f].normal;
+		if (grid[gid].face[f].parent!=c) normal*=-1.;
+		double distance=(point-grid[gid].face[f].centroid).dot(normal);
+		if (distance>furthest) {
+			furthest=distance;
+			exit_face=f;
+		}
+	}
+	
+	return (exit_face<0);
+}
+
+void Monitors::locate(Probe &probe) {
+	
+	// Start from the cell with the nearest centroid and walk towards the point
+	int c=-1;
+	double nearest=1.e300;
+	for (int c2=0;c2<grid[gid].cellCount;++c2) {
+		double distance=fabs(grid[gid].cell[c2].centroid-probe.point);
+		if (distance<nearest) {
+			nearest=distance;
+			c=c2;
+		}
+	}
+	bool found=false;
+	int exit_face;
+	for (int step=0;step<100 && c>=0;++step) {
+		if (inside(c,probe.point,exit_face)) {
+			found=true;
+			break;
+		}
+		Face &face=grid[gid].face[exit_face];
+		int next=(face.parent==c) ? face.neighbor : face.parent;
+		// Stop at the boundaries of the grid and the partition
+		if (face.bc>=0 || next>=grid[gid].cellCount) break;
+		c=next;
+	}
+	
+	// The rank with a cell containing the point samples the probe, otherwise the one with the nearest centroid
+	struct {
+		double distance;
+		int rank;
+	} local,owner;
+	local.distance=found ? -1. : ((c>=0) ? fabs(grid[gid].cell[c].centroid-probe.point) : 1.e300);
+	local.rank=Rank;
+	MPI_Allreduce(&local,&owner,1,MPI_DOUBLE_INT,MPI_MINLOC,MPI_COMM_WORLD);
+	probe.owned=(owner.rank==Rank);
+	if (owner.distance>=0. && Rank==0) {
+		cout << "[W] Probe at " << probe.point << " is outside grid=" << gid+1 << ", the nearest cell is used" << endl;
+	}
+	if (!probe.owned) return;
+	
+	// Linear reconstruction from the cell center with the gradient map
+	// Cells without a gradient map (computed from the face values) just give the cell value
+	map<int,double> weights;
+	weights[c]=1.;
+	if (found) {
+		Vec3D offset=probe.point-grid[gid].cell[c].centroid;
+		for (map<int,Vec3D>::iterator it=grid[gid].cell[c].gradMap.begin();it!=grid[gid].cell[c].gradMap.end();it++) {
+			weights[it->first]+=it->second.dot(offset);
+		}
+	}
+	for (map<int,double>::iterator it=weights.begin();it!=weights.end();it++) {
+		probe.stencil.push_back(it->first);
+		probe.weights.push_back(it->second);
+	}
+	
+	return;
+}
+
+double Monitors::cell_value(string var,int i,int c) {
+	
+	if (var=="p") return ns[gid].p.cell(c);
+	else if (var=="T") return (equations[gid]==NS) ? ns[gid].T.cell(c) : hc[gid].T.cell(c);
+	else if (var=="rho") return ns[gid].rho.cell(c);
+	else if (var=="V") return ns[gid].V.cell(c)[i];
+	else if (var=="k") return rans[gid].k.cell(c);
+	else if (var=="omega") return rans[gid].omega.cell(c);
+	else if (var=="mu_t") return rans[gid].mu_t.cell(c);
+	return 0.;
+}
+
+double Monitors::face_value(string var,int f) {
+	
+	if (var=="mdot") return ns[gid].mdot.face(f);
+	else if (var=="qdot") return (equations[gid]==NS) ? ns[gid].qdot.face(f) : hc[gid].qdot.face(f);
+	else if (var=="T") return (equations[gid]==NS) ? ns[gid].T.face(f) : hc[gid].T.face(f);
+	else if (var=="p") return ns[gid].p.face(f);
+	else if (var=="rho") return ns[gid].rho.face(f);
+	
+	// Isentropic total conditions
+	double p=ns[gid].p.face(f);
+	double T=ns[gid].T.face(f);
+	double gamma=ns[gid].material.gamma;
+	double Mach=fabs(ns[gid].V.face(f))/ns[gid].material.a(p,T);
+	double factor=1.+0.5*(gamma-1.)*Mach*Mach;
+	if (var=="p_total") return (p+ns[gid].material.Pref)*pow(factor,gamma/(gamma-1.))-ns[gid].material.Pref;
+	else if (var=="T_total") return (T+ns[gid].material.Tref)*factor-ns[gid].material.Tref;
+	else if (var=="Mach") return Mach;
+	return 0.;
+}
+
+void Monitors::sample(int timeStep,double time) {
+	
+	if (!active()) return;
+	
+	// Each rank fills in its share, the rest are zero and the ranks are summed when written
+	double *row=&buffer[samples*(columns.size()+2)];
+	row[0]=(Rank==0) ? timeStep : 0.;
+	row[1]=(Rank==0) ? time : 0.;
+	int col=2;
+	for (int p=0;p<probes.size();++p) {
+		for (int var=0;var<probes[p].varList.size();++var) {
+			int nn=(probes[p].varList[var]=="V") ? 3 : 1;
+			for (int i=0;i<nn;++i) {
+				double value=0.;
+				if (probes[p].owned) {
+					for (int s=0;s<probes[p].stencil.size();++s) {
+						value+=probes[p].weights[s]*cell_value(probes[p].varList[var],i,probes[p].stencil[s]);
+					}
+				}
+				row[col++]=value;
+			}
+		}
+	}
+	for (int m=0;m<surfaces.size();++m) {
+		int b=surfaces[m].bc;
+		for (int var=0;var<surfaces[m].varList.size();++var) {
+			double sum=0.;
+			for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
+				int f=grid[gid].boundaryFaces[b][bf];
+				sum+=face_value(surfaces[m].varList[var],f)*grid[gid].face[f].area;
+			}
+			row[col++]=sum;
+		}
+	}
+	
+	samples++;
+	if (samples==frequency) flush();
+	
+	return;
+}
+
+void Monitors::flush(void) {
+	
+	if (!active() || samples==0) return;
+	
+	int rowSize=columns.size()+2;
+	vector<double> total;
+	if (Rank==0) total.resize(samples*rowSize);
+	MPI_Reduce(&buffer[0],(Rank==0) ? &total[0] : NULL,samples*rowSize,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+	
+	if (Rank==0) {
+		for (int s=0;s<samples;++s) {
+			for (int col=0;col<columns.size();++col) total[s*rowSize+col+2]/=divisors[col];
+		}
+		ofstream file;
+		file.open(fileName.c_str(),ios::out | ios::binary | ios::app);
+		file.write((char *)&total[0],total.size()*sizeof(double));
+		file.close();
+	}
+	samples=0;
+	
+	return;
+}
@@ -0,0 +1,83 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#ifndef MONITORS_H
+#define MONITORS_H
+
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "vec3d.h"
+
+// Probe point, located once in the cell containing it
+// Values are reconstructed at the point with the cell's gradient map, so
+// a sample is a dot product of precomputed weights with the stencil values
+class Probe {
+public:
+	Vec3D point;
+	vector<string> varList;
+	bool owned; // Whether this rank samples the probe
+	vector<int> stencil; // Cells involved in the reconstruction
+	vector<double> weights;
+};
+
+// Quantities of a boundary condition region, integrated (mdot, qdot) or area averaged (others)
+class SurfaceMonitor {
+public:
+	int bc;
+	vector<string> varList;
+	double area; // Total area of the region
+};
+
+// Time histories of probes and boundary monitors, sampled every time step
+// Each rank keeps its own contributions to the samples in a fixed size buffer and they are
+// only combined and written to ./monitors_<grid>.dat when the buffer fills up
+// File layout (binary):
+//   "FCFDMON" (8 chars), number of columns (int), name of each column (32 chars)
+//   For each sample: time step, time and the column values (doubles)
+class Monitors {
+public:
+	int gid;
+	int frequency; // Number of samples buffered between writes
+	vector<Probe> probes;
+	vector<SurfaceMonitor> surfaces;
+	vector<string> columns;
+	
+	Monitors();
+	void initialize(int gid,bool restart);
+	bool active(void) { return !columns.empty(); }
+	void sample(int timeStep,double time);
+	void flush(void);
+	
+private:
+	string fileName;
+	vector<double> divisors; // Area for the averaged columns, 1 for the others
+	vector<double> buffer; // [sample*(columns+2)+column], time step and time come first
+	int samples;
+	void locate(Probe &probe);
+	bool inside(int c,Vec3D &point,int &exit_face);
+	double cell_value(string var,int i,int c);
+	double face_value(string var,int f);
+};
+
+#endif
@@ -75,6 +75,16 @@ void NavierStokes::initialize (int ps_max) {
 	
 	wdiss=input.section("grid",0).subsection("navierstokes").get_double("walldissipation");
 	bl_height=input.section("grid",0).subsection("navierstokes").get_double("BLheight");
+	mg_levels=input.section("grid",gid).subsection("navierstokes").get_int("multigridlevels");
+	mg_smoothing=input.section("grid",gid).subsection("navierstokes").get_int("multigridsmoothing");
+	fas_level=0;
+	residual_only=false;
+	// The adaptive CFL controller retries diverged steps of steady runs
+	rollback=(input.section("timemarching").subsection("adaptiveCFL").is_found && ps_step_max==1);
+	diverged=false;
+	linear_failed=false;
+	// The block system is set up once the RANS solver is initialized (coupled_init)
+	coupled=(turbulent[gid] && input.section("grid",gid).subsection("turbulence").get_string("coupling")=="coupled");
 
 
 	Minf=input.section("reference").get_double("Mach");
@@ -85,6 +95,27 @@ void NavierStokes::initialize (int ps_max) {
 		preconditioner=WS95;
 	}
 	mpi_init();
+	if (input.section("grid",gid).subsection("navierstokes").get_string("implicitscheme")=="krylov") {
+		lusgs=false;
+	} else if (input.section("grid",gid).subsection("navierstokes").get_string("implicitscheme")=="lu-sgs") {
+		lusgs=true;
+		if (coupled) {
+			if (Rank==0) cerr << "[E] Input entry grid_" << gid+1 << " -> navier stokes -> implicit scheme=lu-sgs is not available with coupled turbulence" << endl;
+			exit(1);
+		}
+		if (mg_levels>1) {
+			if (Rank==0) cerr << "[E] Input entry grid_" << gid+1 << " -> navier stokes -> implicit scheme=lu-sgs is not available with multigrid levels>1" << endl;
+			exit(1);
+		}
+	} else {
+		if (Rank==0) cerr << "[E] Input entry grid_" << gid+1 << " -> navier stokes -> implicit scheme=" << input.section("grid",gid).subsection("navierstokes").get_string("implicitscheme") << " is not recognized" << endl;
+		exit(1);
+	}
+	lusgs_sweeps=input.section("grid",gid).subsection("navierstokes").get_int("sgssweeps");
+	if (lusgs && lusgs_sweeps<1) {
+		if (Rank==0) cerr << "[E] Input entry grid_" << gid+1 << " -> navier stokes -> sgs sweeps should be at least 1" << endl;
+		exit(1);
+	}
 	material.set(gid);
 	create_vars();
 	apply_initial_conditions();
@@ -95,6 +126,7 @@ void NavierStokes::initialize (int ps_max) {
 	mpi_update_ghost_gradients();
 	calc_limiter();
 	petsc_init();
+	active_set_init();
 	first_residuals.resize(3);
 	first_ps_residuals.resize(3);
 
@@ -104,16 +136,35 @@ void NavierStokes::initialize (int ps_max) {
 void NavierStokes::solve (int ts,int pts) {
 	timeStep=ts;
 	ps_step=pts;
+	active_set_update();
 	assemble_linear_system();
 	time_terms();
-	petsc_solve();
-	if (turbulent[gid]) rans[gid].solve(timeStep,ps_step);
+	if (coupled) {
+		rans[gid].assemble(timeStep,ps_step);
+		coupled_solve();
+	} else {
+		petsc_solve();
+	}
+	// With rollback, a diverged update is not applied and the state stays at the last accepted step
+	diverged=(rollback && diverged_update());
+	if (diverged) return;
+	if (turbulent[gid]) {
+		if (coupled) {
+			diverged=(rollback && rans[gid].diverged_update());
+			if (!diverged) rans[gid].advance();
+		} else {
+			rans[gid].solve(timeStep,ps_step);
+			diverged=rans[gid].diverged;
+		}
+		if (diverged) return;
+	}
 	update_variables();
 	mpi_update_ghost_primitives();
 	update_boundaries();
 	calc_cell_grads();
 	mpi_update_ghost_gradients();
 	calc_limiter();
+	multigrid_cycle();
 	return;
 }
 
@@ -299,12 +350,12 @@ void NavierStokes::apply_initial_conditions (void) {
 }
 
 void NavierStokes::calc_cell_grads (void) {
-	vector<Vec3D> grad (3,0.);
+	#pragma omp parallel for schedule(static)
 	for (int c=0;c<grid[gid].cellCount;++c) {
 		gradp.cell(c)=p.cell_gradient(c);
 		gradT.cell(c)=T.cell_gradient(c);
 
-		grad=V.cell_gradient(c);
+		vector<Vec3D> grad=V.cell_gradient(c);
 		gradu.cell(c)[0]=grad[0][0];
 		gradu.cell(c)[1]=grad[1][0];
 		gradu.cell(c)[2]=grad[2][0];
@@ -318,12 +369,12 @@ void NavierStokes::calc_cell_grads (void) {
 	 }
 
 	// Copy parent cell gradients to the boundary ghost cells
-	int bcno,parent,neighbor;
+	// Each boundary face has its own ghost, so the face loop is free of write conflicts
+	#pragma omp parallel for schedule(static)
 	for (int f=0;f<grid[gid].faceCount;++f) {
-		bcno=grid[gid].face[f].bc;
-		if (bcno>=0) {
-			parent=grid[gid].face[f].parent;
-			neighbor=grid[gid].face[f].neighbor;
+		if (grid[gid].face[f].bc>=0) {
+			int parent=grid[gid].face[f].parent;
+			int neighbor=grid[gid].face[f].neighbor;
 			gradp.cell(neighbor)=gradp.cell(parent);
 			gradu.cell(neighbor)=gradu.cell(parent);
 			gradv.cell(neighbor)=gradv.cell(parent);
@@ -335,6 +386,22 @@ void NavierStokes::calc_cell_grads (void) {
 	return;
 }
 
+bool NavierStokes::diverged_update(void) {
+	
+	int local_diverged=0,global_diverged;
+	
+	#pragma omp parallel for schedule(static) reduction(||:local_diverged)
+	for (int c=0;c<grid[gid].cellCount;++c) {
+		for (int i=0;i<5;++i) {
+			if (isnan(update[i].cell(c)) || isinf(update[i].cell(c))) local_diverged=1;
+		}
+	}
+	
+	MPI_Allreduce(&local_diverged,&global_diverged,1,MPI_INT,MPI_MAX,MPI_COMM_WORLD);
+	
+	return (global_diverged==1);
+}
+
 void NavierStokes::update_variables(void) {
 	
 	double residuals[3],ps_residuals[3],totalResiduals[3],total_ps_residuals[3];
@@ -343,15 +410,35 @@ void NavierStokes::update_variables(void) {
 		ps_residuals[i]=0.;
 	}
 
-	PetscInt row;
+	// Local portion of the pseudo time delta (rows of this partition are contiguous)
+	PetscScalar *pseudo_delta_local;
+	if (ps_step_max>1) VecGetArray(pseudo_delta,&pseudo_delta_local);
+	
+	// Each thread accumulates its own partial residuals over a fixed (static) cell range
+	// These are summed in thread order afterwards so that the result is reproducible
+	int nThreads=thread_count();
+	vector<double> partial_residuals (8*nThreads,0.); // padded to a cache line per thread
+	bool diverged=false;
 	
+	#pragma omp parallel
+	{
+	double *my_residuals=&partial_residuals[8*thread_id()];
 	double dt2,dtau2;
+	#pragma omp for schedule(static) reduction(||:diverged)
 	for (int c=0;c<grid[gid].cellCount;++c) {
+		bool cell_diverged=false;
 		for (int i=0;i<5;++i) {
-			if (isnan(update[i].cell(c)) || isinf(update[i].cell(c))) {
-				cerr << "[E] Divergence detected!...exiting" << endl;
-				MPI_Abort(MPI_COMM_WORLD,1);
-			}
+			if (isnan(update[i].cell(c)) || isinf(update[i].cell(c))) cell_diverged=true;
+		}
+		if (cell_diverged) {
+			diverged=true;
+			continue;
+		}
+		if (frozen_cell[c]) {
+			// State is kept, its residual counts with the last evaluated value
+			for (int i=0;i<5;++i) update[i].cell(c)=0.;
+			for (int i=0;i<3;++i) my_residuals[i]+=cell_residuals[3*c+i];
+			continue;
 		}
 		p.cell(c)+=update[0].cell(c);
 		T.cell(c)+=update[4].cell(c);
@@ -362,26 +449,39 @@ void NavierStokes::update_variables(void) {
 		
 		if (ps_step_max>1) {
 			dtau2=dtau[gid].cell(c)*dtau[gid].cell(c);
-			ps_residuals[0]+=update[0].cell(c)*update[0].cell(c)/dtau2;
-			ps_residuals[1]+=update[1].cell(c)*update[1].cell(c)/dtau2+update[2].cell(c)*update[2].cell(c)/dtau2+update[3].cell(c)*update[3].cell(c)/dtau2;
-			ps_residuals[2]+=update[4].cell(c)*update[4].cell(c)/dtau2;
+			my_residuals[3]+=update[0].cell(c)*update[0].cell(c)/dtau2;
+			my_residuals[4]+=update[1].cell(c)*update[1].cell(c)/dtau2+update[2].cell(c)*update[2].cell(c)/dtau2+update[3].cell(c)*update[3].cell(c)/dtau2;
+			my_residuals[5]+=update[4].cell(c)*update[4].cell(c)/dtau2;
 		}
 		
 		// If the last pseudo time step
 		if (ps_step_max>1) { // If pseudo time iterations are active
-			for (int i=0;i<5;++i) {
-				row=(grid[gid].myOffset+c)*5+i;
-				VecGetValues(pseudo_delta,1,&row,&update[i].cell(c));
-			}
+			for (int i=0;i<5;++i) update[i].cell(c)=pseudo_delta_local[c*5+i];
 		}
 		dt2=dt[gid].cell(c)*dt[gid].cell(c);
-		residuals[0]+=update[0].cell(c)*update[0].cell(c)/dt2;
-		residuals[1]+=update[1].cell(c)*update[1].cell(c)/dt2+update[2].cell(c)*update[2].cell(c)/dt2+update[3].cell(c)*update[3].cell(c)/dt2;
-		residuals[2]+=update[4].cell(c)*update[4].cell(c)/dt2;
-
-
+		double cell_res[3];
+		cell_res[0]=update[0].cell(c)*update[0].cell(c)/dt2;
+		cell_res[1]=update[1].cell(c)*update[1].cell(c)/dt2+update[2].cell(c)*update[2].cell(c)/dt2+update[3].cell(c)*update[3].cell(c)/dt2;
+		cell_res[2]=update[4].cell(c)*update[4].cell(c)/dt2;
+		for (int i=0;i<3;++i) my_residuals[i]+=cell_res[i];
+		if (active_threshold>0.) for (int i=0;i<3;++i) cell_residuals[3*c+i]=cell_res[i];
 		
 	} // cell loop
+	} // parallel region
+	
+	if (ps_step_max>1) VecRestoreArray(pseudo_delta,&pseudo_delta_local);
+	
+	if (diverged) {
+		cerr << "[E] Divergence detected!...exiting" << endl;
+		MPI_Abort(MPI_COMM_WORLD,1);
+	}
+	
+	for (int t=0;t<nThreads;++t) {
+		for (int i=0;i<3;++i) {
+			residuals[i]+=partial_residuals[8*t+i];
+			ps_residuals[i]+=partial_residuals[8*t+3+i];
+		}
+	}
 	
 	MPI_Allreduce(&residuals,&totalResiduals,3, MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
 	if (ps_step_max>1) MPI_Allreduce(&ps_residuals,&total_ps_residuals,3, MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
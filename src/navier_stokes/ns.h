@@ -29,6 +29,7 @@
 #include "grid.h"
 #include "inputs.h"
 #include "variable.h"
+#include "restart_file.h"
 #include "utilities.h"
 #include "material.h"
 #include "bc.h"
@@ -36,6 +37,7 @@
 #include "commons.h"
 #include "bc_interface.h"
 #include "loads.h"
+#include "linear_solver.h"
 
 #define NONE -1
 // Options for limiter
@@ -63,6 +65,25 @@ extern vector<vector<BC_Interface> > interface; // for each grid
 extern vector<bool> turbulent;
 extern vector<Loads> loads;
 
+// One level of the FAS multigrid cycle (see ns_multigrid.cc), level 0 is the grid itself
+class NS_FAS_Level {
+public:
+	int size; // Number of local control volumes
+	vector<int> agglomerate; // Control volume of this level containing each one of the level above
+	vector<int> cell2cv; // Control volume of this level containing each local cell
+	vector<bool> interior_face; // Face between two cells of the same control volume
+	vector<Vec3D> centroid; // Centroid of the control volume of each cell, partition ghosts included
+	vector<double> volume;
+	vector<double> state,state0; // Primitive variables, 5 per control volume, and their value before smoothing
+	vector<double> source; // Forcing term of the coarse problem
+	vector<double> residual; // Residual of the last evaluation (minus the source)
+	Mat prolongation; // Piecewise constant, from this level to the cells
+	Mat A; // Galerkin product of the implicit operator
+	bool A_created;
+	Vec b,x;
+	KSP ksp;
+};
+
 // Class for Navier-Stokes equations
 class NavierStokes {
 public:
@@ -74,6 +95,10 @@ public:
 	int ps_step;
 	int nIter;
 	double rNorm,res,ps_res;
+	double linear_reduction; // achieved by the last linear solve
+	bool linear_failed; // last linear solve broke down (running out of iterations doesn't count)
+	bool rollback; // diverged updates are discarded so that the time step can be retried
+	bool diverged; // last update was discarded
 	double qmax[5],qmin[5];
       
 	// MPI exchange buffer
@@ -93,6 +118,26 @@ public:
 	double Minf;
 	int preconditioner;
 	double wdiss,bl_height;
+	int mg_levels,mg_smoothing; // Number of multigrid levels (1 means none) and implicit smoothing steps per coarse level
+	
+	// FAS agglomeration multigrid (see ns_multigrid.cc)
+	vector<NS_FAS_Level> fas; // Empty without multigrid
+	int fas_level; // Level the assembly is evaluated for, 0 is the grid itself
+	bool residual_only; // Assembly skips the implicit operator
+	Vec fas_saved_delta;
+	
+	// Active set (see ns_active_set.cc)
+	double active_threshold; // 0 means all faces are evaluated every iteration
+	int full_sweep_frequency;
+	vector<bool> frozen_face,frozen_cell;
+	vector<double> cell_residuals; // 3 per cell, contribution to the total residuals at the last evaluation
+	double evaluated_faces,swept_faces; // since the last full sweep
+	
+	// LU-SGS implicit scheme (see ns_lusgs.cc)
+	bool lusgs; // impOP and the Krylov solver are not used
+	int lusgs_sweeps;
+	vector<double> diagonal_blocks; // 25 per cell, inverted before the sweeps
+	vector<vector<int> > lusgs_colors; // cells in sweep order, per color
 	
 	double small_number;
 	double order_factor;
@@ -110,6 +155,9 @@ public:
 	
 	// PETSC variables
 	KSP ksp; // linear solver context
+	KrylovRecycler recycler;
+	ForcingTerm forcing;
+	InitialGuess initial_guess;
 	PC pc; // preconditioner context
 	Vec deltaU,rhs; // solution, residual vectors
 	Mat impOP; // implicit operator matrix
@@ -117,6 +165,14 @@ public:
 	Vec pseudo_delta; // u^k-u^n
 	Vec pseudo_right;
 	
+	// Coupled NS+RANS block system (see ns_coupled.cc)
+	bool coupled;
+	KSP coupled_ksp;
+	Mat coupledOP;
+	Vec coupled_rhs,coupled_deltaU;
+	vector<double> mass_jacobian; // per face, mass flux change with the 5 parent then the 5 neighbor variables
+	vector<double> viscosity_jacobian; // per face, momentum and energy diffusive flux change with the face eddy viscosity
+	
 	NavierStokes (void); // Empty constructor
 	// TODO: sort the following list of functions in the proper order of application
 	void initialize(int ps_step_max);
@@ -125,6 +181,7 @@ public:
 	void mpi_init(void);
 	void mpi_update_ghost_primitives(void);
 	void mpi_update_ghost_gradients(void);
+	void mpi_update_ghost_updates(void);
 	void calc_cell_grads (void);
 	void set_bcs(void);
 	void set_interfaces(void);
@@ -132,6 +189,22 @@ public:
 	void petsc_init(void);
 	void petsc_solve(void);
 	void petsc_destroy(void);
+	void multigrid_init(void);
+	void multigrid_cycle(void);
+	void multigrid_level(int l);
+	void multigrid_evaluate(int l,bool jacobian);
+	void multigrid_face_geometry(NS_Face_State &face);
+	void active_set_init(void);
+	void active_set_update(void);
+	void lusgs_init(void);
+	void lusgs_solve(void);
+	void lusgs_sweep(PetscScalar *rhs_local,bool forward);
+	void lusgs_relax(int c,PetscScalar *rhs_local);
+	void lusgs_product(int c,int n,int f,double product[]);
+	void operator_add(int row,int col,double value);
+	void coupled_init(void);
+	void coupled_solve(void);
+	void coupled_destroy(void);
 	
 	void calc_limiter(void);
 	void venkatakrishnan_limiter(void); 
@@ -152,6 +225,7 @@ public:
 	void state_perturb(NS_Cell_State &state,NS_Face_State &face,int var,double epsilon);
 	void convective_face_flux(NS_Cell_State &left,NS_Cell_State &right,NS_Face_State &face,double flux[]);
 	void diffusive_face_flux(NS_Cell_State &left,NS_Cell_State &right,NS_Face_State &face,double flux[]);
+	void diffusive_flux_eddy_viscosity_derivative(NS_Face_State &face,double dflux[]);
 	void sources(NS_Cell_State &state,double source[],bool forJacobian=false);
 	void get_jacobians(const int var);
 	void apply_bcs(NS_Cell_State &left,NS_Cell_State &right,NS_Face_State &face);
@@ -161,12 +235,20 @@ public:
 	void outlet(NS_Cell_State &left,NS_Cell_State &right,NS_Face_State &face);
 	void wall(NS_Cell_State &left,NS_Cell_State &right,NS_Face_State &face,bool slip=false);
 	void symmetry(NS_Cell_State &left,NS_Cell_State &right,NS_Face_State &face);
+	bool diverged_update(void);
 	void update_variables(void);
 	void update_boundaries(void);
-	void write_restart(int timeStep);
-	void read_restart(int restart_step,vector<vector<int> > &partitionMap);
+	void write_restart(RestartFile &restart);
+	void read_restart(RestartFile &restart);
 	void find_min_max (void);
 
 };
 
+// Adds an entry of the implicit operator (global row and column), only the diagonal blocks are kept with LU-SGS
+inline void NavierStokes::operator_add(int row,int col,double value) {
+	if (!lusgs) MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
+	else if (row/5==col/5) diagonal_blocks[25*(row/5-grid[gid].myOffset)+5*(row%5)+col%5]+=value;
+	return;
+}
+
 #endif
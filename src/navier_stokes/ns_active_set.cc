@@ -0,0 +1,144 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer 
+ 
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include "ns.h"
+
+// Active set for steady solves: once most of the domain has converged, the faces away from
+// the cells that are still changing are not evaluated any more.
+// A cell is active while its residual is above active_threshold times the initial rms level
+// (per equation). A face is frozen when neither of its cells is active nor next to an active
+// cell. Cells that touch a frozen face are frozen as well: their rows of the linear system are
+// reduced to the time term with a zero right hand side, so their state (and the flux of their
+// frozen faces) stays at the last evaluation. As soon as activity reaches their neighbors they
+// are evaluated again. Partition faces and faces of boundaries with integrated loads are never
+// frozen. Every full_sweep_frequency iterations all faces are evaluated to catch any drift.
+void NavierStokes::active_set_init(void) {
+	
+	active_threshold=input.section("grid",gid).subsection("navierstokes").get_double("activesetthreshold");
+	full_sweep_frequency=input.section("grid",gid).subsection("navierstokes").get_int("fullsweepfrequency");
+	frozen_face.assign(grid[gid].faceCount,false);
+	frozen_cell.assign(grid[gid].cellCount,false);
+	evaluated_faces=0.;
+	swept_faces=0.;
+	
+	if (active_threshold<=0.) return;
+	
+	if (ps_step_max>1) {
+		if (Rank==0) cerr << "[E] Input entry grid_" << gid+1 << " -> navier stokes -> active set threshold is only available for steady (no pseudo time) solves" << endl;
+		exit(1);
+	}
+	if (coupled) {
+		if (Rank==0) cerr << "[E] Input entry grid_" << gid+1 << " -> navier stokes -> active set threshold is not available with coupled turbulence" << endl;
+		exit(1);
+	}
+	if (full_sweep_frequency<1) {
+		if (Rank==0) cerr << "[E] Input entry grid_" << gid+1 << " -> navier stokes -> full sweep frequency should be at least 1" << endl;
+		exit(1);
+	}
+	// Negative means not evaluated yet, such cells count as active
+	cell_residuals.assign(3*grid[gid].cellCount,-1.);
+	
+	if (Rank==0) cout << "[I grid=" << gid+1 << " ] Converged regions are frozen below a residual of " << active_threshold << " with a full sweep every " << full_sweep_frequency << " iterations" << endl;
+	
+	return;
+}
+
+void NavierStokes::active_set_update(void) {
+	
+	if (active_threshold<=0.) return;
+	
+	int cellCount=grid[gid].cellCount;
+	int faceCount=grid[gid].faceCount;
+	
+	frozen_face.assign(faceCount,false);
+	frozen_cell.assign(cellCount,false);
+	
+	bool full_sweep=(timeStep%full_sweep_frequency==0);
+	for (int i=0;i<3;++i) if (!(first_residuals[i]>0.)) full_sweep=true;
+	
+	if (full_sweep) {
+		if (swept_faces>0.) {
+			double local[2]={evaluated_faces,swept_faces},global[2];
+			MPI_Allreduce(local,global,2,MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
+			if (Rank==0) cout << "[I grid=" << gid+1 << " ] Active set: " << 100.*global[0]/global[1] << "% of the faces evaluated since the last full sweep" << endl;
+		}
+		evaluated_faces=0.;
+		swept_faces=0.;
+		return;
+	}
+	
+	// Cell residuals relative to the initial rms residual of each equation
+	double scale[3];
+	for (int i=0;i<3;++i) scale[i]=sqrt(double(grid[gid].globalCellCount))/first_residuals[i];
+	
+	vector<bool> active(cellCount,false);
+	for (int c=0;c<cellCount;++c) {
+		for (int i=0;i<3;++i) {
+			double level=cell_residuals[3*c+i];
+			if (level<0. || sqrt(level)*scale[i]>active_threshold) {
+				active[c]=true;
+				break;
+			}
+		}
+	}
+	
+	// Cells that are active or next to one; the activity of ghosts is not known here
+	vector<bool> near(active);
+	for (int f=0;f<faceCount;++f) {
+		int parent=grid[gid].face[f].parent;
+		int neighbor=grid[gid].face[f].neighbor;
+		if (grid[gid].face[f].bc==INTERNAL_FACE) {
+			if (active[parent]) near[neighbor]=true;
+			if (active[neighbor]) near[parent]=true;
+		} else if (grid[gid].face[f].bc==PARTITION_FACE) {
+			near[parent]=true;
+		}
+	}
+	
+	int evaluated=0;
+	for (int f=0;f<faceCount;++f) {
+		int parent=grid[gid].face[f].parent;
+		int neighbor=grid[gid].face[f].neighbor;
+		int face_bc=grid[gid].face[f].bc;
+		bool frozen=false;
+		if (face_bc==INTERNAL_FACE) {
+			frozen=(!near[parent] && !near[neighbor]);
+		} else if (face_bc>=0) {
+			frozen=!near[parent];
+			for (int b=0;b<loads[gid].include_bcs.size();++b) {
+				if (face_bc==loads[gid].include_bcs[b]) frozen=false;
+			}
+		}
+		if (frozen) {
+			frozen_face[f]=true;
+			frozen_cell[parent]=true;
+			if (face_bc==INTERNAL_FACE) frozen_cell[neighbor]=true;
+		} else {
+			evaluated++;
+		}
+	}
+	
+	evaluated_faces+=evaluated;
+	swept_faces+=faceCount;
+	
+	return;
+}
@@ -33,7 +33,8 @@ namespace ns_state {
 
 void NavierStokes::assemble_linear_system(void) {
 
-	MatZeroEntries(impOP);
+	if (lusgs) diagonal_blocks.assign(diagonal_blocks.size(),0.);
+	else if (!residual_only) MatZeroEntries(impOP);
 	
 	using namespace ns_state;
 	using ns_state::left;
@@ -41,6 +42,8 @@ void NavierStokes::assemble_linear_system(void) {
 		
 	int parent,neighbor,f;
 	int row,col;
+	bool freeze_parent,freeze_neighbor; // rows of frozen cells only keep their time terms
+	bool record=(fas_level==0 && !residual_only); // loads and surface values only come from the regular evaluation
 	
 	vector<bool> cellVisited;
 	for (int c=0;c<grid[gid].cellCount;++c) cellVisited.push_back(false);
@@ -82,15 +85,24 @@ void NavierStokes::assemble_linear_system(void) {
 			sourceRight[m]=0.;
 		}
 		parent=grid[gid].face[f].parent; neighbor=grid[gid].face[f].neighbor;
+		
+		// Converged region, only frozen cells see this face (see ns_active_set.cc)
+		if (frozen_face[f]) continue;
+		// Inside a control volume of the multigrid level being evaluated (see ns_multigrid.cc)
+		if (fas_level>0 && fas[fas_level].interior_face[f]) continue;
+		freeze_parent=frozen_cell[parent];
+		freeze_neighbor=(grid[gid].face[f].bc==INTERNAL_FACE && frozen_cell[neighbor]);
 
 		// Populate the state caches
 		face_geom_update(face,f);
+		if (fas_level>0) multigrid_face_geometry(face);
 		left_state_update(left,face);
 		right_state_update(left,right,face);
 		face_state_update(left,right,face);
 		// Get unperturbed flux values
 		convective_face_flux(left,right,face,&flux.convective[0]);
 		diffusive_face_flux(left,right,face,&flux.diffusive[0]);
+		if (coupled) diffusive_flux_eddy_viscosity_derivative(face,&viscosity_jacobian[4*f]);
 		
 		// Add Sources
 		if (!cellVisited[parent]){
@@ -106,7 +118,7 @@ void NavierStokes::assemble_linear_system(void) {
 		}
 	
 		// Integrate boundary loads
-		if ((timeStep) % loads[gid].frequency == 0) {
+		if (record && (timeStep) % loads[gid].frequency == 0) {
 			Vec3D temp;
 			for (int b=0;b<loads[gid].include_bcs.size();++b) {
 				if (face.bc==loads[gid].include_bcs[b]) {
@@ -120,8 +132,8 @@ void NavierStokes::assemble_linear_system(void) {
 	
 		// Fill in surface information
 	
-		mdot.face(face.index)=(flux.convective[0]-flux.diffusive[0])/face.area;	
-		if (face.bc>=0) {
+		if (record) mdot.face(face.index)=(flux.convective[0]-flux.diffusive[0])/face.area;	
+		if (record && face.bc>=0) {
 			//if (!mdot.fixedonBC[face.bc]) mdot.bc(face.bc,face.index)=(flux.convective[0]-flux.diffusive[0])/face.area;
 			if (!qdot.fixedonBC[face.bc]) qdot.bc(face.bc,face.index)=(flux.convective[4]-flux.diffusive[4])/face.area;
 			for (int i=0;i<3;++i) tau.bc(face.bc,face.index)[i]=-flux.diffusive[i+1]/face.area;
@@ -131,13 +143,15 @@ void NavierStokes::assemble_linear_system(void) {
 		for (int i=0;i<5;++i) {
 			row=(grid[gid].myOffset+parent)*5+i;
 			value=flux.diffusive[i]-flux.convective[i]+sourceLeft[i];
-			VecSetValues(rhs,1,&row,&value,ADD_VALUES);
-			if (grid[gid].face[f].bc==INTERNAL_FACE) { 
+			if (!freeze_parent) VecSetValues(rhs,1,&row,&value,ADD_VALUES);
+			if (grid[gid].face[f].bc==INTERNAL_FACE && !freeze_neighbor) { 
 				row=(grid[gid].myOffset+neighbor)*5+i;
 				value=-1.*(flux.diffusive[i]-flux.convective[i])+sourceRight[i];
 				VecSetValues(rhs,1,&row,&value,ADD_VALUES);
 			}
 		}
+		
+		if (residual_only) continue;
 
 		//if (implicit && ps_timeStep==1) { // TODO: Get this working
 
@@ -149,6 +163,12 @@ void NavierStokes::assemble_linear_system(void) {
 				}
 				
 				get_jacobians(i);
+				
+				// Mass flux Jacobian for the turbulence equations in the coupled system
+				if (coupled) {
+					mass_jacobian[10*f+i]=jacobianLeft[0];
+					if (face.bc==INTERNAL_FACE || face.bc==PARTITION_FACE) mass_jacobian[10*f+5+i]=jacobianRight[0];
+				}
 	
 				// Add change of flux (flux Jacobian) to implicit operator
 				for (int j=0;j<5;++j) {
@@ -156,11 +176,11 @@ void NavierStokes::assemble_linear_system(void) {
 					row=(grid[gid].myOffset+parent)*5+j; // on parent jth flux
 					value=-1.*jacobianLeft[j];
 					//if (doLeftSourceJac) value-=sourceJacLeft[j];
-					MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
-					if (face.bc==INTERNAL_FACE) { 
+					if (!freeze_parent) operator_add(row,col,value);
+					if (face.bc==INTERNAL_FACE && !freeze_neighbor) { 
 						row=(grid[gid].myOffset+neighbor)*5+j; // on neighbor jth flux
 						value=jacobianLeft[j]; 
-						MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
+						operator_add(row,col,value);
 					}
 				} // for j
 
@@ -170,10 +190,10 @@ void NavierStokes::assemble_linear_system(void) {
 						row=(grid[gid].myOffset+neighbor)*5+j; // on neighbor jth flux
 						value=jacobianRight[j];
 						//if (doRightSourceJac) value-=sourceJacRight[j];
-						MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
+						if (!freeze_neighbor) operator_add(row,col,value);
 						row=(grid[gid].myOffset+parent)*5+j; // on parent jth flux
 						value=-1.*jacobianRight[j];
-						MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
+						if (!freeze_parent) operator_add(row,col,value);
 					}
 				} else if (face.bc==PARTITION_FACE) { 
 					// Ghost (only add effect on parent cell, effect on itself is taken care of in its own partition
@@ -181,7 +201,7 @@ void NavierStokes::assemble_linear_system(void) {
 						row=(grid[gid].myOffset+parent)*5+j;
 						col=(grid[gid].cell[neighbor].matrix_id)*5+i;
 						value=-1.*jacobianRight[j];
-						MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
+						if (!freeze_parent) operator_add(row,col,value);
 					}
 						
 				} // if 
@@ -0,0 +1,237 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer 
+ 
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include "ns.h"
+#include "rans.h"
+
+extern vector<RANS> rans;
+
+// Coupled solve of the mean flow and turbulence equations
+// The 5 NS and 2 RANS unknowns of each cell form one 7 variable block. The NS and
+// RANS operators are assembled as in the segregated mode and copied into the block
+// system, which adds the cross coupling Jacobians:
+//  - k and omega convective fluxes through the mass flux Jacobian of the NS assembly
+//  - NS diffusive fluxes through the eddy viscosity (d mu_t/dk, d mu_t/domega)
+// Source term couplings (strain rate in the k production) stay lagged.
+
+void NavierStokes::coupled_init(void) {
+	
+	vector<int> diagonal_nonzeros, off_diagonal_nonzeros;
+	
+	for (int c=0;c<grid[gid].cellCount;++c) {
+		int nextCellCount=0;
+		for (int i=0;i<grid[gid].cell[c].faces.size();++i) {
+			if (grid[gid].face[grid[gid].cell[c].faces[i]].bc==INTERNAL_FACE) nextCellCount++;
+		}
+		int cellGhostCount=0;
+		for (int cc=0;cc<grid[gid].cell[c].neighborCells.size();++cc) if (grid[gid].cell[grid[gid].cell[c].neighborCells[cc]].partition!=Rank) cellGhostCount++;
+		for (int i=0;i<7;++i) {
+			diagonal_nonzeros.push_back((nextCellCount+1)*7);
+			off_diagonal_nonzeros.push_back(cellGhostCount*7);
+		}
+	}
+	
+	MatCreateMPIAIJ(
+			PETSC_COMM_WORLD,
+			grid[gid].cellCount*7,
+			grid[gid].cellCount*7,
+			grid[gid].globalCellCount*7,
+			grid[gid].globalCellCount*7,
+			0,&diagonal_nonzeros[0],
+			0,&off_diagonal_nonzeros[0],
+			&coupledOP);
+	
+	VecCreateMPI(PETSC_COMM_WORLD,grid[gid].cellCount*7,grid[gid].globalCellCount*7,&coupled_rhs);
+	VecDuplicate(coupled_rhs,&coupled_deltaU);
+	VecSet(coupled_deltaU,0.);
+	
+	KSPCreate(PETSC_COMM_WORLD,&coupled_ksp);
+	KSPSetOperators(coupled_ksp,coupledOP,coupledOP,SAME_NONZERO_PATTERN);
+	KSPSetTolerances(coupled_ksp,rtol,abstol,1.e15,maxits);
+	KSPSetInitialGuessKnoll(coupled_ksp,PETSC_TRUE);
+	set_linear_solver_options(coupled_ksp,gid,"navierstokes","nsrans"+int2str(gid+1)+"_");
+	KSPSetFromOptions(coupled_ksp);
+	
+	mass_jacobian.resize(10*grid[gid].faceCount,0.);
+	viscosity_jacobian.resize(4*grid[gid].faceCount,0.);
+	
+	if (Rank==0) cout << "[I grid=" << gid+1 << " ] Solving the navier stokes and turbulence equations coupled" << endl;
+	
+	return;
+}
+
+// Copies the local rows of a segregated operator into the block system
+// Row and column g*nVars+i of the source become g*7+offset+i
+void copy_block_rows(Mat source,int nVars,int offset,int first_cell,int cell_count,Mat target) {
+	
+	int ncols;
+	const int *cols;
+	const double *values;
+	vector<int> target_cols;
+	
+	for (int row=first_cell*nVars;row<(first_cell+cell_count)*nVars;++row) {
+		MatGetRow(source,row,&ncols,&cols,&values);
+		target_cols.resize(ncols);
+		for (int j=0;j<ncols;++j) target_cols[j]=(cols[j]/nVars)*7+offset+cols[j]%nVars;
+		int target_row=(row/nVars)*7+offset+row%nVars;
+		if (ncols>0) MatSetValues(target,1,&target_row,ncols,&target_cols[0],values,ADD_VALUES);
+		MatRestoreRow(source,row,&ncols,&cols,&values);
+	}
+	
+	return;
+}
+
+void NavierStokes::coupled_solve(void) {
+	
+	RANS &turb=rans[gid];
+	
+	MatAssemblyBegin(impOP,MAT_FINAL_ASSEMBLY);
+	MatAssemblyEnd(impOP,MAT_FINAL_ASSEMBLY);
+	VecAssemblyBegin(rhs);
+	VecAssemblyEnd(rhs);
+	MatAssemblyBegin(turb.impOP,MAT_FINAL_ASSEMBLY);
+	MatAssemblyEnd(turb.impOP,MAT_FINAL_ASSEMBLY);
+	VecAssemblyBegin(turb.rhs);
+	VecAssemblyEnd(turb.rhs);
+	
+	MatZeroEntries(coupledOP);
+	copy_block_rows(impOP,5,0,grid[gid].myOffset,grid[gid].cellCount,coupledOP);
+	copy_block_rows(turb.impOP,2,5,grid[gid].myOffset,grid[gid].cellCount,coupledOP);
+	
+	// Eddy viscosity sensitivities of all cells including the ghosts
+	vector<double> dmut_dk(grid[gid].cell.size()),dmut_domega(grid[gid].cell.size());
+	for (int c=0;c<grid[gid].cell.size();++c) turb.eddy_viscosity_derivatives(c,dmut_dk[c],dmut_domega[c]);
+	
+	int row,col;
+	double value;
+	for (int f=0;f<grid[gid].faceCount;++f) {
+		int bc=grid[gid].face[f].bc;
+		int parent=grid[gid].face[f].parent;
+		int neighbor=grid[gid].face[f].neighbor;
+		int parent_id=grid[gid].myOffset+parent;
+		int neighbor_id=-1;
+		if (bc==INTERNAL_FACE) neighbor_id=grid[gid].myOffset+neighbor;
+		else if (bc==PARTITION_FACE) neighbor_id=grid[gid].cell[neighbor].matrix_id;
+		
+		// Effect of the mean flow on the k and omega convective fluxes
+		// The rows are -d(rhs)/dq as in the segregated operators
+		double weightL_f=weightL.face(f);
+		double face_turb[2];
+		face_turb[0]=weightL_f*turb.k.cell(parent)+(1.-weightL_f)*turb.k.cell(neighbor);
+		face_turb[1]=weightL_f*turb.omega.cell(parent)+(1.-weightL_f)*turb.omega.cell(neighbor);
+		for (int t=0;t<2;++t) {
+			for (int i=0;i<5;++i) {
+				row=parent_id*7+5+t;
+				col=parent_id*7+i; value=-mass_jacobian[10*f+i]*face_turb[t];
+				MatSetValues(coupledOP,1,&row,1,&col,&value,ADD_VALUES);
+				if (neighbor_id>=0) {
+					col=neighbor_id*7+i; value=-mass_jacobian[10*f+5+i]*face_turb[t];
+					MatSetValues(coupledOP,1,&row,1,&col,&value,ADD_VALUES);
+				}
+				if (bc==INTERNAL_FACE) {
+					row=neighbor_id*7+5+t;
+					col=parent_id*7+i; value=mass_jacobian[10*f+i]*face_turb[t];
+					MatSetValues(coupledOP,1,&row,1,&col,&value,ADD_VALUES);
+					col=neighbor_id*7+i; value=mass_jacobian[10*f+5+i]*face_turb[t];
+					MatSetValues(coupledOP,1,&row,1,&col,&value,ADD_VALUES);
+				}
+			}
+		}
+		
+		// Effect of k and omega on the mean flow diffusive fluxes through the face eddy viscosity
+		// (taken as the average of the two sides, boundary faces are skipped)
+		if (neighbor_id<0) continue;
+		double dmut[2][2]; // [side][k or omega]
+		dmut[0][0]=0.5*dmut_dk[parent]; dmut[0][1]=0.5*dmut_domega[parent];
+		dmut[1][0]=0.5*dmut_dk[neighbor]; dmut[1][1]=0.5*dmut_domega[neighbor];
+		for (int j=1;j<5;++j) {
+			double dflux=viscosity_jacobian[4*f+j-1];
+			for (int t=0;t<2;++t) {
+				row=parent_id*7+j;
+				col=parent_id*7+5+t; value=-dflux*dmut[0][t];
+				MatSetValues(coupledOP,1,&row,1,&col,&value,ADD_VALUES);
+				col=neighbor_id*7+5+t; value=-dflux*dmut[1][t];
+				MatSetValues(coupledOP,1,&row,1,&col,&value,ADD_VALUES);
+				if (bc==INTERNAL_FACE) {
+					row=neighbor_id*7+j;
+					col=parent_id*7+5+t; value=dflux*dmut[0][t];
+					MatSetValues(coupledOP,1,&row,1,&col,&value,ADD_VALUES);
+					col=neighbor_id*7+5+t; value=dflux*dmut[1][t];
+					MatSetValues(coupledOP,1,&row,1,&col,&value,ADD_VALUES);
+				}
+			}
+		}
+	}
+	
+	MatAssemblyBegin(coupledOP,MAT_FINAL_ASSEMBLY);
+	MatAssemblyEnd(coupledOP,MAT_FINAL_ASSEMBLY);
+	
+	// Interleave the right hand sides (rows of this partition are contiguous in all three)
+	PetscScalar *ns_rhs,*turb_rhs,*block_rhs;
+	VecGetArray(rhs,&ns_rhs);
+	VecGetArray(turb.rhs,&turb_rhs);
+	VecGetArray(coupled_rhs,&block_rhs);
+	for (int c=0;c<grid[gid].cellCount;++c) {
+		for (int i=0;i<5;++i) block_rhs[c*7+i]=ns_rhs[c*5+i];
+		for (int i=0;i<2;++i) block_rhs[c*7+5+i]=turb_rhs[c*2+i];
+	}
+	VecRestoreArray(rhs,&ns_rhs);
+	VecRestoreArray(turb.rhs,&turb_rhs);
+	VecRestoreArray(coupled_rhs,&block_rhs);
+	
+	PetscReal rhs_norm;
+	VecNorm(coupled_rhs,NORM_2,&rhs_norm);
+	if (ps_step_max>1 && ps_step==1) forcing.reset();
+	KSPSetTolerances(coupled_ksp,forcing.tolerance(rhs_norm),abstol,1.e15,maxits);
+	
+	KSPSetOperators(coupled_ksp,coupledOP,coupledOP,SAME_NONZERO_PATTERN);
+	KSPSolve(coupled_ksp,coupled_rhs,coupled_deltaU);
+	KSPGetIterationNumber(coupled_ksp,&nIter);
+	KSPGetResidualNorm(coupled_ksp,&rNorm);
+	linear_reduction=(rhs_norm>0.) ? rNorm/rhs_norm : 0.;
+	KSPConvergedReason reason;
+	KSPGetConvergedReason(coupled_ksp,&reason);
+	linear_failed=(nIter>0 && reason<0 && reason!=KSP_DIVERGED_ITS);
+	turb.nIter=nIter;
+	turb.rNorm=rNorm;
+	turb.linear_reduction=linear_reduction;
+	
+	PetscScalar *solution;
+	VecGetArray(coupled_deltaU,&solution);
+	for (int c=0;c<grid[gid].cellCount;++c) {
+		for (int i=0;i<5;++i) update[i].cell(c)=solution[c*7+i];
+		for (int i=0;i<2;++i) turb.update[i].cell(c)=solution[c*7+5+i];
+	}
+	VecRestoreArray(coupled_deltaU,&solution);
+	
+	VecSet(rhs,0.);
+	
+	return;
+}
+
+void NavierStokes::coupled_destroy(void) {
+	KSPDestroy(coupled_ksp);
+	MatDestroy(coupledOP);
+	VecDestroy(coupled_rhs);
+	VecDestroy(coupled_deltaU);
+	return;
+}
@@ -63,3 +63,28 @@ void NavierStokes::diffusive_face_flux(NS_Cell_State &left,NS_Cell_State &right,
 	return;
 }
 
+// Change of the momentum and energy diffusive fluxes (flux[1] to flux[4] above) with the face eddy viscosity
+void NavierStokes::diffusive_flux_eddy_viscosity_derivative(NS_Face_State &face,double dflux[]) {
+
+	Vec3D tau_x,tau_y,tau_z,areaVec;
+	
+	areaVec=face.normal*face.area;
+	tau_x[0]=2./3.*(2.*face.gradu[0]-face.gradv[1]-face.gradw[2]);
+	tau_x[1]=face.gradu[1]+face.gradv[0];
+	tau_x[2]=face.gradu[2]+face.gradw[0];
+	tau_y[0]=tau_x[1];
+	tau_y[1]=2./3.* (2.*face.gradv[1]-face.gradu[0]-face.gradw[2]);
+	tau_y[2]=face.gradv[2]+face.gradw[1];
+	tau_z[0]=tau_x[2];
+	tau_z[1]=tau_y[2];
+	tau_z[2]=2./3.*(2.*face.gradw[2]-face.gradu[0]-face.gradv[1]);
+	
+	dflux[0]=tau_x.dot(areaVec);
+	dflux[1]=tau_y.dot(areaVec);
+	dflux[2]=tau_z.dot(areaVec);
+	dflux[3]=tau_x.dot(face.V)*areaVec[0]+tau_y.dot(face.V)*areaVec[1]+tau_z.dot(face.V)*areaVec[2];
+	dflux[3]+=material.Cp(face.T)/rans[gid].Pr_t*face.gradT.dot(areaVec);
+	
+	return;
+}
+
@@ -49,6 +49,7 @@ void NavierStokes::minmod_limiter(void) {
 	double deltaU,deltaUg;
 	double small=1.e-12;
 	
+	#pragma omp parallel for schedule(static) private(neighbor,phi,deltaU,deltaUg)
 	for (int c=0;c<grid[gid].cellCount;++c) {
 		
 		for (int i=0;i<5;++i) phi[i]=1.;
@@ -99,6 +100,7 @@ void NavierStokes::barth_jespersen_limiter(void) {
 	double umax[5],umin[5];
 
 	
+	#pragma omp parallel for schedule(static) private(neighbor,phi,deltaP,deltaM,umax,umin)
 	for (int c=0;c<grid[gid].cellCount;++c) {
 		
 		for (int i=0;i<5;++i) phi[i]=1.;
@@ -174,6 +176,7 @@ void NavierStokes::venkatakrishnan_limiter(void) {
 	Lref=grid[gid].lengthScale;
 	for (int i=0;i<5;++i) deltaRef[i]=fabs(qmax[i]-qmin[i]);
 
+	#pragma omp parallel for schedule(static) private(neighbor,phi,deltaP,deltaP2,deltaM,deltaM2,eps,eps2,umax,umin)
 	for (int c=0;c<grid[gid].cellCount;++c) {
 		
 		for (int i=0;i<5;++i) {
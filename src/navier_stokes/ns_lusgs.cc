@@ -0,0 +1,273 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer 
+ 
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include <algorithm>
+#include "ns.h"
+#include "rans.h"
+
+extern vector<RANS> rans;
+
+// LU-SGS implicit scheme, used instead of assembling impOP for a Krylov solver
+// Only the 5x5 diagonal blocks of the implicit operator are stored (time terms and the finite
+// difference Jacobians of the face fluxes with respect to the own cell). The off-diagonal
+// products come from the spectral radius splitting of the face flux:
+//   O_cn*dQ_n = 0.5*area*(dF_n-r*dU_n)
+// where dF_n and dU_n are the changes of the inviscid flux (normal pointing out of c) and of the
+// conserved variables of neighbor n with its update dQ_n, and r is the spectral radius at the
+// face, including a viscous part. The system is relaxed by symmetric Gauss-Seidel sweeps, one
+// sweep starting from zero being the classical LU-SGS factorization. Without threads the cells
+// are swept in cell order. With threads they are swept color by color, no two cells of a color
+// share a face. Partition ghosts receive the updates of the other processors after each sweep.
+
+// In place inverse by Gauss-Jordan elimination with partial pivoting
+static void invert_block(double A[25]) {
+	double inverse[25];
+	for (int i=0;i<25;++i) inverse[i]=(i%6==0) ? 1. : 0.;
+	for (int k=0;k<5;++k) {
+		int pivot=k;
+		for (int i=k+1;i<5;++i) if (fabs(A[5*i+k])>fabs(A[5*pivot+k])) pivot=i;
+		if (pivot!=k) {
+			for (int j=0;j<5;++j) {
+				swap(A[5*k+j],A[5*pivot+j]);
+				swap(inverse[5*k+j],inverse[5*pivot+j]);
+			}
+		}
+		double factor=1./A[5*k+k];
+		for (int j=0;j<5;++j) {
+			A[5*k+j]*=factor;
+			inverse[5*k+j]*=factor;
+		}
+		for (int i=0;i<5;++i) {
+			if (i==k) continue;
+			factor=A[5*i+k];
+			if (factor==0.) continue;
+			for (int j=0;j<5;++j) {
+				A[5*i+j]-=factor*A[5*k+j];
+				inverse[5*i+j]-=factor*inverse[5*k+j];
+			}
+		}
+	}
+	for (int i=0;i<25;++i) A[i]=inverse[i];
+	return;
+}
+
+// Conserved variables and inviscid flux along normal for a primitive state
+static void conserved_flux(MATERIAL &material,double p,Vec3D V,double T,Vec3D normal,double U[5],double F[5]) {
+	double rho=material.rho(p,T);
+	double a=material.a(p,T);
+	double H=a*a/(material.gamma-1.)+0.5*V.dot(V);
+	double Vn=V.dot(normal);
+	U[0]=rho;
+	U[1]=rho*V[0];
+	U[2]=rho*V[1];
+	U[3]=rho*V[2];
+	U[4]=rho*H-(p+material.Pref);
+	F[0]=rho*Vn;
+	F[1]=rho*V[0]*Vn+p*normal[0];
+	F[2]=rho*V[1]*Vn+p*normal[1];
+	F[3]=rho*V[2]*Vn+p*normal[2];
+	F[4]=rho*H*Vn;
+	return;
+}
+
+void NavierStokes::lusgs_init(void) {
+	
+	int cellCount=grid[gid].cellCount;
+	diagonal_blocks.assign(25*cellCount,0.);
+	lusgs_colors.clear();
+	
+	if (thread_count()==1) {
+		// A single color in cell order
+		lusgs_colors.resize(1);
+		for (int c=0;c<cellCount;++c) lusgs_colors[0].push_back(c);
+	} else {
+		// Greedy coloring over the internal faces
+		vector<int> color(cellCount,-1);
+		vector<int> used;
+		for (int c=0;c<cellCount;++c) {
+			used.clear();
+			for (int cf=0;cf<grid[gid].cell[c].faces.size();++cf) {
+				int f=grid[gid].cell[c].faces[cf];
+				if (grid[gid].face[f].bc!=INTERNAL_FACE) continue;
+				int n=(grid[gid].face[f].parent==c) ? grid[gid].face[f].neighbor : grid[gid].face[f].parent;
+				if (color[n]>=0) used.push_back(color[n]);
+			}
+			int k=0;
+			while (find(used.begin(),used.end(),k)!=used.end()) k++;
+			color[c]=k;
+			if (k>=lusgs_colors.size()) lusgs_colors.resize(k+1);
+			lusgs_colors[k].push_back(c);
+		}
+	}
+	
+	if (Rank==0) {
+		cout << "[I grid=" << gid+1 << " ] Using LU-SGS with " << lusgs_sweeps << " symmetric sweep(s)";
+		if (lusgs_colors.size()>1) cout << " over " << lusgs_colors.size() << " cell colors";
+		cout << endl;
+	}
+	
+	return;
+}
+
+void NavierStokes::lusgs_product(int c,int n,int f,double product[]) {
+	
+	double dQ[5];
+	bool zero=true;
+	for (int i=0;i<5;++i) {
+		dQ[i]=update[i].cell(n);
+		if (dQ[i]!=0.) zero=false;
+	}
+	if (zero) {
+		for (int i=0;i<5;++i) product[i]=0.;
+		return;
+	}
+	
+	Vec3D normal=grid[gid].face[f].normal;
+	if (grid[gid].face[f].parent!=c) normal=-1.*normal;
+	
+	double U0[5],F0[5],U1[5],F1[5];
+	Vec3D dV(dQ[1],dQ[2],dQ[3]);
+	conserved_flux(material,p.cell(n),V.cell(n),T.cell(n),normal,U0,F0);
+	conserved_flux(material,p.cell(n)+dQ[0],V.cell(n)+dV,T.cell(n)+dQ[4],normal,U1,F1);
+	
+	// Spectral radius at the face: convective plus viscous (momentum or heat diffusion)
+	double T_face=0.5*(T.cell(c)+T.cell(n));
+	double rho_face=0.5*(material.rho(p.cell(c),T.cell(c))+material.rho(p.cell(n),T.cell(n)));
+	double Vn=fabs((0.5*(V.cell(c)+V.cell(n))).dot(normal));
+	double a=0.5*(material.a(p.cell(c),T.cell(c))+material.a(p.cell(n),T.cell(n)));
+	double mu=material.viscosity(T_face);
+	double Cp=material.Cp(T_face);
+	double lambda=material.therm_cond(T_face);
+	if (turbulent[gid]) {
+		mu+=rans[gid].mu_t.face(f);
+		lambda+=Cp*rans[gid].mu_t.face(f)/rans[gid].Pr_t;
+	}
+	double distance=fabs((grid[gid].cell[n].centroid-grid[gid].cell[c].centroid).dot(normal));
+	double radius=Vn+a;
+	if (distance>0.) radius+=2.*max(4./3.*mu,material.gamma*lambda/Cp)/(rho_face*distance);
+	
+	for (int i=0;i<5;++i) product[i]=0.5*grid[gid].face[f].area*((F1[i]-F0[i])-radius*(U1[i]-U0[i]));
+	
+	return;
+}
+
+void NavierStokes::lusgs_relax(int c,PetscScalar *rhs_local) {
+	
+	// Frozen cells of the active set keep their state
+	if (frozen_cell[c]) return;
+	
+	double r[5],product[5];
+	for (int i=0;i<5;++i) r[i]=rhs_local[5*c+i];
+	
+	for (int cf=0;cf<grid[gid].cell[c].faces.size();++cf) {
+		int f=grid[gid].cell[c].faces[cf];
+		if (grid[gid].face[f].bc!=INTERNAL_FACE && grid[gid].face[f].bc!=PARTITION_FACE) continue;
+		int n=(grid[gid].face[f].parent==c) ? grid[gid].face[f].neighbor : grid[gid].face[f].parent;
+		lusgs_product(c,n,f,product);
+		for (int i=0;i<5;++i) r[i]-=product[i];
+	}
+	
+	double *inverse=&diagonal_blocks[25*c];
+	for (int i=0;i<5;++i) {
+		double value=0.;
+		for (int j=0;j<5;++j) value+=inverse[5*i+j]*r[j];
+		update[i].cell(c)=value;
+	}
+	
+	return;
+}
+
+void NavierStokes::lusgs_sweep(PetscScalar *rhs_local,bool forward) {
+	
+	int nColors=lusgs_colors.size();
+	for (int k=0;k<nColors;++k) {
+		vector<int> &cells=lusgs_colors[(forward) ? k : nColors-1-k];
+		int count=cells.size();
+		#pragma omp parallel for schedule(static)
+		for (int i=0;i<count;++i) {
+			lusgs_relax(cells[(forward) ? i : count-1-i],rhs_local);
+		}
+	}
+	
+	return;
+}
+
+void NavierStokes::lusgs_solve(void) {
+	
+	VecAssemblyBegin(rhs);
+	VecAssemblyEnd(rhs);
+	
+	int cellCount=grid[gid].cellCount;
+	
+	// The blocks themselves are needed for the linear residual after the sweeps
+	vector<double> blocks (diagonal_blocks);
+	#pragma omp parallel for schedule(static)
+	for (int c=0;c<cellCount;++c) invert_block(&diagonal_blocks[25*c]);
+	
+	for (int i=0;i<5;++i) {
+		for (int c=0;c<cellCount;++c) update[i].cell(c)=0.;
+		for (int g=grid[gid].partition_ghosts_begin;g<=grid[gid].partition_ghosts_end;++g) update[i].cell(g)=0.;
+	}
+	
+	PetscScalar *rhs_local;
+	VecGetArray(rhs,&rhs_local);
+	for (int sweep=0;sweep<lusgs_sweeps;++sweep) {
+		lusgs_sweep(rhs_local,true);
+		mpi_update_ghost_updates();
+		lusgs_sweep(rhs_local,false);
+		mpi_update_ghost_updates();
+	}
+	
+	// Linear residual ||rhs-O*dQ|| with the same splitting as the sweeps (rows of frozen cells are exact)
+	double rhs_norm2=0.,residual_norm2=0.;
+	#pragma omp parallel for schedule(static) reduction(+:rhs_norm2,residual_norm2)
+	for (int c=0;c<cellCount;++c) {
+		if (frozen_cell[c]) continue;
+		double r[5],product[5];
+		for (int i=0;i<5;++i) {
+			r[i]=rhs_local[5*c+i];
+			rhs_norm2+=r[i]*r[i];
+			for (int j=0;j<5;++j) r[i]-=blocks[25*c+5*i+j]*update[j].cell(c);
+		}
+		for (int cf=0;cf<grid[gid].cell[c].faces.size();++cf) {
+			int f=grid[gid].cell[c].faces[cf];
+			if (grid[gid].face[f].bc!=INTERNAL_FACE && grid[gid].face[f].bc!=PARTITION_FACE) continue;
+			int n=(grid[gid].face[f].parent==c) ? grid[gid].face[f].neighbor : grid[gid].face[f].parent;
+			lusgs_product(c,n,f,product);
+			for (int i=0;i<5;++i) r[i]-=product[i];
+		}
+		for (int i=0;i<5;++i) residual_norm2+=r[i]*r[i];
+	}
+	VecRestoreArray(rhs,&rhs_local);
+	double local_norms[2]={rhs_norm2,residual_norm2},global_norms[2];
+	MPI_Allreduce(local_norms,global_norms,2,MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
+	
+	// The sweep count takes the place of the iteration count
+	nIter=lusgs_sweeps;
+	rNorm=sqrt(global_norms[1]);
+	linear_reduction=(global_norms[0]>0.) ? rNorm/sqrt(global_norms[0]) : 0.;
+	linear_failed=false;
+	
+	VecSet(rhs,0.);
+	
+	return;
+}
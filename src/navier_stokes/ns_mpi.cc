@@ -145,6 +145,52 @@ void NavierStokes::mpi_update_ghost_primitives(void) {
 	return;
 } 
 
+// Partition ghosts get the updates of the other processors (between LU-SGS sweeps)
+void NavierStokes::mpi_update_ghost_updates(void) {
+
+	int id,offset;
+
+	send_req_count=0; recv_req_count=0;
+
+	for (int proc=0;proc<np;++proc) {
+		if (Rank!=proc) {
+			if (grid[gid].sendCells[proc].size()!=0) {
+				for (int g=0;g<grid[gid].sendCells[proc].size();++g) {
+					id=grid[gid].sendCells[proc][g];
+					offset=mpi_send_offset[proc];
+					for (int i=0;i<5;++i) sendBuffer[offset+g*5+i]=update[i].cell(id);
+				}
+
+				MPI_Isend(&sendBuffer[offset],grid[gid].sendCells[proc].size()*5,MPI_DOUBLE,proc,0,MPI_COMM_WORLD,&send_request[send_req_count]);
+				send_req_count++;
+			}
+
+			if (grid[gid].recvCells[proc].size()!=0) {
+				offset=mpi_recv_offset[proc];
+				MPI_Irecv(&recvBuffer[offset],grid[gid].recvCells[proc].size()*5,MPI_DOUBLE,proc,0,MPI_COMM_WORLD,&recv_request[recv_req_count]);
+				recv_req_count++;
+			}
+		}
+	}
+
+	MPI_Waitall(recv_request.size(),&recv_request[0],MPI_STATUS_IGNORE);
+
+	for (int proc=0;proc<np;++proc) { 
+		if (Rank!=proc) {
+			offset=mpi_recv_offset[proc];
+			for (int g=0;g<grid[gid].recvCells[proc].size();++g) {
+				id=grid[gid].recvCells[proc][g];
+				for (int i=0;i<5;++i) update[i].cell(id)=recvBuffer[offset+g*5+i];
+			}
+		}
+	}
+	
+	// The next sweep refills sendBuffer right away
+	if (send_req_count>0) MPI_Waitall(send_req_count,&send_request[0],MPI_STATUSES_IGNORE);
+	
+	return;
+}
+
 void NavierStokes::mpi_update_ghost_gradients(void) {
 	
 	// The Following is convenient but not efficient
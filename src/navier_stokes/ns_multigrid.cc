@@ -0,0 +1,317 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer 
+ 
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include "ns.h"
+
+
+// Agglomeration multigrid with the full approximation scheme (FAS)
+// The coarse levels hold their own state on the control volumes of Grid::agglomerate. A coarse
+// residual is evaluated with the same assembly as the grid itself: the coarse state is injected
+// into the cells, the reconstruction is first order and the faces inside the control volumes are
+// skipped, so that the sum over the cells of a control volume is its flux balance. Each coarse
+// level is smoothed by implicit updates with the Galerkin product of the assembled Jacobian.
+// One sawtooth cycle follows every implicit update of the grid itself, in steady and pseudo time
+// iterations alike. Coarse evaluations still visit the cells of the grid (but fewer faces), so
+// a cycle costs about as much as a few iterations; it pays off in the number of iterations.
+void NavierStokes::multigrid_init(void) {
+	
+	fas.clear();
+	if (mg_levels<=1) return;
+	
+	Subsection &options=input.section("grid",gid).subsection("navierstokes");
+	if (coupled) {
+		if (Rank==0) cerr << "[E] Input entry grid_" << gid+1 << " -> navier stokes -> multigrid levels>1 is not available with coupled turbulence" << endl;
+		exit(1);
+	}
+	if (options.get_double("activesetthreshold")>0.) {
+		if (Rank==0) cerr << "[E] Input entry grid_" << gid+1 << " -> navier stokes -> multigrid levels>1 is not available with the active set" << endl;
+		exit(1);
+	}
+	if (mg_smoothing<1) {
+		if (Rank==0) cerr << "[E] Input entry grid_" << gid+1 << " -> navier stokes -> multigrid smoothing should be at least 1" << endl;
+		exit(1);
+	}
+	
+	vector<vector<int> > agglomerates;
+	int coarse_levels=grid[gid].agglomerate(mg_levels-1,1<<grid[gid].dimension,agglomerates);
+	if (coarse_levels==0) {
+		if (Rank==0) cout << "[W grid=" << gid+1 << " ] Grid is too small to agglomerate, multigrid is not used" << endl;
+		return;
+	}
+	
+	int cellCount=grid[gid].cellCount;
+	fas.resize(coarse_levels+1);
+	fas[0].size=cellCount;
+	fas[0].volume.resize(cellCount);
+	for (int c=0;c<cellCount;++c) fas[0].volume[c]=grid[gid].cell[c].volume;
+	fas[0].state.resize(5*cellCount);
+	fas[0].residual.resize(5*cellCount);
+	
+	Variable<double> component; // Only for the exchange of the centroids
+	component.allocate(gid);
+	
+	for (int l=1;l<=coarse_levels;++l) {
+		NS_FAS_Level &level=fas[l];
+		level.agglomerate=agglomerates[l-1];
+		level.size=0;
+		for (int i=0;i<level.agglomerate.size();++i) level.size=max(level.size,level.agglomerate[i]+1);
+		
+		level.cell2cv.resize(cellCount);
+		for (int c=0;c<cellCount;++c) level.cell2cv[c]=(l==1) ? level.agglomerate[c] : level.agglomerate[fas[l-1].cell2cv[c]];
+		
+		level.interior_face.assign(grid[gid].faceCount,false);
+		for (int f=0;f<grid[gid].faceCount;++f) {
+			int parent=grid[gid].face[f].parent;
+			int neighbor=grid[gid].face[f].neighbor;
+			if (grid[gid].face[f].bc==INTERNAL_FACE && neighbor<cellCount) level.interior_face[f]=(level.cell2cv[parent]==level.cell2cv[neighbor]);
+		}
+		
+		level.volume.assign(level.size,0.);
+		vector<Vec3D> centroid (level.size);
+		for (int c=0;c<cellCount;++c) {
+			level.volume[level.cell2cv[c]]+=grid[gid].cell[c].volume;
+			centroid[level.cell2cv[c]]+=grid[gid].cell[c].volume*grid[gid].cell[c].centroid;
+		}
+		for (int i=0;i<level.size;++i) centroid[i]/=level.volume[i];
+		level.centroid.resize(grid[gid].cell.size());
+		for (int c=0;c<cellCount;++c) level.centroid[c]=centroid[level.cell2cv[c]];
+		for (int i=0;i<3;++i) {
+			for (int c=0;c<cellCount;++c) component.cell(c)=level.centroid[c][i];
+			component.mpi_update();
+			for (int g=grid[gid].partition_ghosts_begin;g<=grid[gid].partition_ghosts_end;++g) level.centroid[g][i]=component.cell(g);
+		}
+		
+		level.state.resize(5*level.size);
+		level.state0.resize(5*level.size);
+		level.source.resize(5*level.size);
+		level.residual.resize(5*level.size);
+		
+		// Control volumes of each rank are numbered after the ones of the lower ranks
+		int offset,global_size;
+		MPI_Scan(&level.size,&offset,1,MPI_INT,MPI_SUM,MPI_COMM_WORLD);
+		offset-=level.size;
+		MPI_Allreduce(&level.size,&global_size,1,MPI_INT,MPI_SUM,MPI_COMM_WORLD);
+		if (Rank==0) cout << "[I grid=" << gid+1 << " ] Multigrid level " << l+1 << " has " << global_size << " control volumes" << endl;
+		
+		MatCreateMPIAIJ(PETSC_COMM_WORLD,cellCount*5,level.size*5,grid[gid].globalCellCount*5,global_size*5,1,PETSC_NULL,0,PETSC_NULL,&level.prolongation);
+		int row,col;
+		for (int c=0;c<cellCount;++c) {
+			for (int var=0;var<5;++var) {
+				row=(grid[gid].myOffset+c)*5+var;
+				col=(offset+level.cell2cv[c])*5+var;
+				MatSetValue(level.prolongation,row,col,1.,INSERT_VALUES);
+			}
+		}
+		MatAssemblyBegin(level.prolongation,MAT_FINAL_ASSEMBLY);
+		MatAssemblyEnd(level.prolongation,MAT_FINAL_ASSEMBLY);
+		level.A_created=false;
+		
+		VecCreateMPI(PETSC_COMM_WORLD,level.size*5,global_size*5,&level.b);
+		VecDuplicate(level.b,&level.x);
+		
+		// The coarse operator is created with the first evaluation
+		PC level_pc;
+		KSPCreate(PETSC_COMM_WORLD,&level.ksp);
+		KSPSetType(level.ksp,KSPGMRES);
+		KSPGetPC(level.ksp,&level_pc);
+		PCSetType(level_pc,PCBJACOBI);
+		KSPSetTolerances(level.ksp,rtol,abstol,1.e15,maxits);
+		KSPSetOptionsPrefix(level.ksp,("ns"+int2str(gid+1)+"_mg"+int2str(l+1)+"_").c_str());
+		KSPSetFromOptions(level.ksp);
+	}
+	
+	if (ps_step_max>1) VecDuplicate(pseudo_delta,&fas_saved_delta);
+	
+	if (Rank==0) cout << "[I grid=" << gid+1 << " ] Using " << coarse_levels+1 << " level FAS agglomeration multigrid with " << mg_smoothing << " implicit steps per coarse level" << endl;
+	
+	return;
+}
+
+// Coarse grid correction after an implicit update of the grid itself
+void NavierStokes::multigrid_cycle(void) {
+	
+	if (fas.empty()) return;
+	
+	NS_FAS_Level &fine=fas[0];
+	for (int c=0;c<grid[gid].cellCount;++c) {
+		fine.state[5*c]=p.cell(c);
+		for (int i=0;i<3;++i) fine.state[5*c+i+1]=V.cell(c)[i];
+		fine.state[5*c+4]=T.cell(c);
+	}
+	// The coarse evaluations overwrite it, update_variables needs the one of the grid
+	if (ps_step_max>1) VecCopy(pseudo_delta,fas_saved_delta);
+	
+	multigrid_evaluate(0,false);
+	multigrid_level(1);
+	
+	for (int c=0;c<grid[gid].cellCount;++c) {
+		p.cell(c)=fine.state[5*c];
+		for (int i=0;i<3;++i) V.cell(c)[i]=fine.state[5*c+i+1];
+		T.cell(c)=fine.state[5*c+4];
+		rho.cell(c)=material.rho(p.cell(c),T.cell(c));
+	}
+	if (ps_step_max>1) VecCopy(fas_saved_delta,pseudo_delta);
+	
+	mpi_update_ghost_primitives();
+	update_boundaries();
+	calc_cell_grads();
+	mpi_update_ghost_gradients();
+	calc_limiter();
+	
+	return;
+}
+
+// Smooths level l starting from the restriction of the level above and corrects the level above
+// The residual of the level above has to be evaluated already
+void NavierStokes::multigrid_level(int l) {
+	
+	NS_FAS_Level &level=fas[l];
+	NS_FAS_Level &above=fas[l-1];
+	
+	// Volume weighted state and summed residual of the level above
+	vector<double> defect (5*level.size,0.);
+	level.state0.assign(5*level.size,0.);
+	for (int i=0;i<above.size;++i) {
+		int cv=level.agglomerate[i];
+		for (int var=0;var<5;++var) {
+			level.state0[5*cv+var]+=above.volume[i]*above.state[5*i+var];
+			defect[5*cv+var]+=above.residual[5*i+var];
+		}
+	}
+	for (int k=0;k<5*level.size;++k) level.state0[k]/=level.volume[k/5];
+	level.state=level.state0;
+	level.source.assign(5*level.size,0.);
+	
+	bool finite=true;
+	for (int step=0;step<mg_smoothing && finite;++step) {
+		multigrid_evaluate(l,true);
+		if (step==0) {
+			// Forcing term: the restricted state solves the coarse problem up to the defect of the level above
+			for (int k=0;k<5*level.size;++k) {
+				level.source[k]=level.residual[k]-defect[k];
+				level.residual[k]=defect[k];
+			}
+		}
+		
+		PetscScalar *local;
+		VecGetArray(level.b,&local);
+		for (int k=0;k<5*level.size;++k) local[k]=level.residual[k];
+		VecRestoreArray(level.b,&local);
+		KSPSetOperators(level.ksp,level.A,level.A,SAME_NONZERO_PATTERN);
+		KSPSolve(level.ksp,level.b,level.x);
+		
+		// A broken down coarse solve leaves the level at its last state
+		int local_finite=1,global_finite;
+		VecGetArray(level.x,&local);
+		for (int k=0;k<5*level.size;++k) if (isnan(local[k]) || isinf(local[k])) local_finite=0;
+		MPI_Allreduce(&local_finite,&global_finite,1,MPI_INT,MPI_MIN,MPI_COMM_WORLD);
+		finite=(global_finite==1);
+		if (finite) for (int k=0;k<5*level.size;++k) level.state[k]+=local[k];
+		VecRestoreArray(level.x,&local);
+		if (!finite && Rank==0) cout << "[W grid=" << gid+1 << " ] Multigrid level " << l+1 << " update is not finite, it is skipped" << endl;
+	}
+	
+	if (finite && l+1<fas.size()) {
+		multigrid_evaluate(l,false);
+		multigrid_level(l+1);
+	}
+	
+	// Piecewise constant correction of the level above
+	for (int i=0;i<above.size;++i) {
+		int cv=level.agglomerate[i];
+		for (int var=0;var<5;++var) above.state[5*i+var]+=level.state[5*cv+var]-level.state0[5*cv+var];
+	}
+	
+	return;
+}
+
+// Residual (and with jacobian, the implicit operator) of level l at its current state
+void NavierStokes::multigrid_evaluate(int l,bool jacobian) {
+	
+	NS_FAS_Level &level=fas[l];
+	fas_level=l;
+	residual_only=!jacobian;
+	
+	if (l>0) {
+		// Inject the level state into the cells, with first order reconstruction
+		// The gradients of the grid are kept for the tangential parts of the viscous fluxes
+		for (int c=0;c<grid[gid].cellCount;++c) {
+			int cv=level.cell2cv[c];
+			p.cell(c)=level.state[5*cv];
+			for (int i=0;i<3;++i) V.cell(c)[i]=level.state[5*cv+i+1];
+			T.cell(c)=level.state[5*cv+4];
+			rho.cell(c)=material.rho(p.cell(c),T.cell(c));
+		}
+		mpi_update_ghost_primitives();
+		update_boundaries();
+		for (int c=0;c<grid[gid].cell.size();++c) {
+			for (int i=0;i<5;++i) limiter[i].cell(c)=0.;
+		}
+	}
+	
+	// The state differs from soln_n already, so the unsteady term is added as from the second pseudo time step on
+	int current_ps_step=ps_step;
+	if (ps_step_max>1) ps_step=max(ps_step,2);
+	VecSet(rhs,0.);
+	assemble_linear_system();
+	time_terms();
+	ps_step=current_ps_step;
+	VecAssemblyBegin(rhs);
+	VecAssemblyEnd(rhs);
+	
+	if (jacobian) {
+		MatAssemblyBegin(impOP,MAT_FINAL_ASSEMBLY);
+		MatAssemblyEnd(impOP,MAT_FINAL_ASSEMBLY);
+		MatPtAP(impOP,level.prolongation,(level.A_created) ? MAT_REUSE_MATRIX : MAT_INITIAL_MATRIX,1.,&level.A);
+		level.A_created=true;
+	}
+	
+	// Sum over the control volumes
+	PetscScalar *rhs_local;
+	VecGetArray(rhs,&rhs_local);
+	level.residual.assign(5*level.size,0.);
+	for (int c=0;c<grid[gid].cellCount;++c) {
+		int cv=(l==0) ? c : level.cell2cv[c];
+		for (int i=0;i<5;++i) level.residual[5*cv+i]+=rhs_local[5*c+i];
+	}
+	VecRestoreArray(rhs,&rhs_local);
+	if (l>0) for (int k=0;k<5*level.size;++k) level.residual[k]-=level.source[k];
+	VecSet(rhs,0.);
+	
+	fas_level=0;
+	residual_only=false;
+	
+	return;
+}
+
+// Normal gradients of the viscous fluxes over the distance between control volume centroids
+void NavierStokes::multigrid_face_geometry(NS_Face_State &face) {
+	
+	NS_FAS_Level &level=fas[fas_level];
+	Vec3D left2right;
+	if (face.bc>=0) left2right=2.*(grid[gid].face[face.index].centroid-level.centroid[face.parent]);
+	else left2right=level.centroid[face.neighbor]-level.centroid[face.parent];
+	// Irregular control volumes keep the distance between the cells
+	if (left2right.dot(face.normal)>face.left2right.dot(face.normal)) face.left2right=left2right;
+	
+	return;
+}
@@ -40,6 +40,12 @@ void NavierStokes::petsc_init(void) {
 	}
 	VecSet(rhs,0.);
 	VecSet(deltaU,0.);
+	
+	// Matrix free, only the rhs vector is used
+	if (lusgs) {
+		lusgs_init();
+		return;
+	}
 
 	vector<int> diagonal_nonzeros, off_diagonal_nonzeros;
 	int nextCellCount;
@@ -73,16 +79,23 @@ void NavierStokes::petsc_init(void) {
 	KSPSetOperators(ksp,impOP,impOP,SAME_NONZERO_PATTERN);
 	KSPSetTolerances(ksp,rtol,abstol,1.e15,maxits);
 	KSPSetInitialGuessKnoll(ksp,PETSC_TRUE);
-	//KSPSetType(ksp,KSPGMRES);
-	KSPSetType(ksp,KSPFGMRES);
 	//KSPGMRESSetOrthogonalization(ksp,KSPGMRESModifiedGramSchmidtOrthogonalization);
-	KSPGMRESSetRestart(ksp,300);
+	set_linear_solver_options(ksp,gid,"navierstokes","ns"+int2str(gid+1)+"_");
 	KSPSetFromOptions(ksp);
+	recycler.init(gid,"navierstokes",impOP);
+	initial_guess.init(gid,"navierstokes",impOP);
+	forcing.init(gid,"navierstokes",rtol);
+	multigrid_init();
 	
 	return;
 } 
 
 void NavierStokes::petsc_solve(void) {
+	
+	if (lusgs) {
+		lusgs_solve();
+		return;
+	}
 
 	MatAssemblyBegin(impOP,MAT_FINAL_ASSEMBLY);
 	MatAssemblyEnd(impOP,MAT_FINAL_ASSEMBLY);
@@ -90,11 +103,26 @@ void NavierStokes::petsc_solve(void) {
 	VecAssemblyBegin(rhs);
 	VecAssemblyEnd(rhs);
 	
-	KSPSetOperators(ksp,impOP,impOP,SAME_NONZERO_PATTERN);
-	KSPSolve(ksp,rhs,deltaU);
+	// Rhs is the nonlinear residual the linear tolerance is adapted to
+	PetscReal rhs_norm;
+	VecNorm(rhs,NORM_2,&rhs_norm);
+	if (ps_step_max>1 && ps_step==1) forcing.reset();
+	KSPSetTolerances(ksp,forcing.tolerance(rhs_norm),abstol,1.e15,maxits);
 	
-	KSPGetIterationNumber(ksp,&nIter);
-	KSPGetResidualNorm(ksp,&rNorm); 
+	initial_guess.guess(ksp,rhs,deltaU,timeStep,ps_step==1);
+	if (recycler.active()) {
+		recycler.solve(ksp,rhs,deltaU,nIter,rNorm);
+	} else {
+		KSPSetOperators(ksp,impOP,impOP,SAME_NONZERO_PATTERN);
+		KSPSolve(ksp,rhs,deltaU);
+		KSPGetIterationNumber(ksp,&nIter);
+		KSPGetResidualNorm(ksp,&rNorm); 
+	}
+	linear_reduction=(rhs_norm>0.) ? rNorm/rhs_norm : 0.;
+	initial_guess.store(deltaU,nIter);
+	KSPConvergedReason reason;
+	KSPGetConvergedReason(ksp,&reason);
+	linear_failed=(nIter>0 && reason<0 && reason!=KSP_DIVERGED_ITS);
 	
 	int index;
 	for (int c=0;c<grid[gid].cellCount;++c) {
@@ -110,13 +138,26 @@ void NavierStokes::petsc_solve(void) {
 } 
 
 void NavierStokes::petsc_destroy(void) {
-	KSPDestroy(ksp);
-	MatDestroy(impOP);
+	if (!lusgs) {
+		KSPDestroy(ksp);
+		recycler.destroy();
+		initial_guess.destroy();
+		MatDestroy(impOP);
+	}
+	for (int l=1;l<fas.size();++l) {
+		KSPDestroy(fas[l].ksp);
+		MatDestroy(fas[l].prolongation);
+		if (fas[l].A_created) MatDestroy(fas[l].A);
+		VecDestroy(fas[l].b);
+		VecDestroy(fas[l].x);
+	}
+	if (!fas.empty() && ps_step_max>1) VecDestroy(fas_saved_delta);
 	VecDestroy(rhs);
 	VecDestroy(deltaU);
 	VecDestroy(soln_n);
 	VecDestroy(pseudo_delta);
 	VecDestroy(pseudo_right);	
+	if (coupled) coupled_destroy();
 	PCDestroy(pc);
 	return;
 } 
@@ -22,14 +22,13 @@
 *************************************************************************/
 #include "ns.h"
 
-void NavierStokes::read_restart(int restart_step,vector<vector<int> > &partitionMap) {
+void NavierStokes::read_restart(RestartFile &restart) {
 
-	string dirname="./restart/"+int2str(restart_step)+"/";
-	string gs="."+int2str(gid+1);
+	for (int i=0;i<3;++i) first_residuals[i]=restart.header.first_residuals[i];
 	
-	p.read_cell_data(dirname+"p"+gs,partitionMap);
-	V.read_cell_data(dirname+"V"+gs,partitionMap);
-	T.read_cell_data(dirname+"T"+gs,partitionMap);
+	restart.read("p",p);
+	restart.read("V",V);
+	restart.read("T",T);
 	for (int c=0;c<grid[gid].cellCount;++c) rho.cell(c)=material.rho(p.cell(c),T.cell(c));
 	update_boundaries();
 	mpi_update_ghost_primitives();
@@ -106,7 +106,7 @@ void NavierStokes::preconditioner_ws95(int c,vector<vector<double> > &P) {
 
 void NavierStokes::time_terms() {
 
-	PetscInt row,col;
+	PetscInt row;
 	PetscScalar value;
 	
 	if (ps_step_max>1) {
@@ -137,6 +137,19 @@ void NavierStokes::time_terms() {
 		}
 	}
 	
+	// The cell blocks are evaluated by the threads and inserted to PETSc by the master thread afterwards
+	vector<double> time_blocks (25*grid[gid].cellCount);
+	vector<double> ps_time_blocks;
+	vector<double> ps_right_values;
+	if (ps_step_max>1) ps_time_blocks.resize(25*grid[gid].cellCount);
+	PetscScalar *pseudo_delta_local;
+	if (ps_step>1) {
+		ps_right_values.resize(5*grid[gid].cellCount);
+		VecGetArray(pseudo_delta,&pseudo_delta_local);
+	}
+	
+	#pragma omp parallel
+	{
 	vector<vector<double> > P;
 	P.resize(5);
 	for (int i=0;i<5;++i) {
@@ -144,37 +157,47 @@ void NavierStokes::time_terms() {
 		for (int j=0;j<5;++j) P[i][j]=0.;
 	}
 	
+	#pragma omp for schedule(static)
 	for (int c=0;c<grid[gid].cellCount;++c) {
 
 		cons2prim(c,P);
-		double ps_delta;
 		for (int i=0;i<5;++i) {
-			row=(grid[gid].myOffset+c)*5+i;
+			double ps_right=0.;
 			for (int j=0;j<5;++j) {
-				col=(grid[gid].myOffset+c)*5+j;
-				value=P[i][j]*grid[gid].cell[c].volume/dt[gid].cell(c);
-				MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
-				if (ps_step>1) {
-					VecGetValues(pseudo_delta,1,&col,&ps_delta);
-					value*=ps_delta;
-					VecSetValues(pseudo_right,1,&row,&value,ADD_VALUES);
-				}
+				time_blocks[25*c+5*i+j]=P[i][j]*grid[gid].cell[c].volume/dt[gid].cell(c);
+				if (ps_step>1) ps_right+=time_blocks[25*c+5*i+j]*pseudo_delta_local[c*5+j];
 			}
+			if (ps_step>1) ps_right_values[c*5+i]=ps_right;
 		}
 	
 		if (ps_step_max>1) {
 			if (preconditioner==WS95) preconditioner_ws95(c,P);	
 			for (int i=0;i<5;++i) {
-				row=(grid[gid].myOffset+c)*5+i;
 				for (int j=0;j<5;++j) {
-					col=(grid[gid].myOffset+c)*5+j;
-					value=P[i][j]*grid[gid].cell[c].volume/dtau[gid].cell(c);
-					MatSetValues(impOP,1,&row,1,&col,&value,ADD_VALUES);
+					ps_time_blocks[25*c+5*i+j]=P[i][j]*grid[gid].cell[c].volume/dtau[gid].cell(c);
 				}
 			}
 		}
 		
 	}
+	} // parallel region
+	
+	if (ps_step>1) VecRestoreArray(pseudo_delta,&pseudo_delta_local);
+	
+	PetscInt rows[5];
+	for (int c=0;c<grid[gid].cellCount;++c) {
+		for (int i=0;i<5;++i) rows[i]=(grid[gid].myOffset+c)*5+i;
+		if (residual_only) {
+			// Only the unsteady term below
+		} else if (lusgs) {
+			for (int k=0;k<25;++k) diagonal_blocks[25*c+k]+=time_blocks[25*c+k];
+			if (ps_step_max>1) for (int k=0;k<25;++k) diagonal_blocks[25*c+k]+=ps_time_blocks[25*c+k];
+		} else {
+			MatSetValues(impOP,5,rows,5,rows,&time_blocks[25*c],ADD_VALUES);
+			if (ps_step_max>1) MatSetValues(impOP,5,rows,5,rows,&ps_time_blocks[25*c],ADD_VALUES);
+		}
+		if (ps_step>1) VecSetValues(pseudo_right,5,rows,&ps_right_values[5*c],ADD_VALUES);
+	}
 	
 	if (ps_step>1) {
 		VecAssemblyBegin(pseudo_right); VecAssemblyEnd(pseudo_right);	
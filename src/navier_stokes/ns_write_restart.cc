@@ -22,14 +22,15 @@
 *************************************************************************/
 #include "ns.h"
 
-void NavierStokes::write_restart(int timeStep) {
+void NavierStokes::write_restart(RestartFile &restart) {
 
-	string dirname="./restart/"+int2str(timeStep)+"/";
-	string gs="."+int2str(gid+1);
+	restart.header.first_residuals[0]=first_residuals[0];
+	restart.header.first_residuals[1]=first_residuals[1];
+	restart.header.first_residuals[2]=first_residuals[2];
 	
-	p.dump_cell_data(dirname+"p"+gs);
-	V.dump_cell_data(dirname+"V"+gs);
-	T.dump_cell_data(dirname+"T"+gs);
+	restart.add("p",p);
+	restart.add("V",V);
+	restart.add("T",T);
 
 	return;
 }
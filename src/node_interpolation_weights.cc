@@ -24,6 +24,7 @@
 #include "interpolate.h"
 #include "inputs.h"
 #include <iomanip>
+#include <algorithm>
 using namespace std;
 
 extern vector<Grid> grid;
@@ -31,43 +32,50 @@ extern InputFile input;
 
 void node_interpolation_weights(int gid) {
 
-	Interpolate interpolation; // Declare interpolation object
-	
-	interpolation.init();
+	Interpolate settings; // Options shared by the per-thread interpolation objects
 
-	if (input.section("grid",0).subsection("interpolation").get_string("method")=="wtli") interpolation.method=WTLI;
-	if (input.section("grid",0).subsection("interpolation").get_string("method")=="idw") interpolation.method=IDW;
-	if (input.section("grid",0).subsection("interpolation").get_string("method")=="simple") interpolation.method=SIMPLE;
+	if (input.section("grid",0).subsection("interpolation").get_string("method")=="wtli") settings.method=WTLI;
+	if (input.section("grid",0).subsection("interpolation").get_string("method")=="idw") settings.method=IDW;
+	if (input.section("grid",0).subsection("interpolation").get_string("method")=="simple") settings.method=SIMPLE;
 	
-	interpolation.max_stencil_size=input.section("grid",gid).subsection("interpolation").get_int("stencilsize");
-	interpolation.skewness_tolerance=input.section("grid",gid).subsection("interpolation").get_double("skewnesstolerance");
-	interpolation.dimension=grid[gid].dimension;
-
-	if (interpolation.max_stencil_size<1) { // Means auto based on dimension
-		if (interpolation.dimension==3) interpolation.max_stencil_size=12;
-		else if (interpolation.dimension==2) interpolation.max_stencil_size=6; 
-		else if (interpolation.dimension==1) interpolation.max_stencil_size=2;
+	settings.max_stencil_size=input.section("grid",gid).subsection("interpolation").get_int("stencilsize");
+	settings.skewness_tolerance=input.section("grid",gid).subsection("interpolation").get_double("skewnesstolerance");
+	settings.dimension=grid[gid].dimension;
+
+	if (settings.max_stencil_size<1) { // Means auto based on dimension
+		if (settings.dimension==3) settings.max_stencil_size=12;
+		else if (settings.dimension==2) settings.max_stencil_size=6; 
+		else if (settings.dimension==1) settings.max_stencil_size=2;
 	}
 
-	if (interpolation.method==IDW) interpolation.max_stencil_size=99; // Simply all the node cell neighbors
+	if (settings.method==IDW) settings.max_stencil_size=99; // Simply all the node cell neighbors
 	
 	int tetra_intp_count=0;		
 	int tri_intp_count=0;		
 	int line_intp_count=0;		
 	int point_intp_count=0;
 	
-	set<int> stencil;
-	set<int>::iterator sit;
 	// Loop all the nodes
+	// Each thread works with its own copy of the interpolation object and stencil scratch space
+	// Every node only writes its own average map
+	#pragma omp parallel reduction(+:tetra_intp_count,tri_intp_count,line_intp_count,point_intp_count)
+	{
+	Interpolate interpolation=settings;
+	interpolation.init();
+	vector<int> stencil;
 	bool is_internal=true;
+	#pragma omp for schedule(dynamic,64)
 	for (int n=0;n<grid[gid].nodeCount;++n) {
 		interpolation.point=grid[gid].node[n];
 		// Initialize stencil to nearest neighbor cells
-		for (int nc=0;nc<grid[gid].node[n].cells.size();++nc) stencil.insert(grid[gid].node[n].cells[nc]);
-
-		for (sit=stencil.begin();sit!=stencil.end();sit++) {
-			interpolation.stencil_indices.push_back(*sit);
-			interpolation.stencil.push_back(grid[gid].cell[*sit].centroid);
+		stencil.assign(grid[gid].node[n].cells.begin(),grid[gid].node[n].cells.end());
+		// Sorted and unique, same as a set
+		sort(stencil.begin(),stencil.end());
+		stencil.erase(unique(stencil.begin(),stencil.end()),stencil.end());
+
+		for (int s=0;s<stencil.size();++s) {
+			interpolation.stencil_indices.push_back(stencil[s]);
+			interpolation.stencil.push_back(grid[gid].cell[stencil[s]].centroid);
 		}
 		
 		if (interpolation.method==WTLI) {
@@ -106,6 +114,7 @@ void node_interpolation_weights(int gid) {
 		interpolation.flush();
 		stencil.clear();
 	}
+	}
 	
 	/*
 	cout << "[I rank=" << Rank << "] Face centers for which tetra interpolation method was used = " << tetra_intp_count << endl; 
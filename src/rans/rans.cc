@@ -48,6 +48,7 @@ RANS::RANS(void) {
 void RANS::initialize (int ps_max) {
 	
 	ps_step_max=ps_max;
+	diverged=false;
 	nVars=2;
 	rtol=input.section("grid",gid).subsection("turbulence").get_double("relativetolerance");
 	abstol=input.section("grid",gid).subsection("turbulence").get_double("absolutetolerance");
@@ -83,11 +84,24 @@ void RANS::initialize (int ps_max) {
 }
 
 void RANS::solve  (int ts,int pts) {
+	assemble(ts,pts);
+	petsc_solve();
+	diverged=(ns[gid].rollback && diverged_update());
+	if (diverged) return;
+	advance();
+	return;
+}
+
+void RANS::assemble(int ts,int pts) {
 	timeStep=ts;
 	ps_step=pts;
 	terms();
 	time_terms();
-	petsc_solve();
+	return;
+}
+
+// Applies the update and brings everything that depends on k and omega up to date
+void RANS::advance(void) {
 	update_variables();
 	mpi_update_ghost_primitives();
 	update_boundaries();
@@ -190,6 +204,21 @@ void RANS::calc_cell_grads (void) {
 	return;
 }
 
+bool RANS::diverged_update(void) {
+	
+	int local_diverged=0,global_diverged;
+	
+	for (int c=0;c<grid[gid].cellCount;++c) {
+		for (int i=0;i<2;++i) {
+			if (isnan(update[i].cell(c)) || isinf(update[i].cell(c))) local_diverged=1;
+		}
+	}
+	
+	MPI_Allreduce(&local_diverged,&global_diverged,1,MPI_INT,MPI_MAX,MPI_COMM_WORLD);
+	
+	return (global_diverged==1);
+}
+
 void RANS::update_variables(void) {
 	
 	double residuals[2],ps_residuals[2],totalResiduals[2],total_ps_residuals[2];
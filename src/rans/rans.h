@@ -29,6 +29,7 @@
 #include "grid.h"
 #include "inputs.h"
 #include "variable.h"
+#include "restart_file.h"
 #include "utilities.h"
 #include "material.h"
 #include "bc.h"
@@ -36,6 +37,7 @@
 #include "commons.h"
 #include "bc_interface.h"
 #include "ns.h"
+#include "linear_solver.h"
 
 extern InputFile input;
 extern vector<Grid> grid;
@@ -73,6 +75,8 @@ public:
 	int ps_step;	
 	int nIter;
 	double rNorm,res,ps_res;
+	double linear_reduction; // achieved by the last linear solve
+	bool diverged; // last update was discarded (see NavierStokes::rollback)
 	// Total residuals
 	vector<double> first_residuals,first_ps_residuals;
 
@@ -85,6 +89,9 @@ public:
 	
 	// PETSC variables
 	KSP ksp; // linear solver context
+	KrylovRecycler recycler;
+	ForcingTerm forcing;
+	InitialGuess initial_guess;
 	PC pc; // preconditioner context
 	Vec deltaU,rhs; // solution, residual vectors
 	Mat impOP; // implicit operator matrix
@@ -108,14 +115,18 @@ public:
 	void petsc_solve(void);
 	void petsc_destroy(void);
 	void solve (int timeStep,int ps_step);
+	void assemble(int timeStep,int ps_step);
+	void advance(void);
 	void initialize_linear_system(void);
 	void get_kOmega(void);
 	void terms(void);
 	void time_terms(void);
 	void update_eddy_viscosity(void);
+	void eddy_viscosity_derivatives(int c,double &dk,double &domega);
+	bool diverged_update(void);
 	void update_variables(void);
-	void write_restart(int timeStep);
-	void read_restart(int restart_step,vector<vector<int> > &partitionMap);
+	void write_restart(RestartFile &restart);
+	void read_restart(RestartFile &restart);
 	
 };
 
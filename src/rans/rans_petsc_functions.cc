@@ -75,9 +75,11 @@ void RANS::petsc_init(void) {
 	KSPSetOperators(ksp,impOP,impOP,SAME_NONZERO_PATTERN);
 	KSPSetTolerances(ksp,rtol,abstol,1.e15,maxits);
 	KSPSetInitialGuessKnoll(ksp,PETSC_TRUE);
-	KSPSetType(ksp,KSPFGMRES);
-	KSPGMRESSetRestart(ksp,300);
+	set_linear_solver_options(ksp,gid,"turbulence","rans"+int2str(gid+1)+"_");
 	KSPSetFromOptions(ksp);
+	recycler.init(gid,"turbulence",impOP);
+	initial_guess.init(gid,"turbulence",impOP);
+	forcing.init(gid,"turbulence",rtol);
 	
 	return;
 } 
@@ -90,11 +92,23 @@ void RANS::petsc_solve(void) {
 	VecAssemblyBegin(rhs);
 	VecAssemblyEnd(rhs);
 	
-	KSPSetOperators(ksp,impOP,impOP,SAME_NONZERO_PATTERN);
-	KSPSolve(ksp,rhs,deltaU);
+	// Rhs is the nonlinear residual the linear tolerance is adapted to
+	PetscReal rhs_norm;
+	VecNorm(rhs,NORM_2,&rhs_norm);
+	if (ps_step_max>1 && ps_step==1) forcing.reset();
+	KSPSetTolerances(ksp,forcing.tolerance(rhs_norm),abstol,1.e15,maxits);
 	
-	KSPGetIterationNumber(ksp,&nIter);
-	KSPGetResidualNorm(ksp,&rNorm); 
+	initial_guess.guess(ksp,rhs,deltaU,timeStep,ps_step==1);
+	if (recycler.active()) {
+		recycler.solve(ksp,rhs,deltaU,nIter,rNorm);
+	} else {
+		KSPSetOperators(ksp,impOP,impOP,SAME_NONZERO_PATTERN);
+		KSPSolve(ksp,rhs,deltaU);
+		KSPGetIterationNumber(ksp,&nIter);
+		KSPGetResidualNorm(ksp,&rNorm); 
+	}
+	linear_reduction=(rhs_norm>0.) ? rNorm/rhs_norm : 0.;
+	initial_guess.store(deltaU,nIter);
 	
 	int index;
 	for (int c=0;c<grid[gid].cellCount;++c) {
@@ -111,6 +125,8 @@ void RANS::petsc_solve(void) {
 
 void RANS::petsc_destroy(void) {
 	KSPDestroy(ksp);
+	recycler.destroy();
+	initial_guess.destroy();
 	MatDestroy(impOP);
 	VecDestroy(rhs);
 	VecDestroy(deltaU);
@@ -22,14 +22,14 @@
 *************************************************************************/
 #include "rans.h"
 
-void RANS::read_restart(int restart_step,vector<vector<int> > &partitionMap) {
+void RANS::read_restart(RestartFile &restart) {
 
-	string dirname="./restart/"+int2str(restart_step)+"/";
-	string gs="."+int2str(gid+1);
+	first_residuals[0]=restart.header.first_residuals[3];
+	first_residuals[1]=restart.header.first_residuals[4];
 	
-	k.read_cell_data(dirname+"k"+gs,partitionMap);
-	omega.read_cell_data(dirname+"omega"+gs,partitionMap);
-	mu_t.read_cell_data(dirname+"mu_t"+gs,partitionMap);
+	restart.read("k",k);
+	restart.read("omega",omega);
+	restart.read("mu_t",mu_t);
 
 	update_boundaries();	
 	mpi_update_ghost_primitives();
@@ -30,6 +30,7 @@ void RANS::update_eddy_viscosity(void) {
 	double a1=0.31; // SST a1 value
 	double turbulent_length_scale;
 
+	#pragma omp parallel for schedule(static) private(arg1,arg2,arg3,F2,mu)
 	for (int c=0;c<grid[gid].cell.size();++c) {
 		mu=ns[gid].material.viscosity(ns[gid].T.cell(c));
 		if (model==SST) {
@@ -53,6 +54,31 @@ void RANS::update_eddy_viscosity(void) {
 	
 	return;
 	
+}
+
+// Sensitivity of the cell eddy viscosity to k and omega, zero where a limiter is active
+void RANS::eddy_viscosity_derivatives(int c,double &dk,double &domega) {
+	
+	double mu=ns[gid].material.viscosity(ns[gid].T.cell(c));
+	double a1=0.31; // SST a1 value
+	
+	dk=0.;
+	domega=0.;
+	if (mu_t.cell(c)>=viscosityRatioLimit*mu || k.cell(c)<=0. || omega.cell(c)<=0.) return;
+	
+	dk=mu_t.cell(c)/k.cell(c);
+	domega=-mu_t.cell(c)/omega.cell(c);
+	if (model==SST) {
+		double arg1=2.*sqrt(k.cell(c)+1.e-15)/(kepsilon.beta_star*omega.cell(c)*grid[gid].cell[c].closest_wall_distance);
+		double arg2=500.*mu/(ns[gid].rho.cell(c)*omega.cell(c)
+				*grid[gid].cell[c].closest_wall_distance*grid[gid].cell[c].closest_wall_distance);
+		double arg3=max(arg1,arg2);
+		double F2=tanh(arg3*arg3);
+		// Strain rate limited branch doesn't depend on omega
+		if (strainRate.cell(c)*F2>a1*omega.cell(c)) domega=0.;
+	}
+	
+	return;
 } 
 
 
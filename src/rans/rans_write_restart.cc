@@ -22,14 +22,14 @@
 *************************************************************************/
 #include "rans.h"
 
-void RANS::write_restart(int timeStep) {
+void RANS::write_restart(RestartFile &restart) {
 
-	string dirname="./restart/"+int2str(timeStep)+"/";
-	string gs="."+int2str(gid+1);
+	restart.header.first_residuals[3]=first_residuals[0];
+	restart.header.first_residuals[4]=first_residuals[1];
 	
-	k.dump_cell_data(dirname+"k"+gs);
-	omega.dump_cell_data(dirname+"omega"+gs);
-	mu_t.dump_cell_data(dirname+"mu_t"+gs);
+	restart.add("k",k);
+	restart.add("omega",omega);
+	restart.add("mu_t",mu_t);
 	
 }
 
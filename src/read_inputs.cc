@@ -21,6 +21,7 @@
 
 *************************************************************************/
 #include "inputs.h"
+#include "linear_solver.h"
 
 extern InputFile input;
 extern vector<InputFile> material_input;
@@ -42,6 +43,7 @@ void read_inputs(void) {
 	input.section("grid",0).register_string("format",optional,"cgns");
 	input.section("grid",0).register_int("dimension",optional,3);
 	input.section("grid",0).register_string("equations",required);
+	input.section("grid",0).register_string("setupcache",optional,"off");
 
 	input.section("grid",0).registerSubsection("gradients",single,optional);
 	input.section("grid",0).subsection("gradients").register_string("hexmethod",optional,"curvilinear");
@@ -55,6 +57,9 @@ void read_inputs(void) {
 	
 	input.section("grid",0).registerSubsection("writeoutput",single,required);
 	input.section("grid",0).subsection("writeoutput").register_string("format",optional,"tecplot");
+	input.section("grid",0).subsection("writeoutput").register_string("vtkencoding",optional,"binary");
+	input.section("grid",0).subsection("writeoutput").register_string("compression",optional,"none");
+	input.section("grid",0).subsection("writeoutput").register_stringList("float64variables",optional);
 	input.section("grid",0).subsection("writeoutput").register_int("volumeplotfrequency",optional,1000000);
 	input.section("grid",0).subsection("writeoutput").register_int("surfaceplotfrequency",optional,1000000);
 	input.section("grid",0).subsection("writeoutput").register_int("restartfrequency",optional,1000000);
@@ -63,6 +68,12 @@ void read_inputs(void) {
 	input.section("grid",0).subsection("writeoutput").register_stringList("includebcs",optional);
 	input.section("grid",0).subsection("writeoutput").register_stringList("volumevariables",required);
 	input.section("grid",0).subsection("writeoutput").register_stringList("surfacevariables",required);
+	input.section("grid",0).subsection("writeoutput").register_stringList("statisticsvariables",optional);
+	input.section("grid",0).subsection("writeoutput").register_stringList("statisticssurfacevariables",optional);
+	input.section("grid",0).subsection("writeoutput").register_int("statisticsstart",optional,0);
+	input.section("grid",0).subsection("writeoutput").register_int("statisticswindow",optional,0);
+	input.section("grid",0).subsection("writeoutput").register_string("statisticsminmax",optional,"off");
+	input.section("grid",0).subsection("writeoutput").register_int("monitorfrequency",optional,100);
 	
 	input.section("grid",0).register_string("material",optional,"none");
 	input.section("grid",0).registerSubsection("material",single,optional);
@@ -114,17 +125,20 @@ void read_inputs(void) {
 	input.section("grid",0).subsection("turbulence").register_double("relativetolerance",optional,1.e-6);
 	input.section("grid",0).subsection("turbulence").register_double("absolutetolerance",optional,1.e-12);
 	input.section("grid",0).subsection("turbulence").register_int("maximumiterations",optional,10);	
+	register_linear_solver_options(input.section("grid",0).subsection("turbulence"));
 	input.section("grid",0).subsection("turbulence").register_string("model",optional,"sst");
 	input.section("grid",0).subsection("turbulence").register_double("klowlimit",optional,1.e-10);
 	input.section("grid",0).subsection("turbulence").register_double("khighlimit",optional,1.e8);
 	input.section("grid",0).subsection("turbulence").register_double("omegalowlimit",optional,1.e-2);
 	input.section("grid",0).subsection("turbulence").register_double("viscosityratiolimit",optional,1.e8);
 	input.section("grid",0).subsection("turbulence").register_double("turbulentPr",optional,0.9);
+	input.section("grid",0).subsection("turbulence").register_string("coupling",optional,"segregated");
 	
 	input.section("grid",0).registerSubsection("navierstokes",single,optional);
 	input.section("grid",0).subsection("navierstokes").register_double("relativetolerance",optional,1.e-6);
 	input.section("grid",0).subsection("navierstokes").register_double("absolutetolerance",optional,1.e-12);
 	input.section("grid",0).subsection("navierstokes").register_int("maximumiterations",optional,10);	
+	register_linear_solver_options(input.section("grid",0).subsection("navierstokes"));
 	input.section("grid",0).subsection("navierstokes").register_string("limiter",optional,"vk");
 	input.section("grid",0).subsection("navierstokes").register_double("limiterthreshold",optional,0.);
 	input.section("grid",0).subsection("navierstokes").register_string("order",optional,"second");
@@ -132,12 +146,20 @@ void read_inputs(void) {
 	input.section("grid",0).subsection("navierstokes").register_string("convectiveflux",optional,"AUSM+up");
 	input.section("grid",0).subsection("navierstokes").register_double("walldissipation",optional,0.3);
 	input.section("grid",0).subsection("navierstokes").register_double("BLheight",optional,0.);
+	input.section("grid",0).subsection("navierstokes").register_int("multigridlevels",optional,1);
+	input.section("grid",0).subsection("navierstokes").register_int("multigridsmoothing",optional,2);
+	input.section("grid",0).subsection("navierstokes").register_double("activesetthreshold",optional,0.);
+	input.section("grid",0).subsection("navierstokes").register_int("fullsweepfrequency",optional,50);
+	input.section("grid",0).subsection("navierstokes").register_string("implicitscheme",optional,"krylov");
+	input.section("grid",0).subsection("navierstokes").register_int("sgssweeps",optional,1);
 	
 	
 	input.section("grid",0).registerSubsection("heatconduction",single,optional);
 	input.section("grid",0).subsection("heatconduction").register_double("relativetolerance",optional,1.e-6);
 	input.section("grid",0).subsection("heatconduction").register_double("absolutetolerance",optional,1.e-12);
 	input.section("grid",0).subsection("heatconduction").register_int("maximumiterations",optional,10);	
+	register_linear_solver_options(input.section("grid",0).subsection("heatconduction"));
+	input.section("grid",0).subsection("heatconduction").register_string("operatorreuse",optional,"auto");
 	
 	input.section("grid",0).registerSubsection("transform",numbered,optional);
 	input.section("grid",0).subsection("transform",0).register_string("function",optional);
@@ -147,6 +169,14 @@ void read_inputs(void) {
 	input.section("grid",0).subsection("transform",0).register_Vec3D("axis",optional,0.);
 	input.section("grid",0).subsection("transform",0).register_double("angle",optional,0.);
 	
+	input.section("grid",0).registerSubsection("probe",numbered,optional);
+	input.section("grid",0).subsection("probe",0).register_Vec3D("point",optional,0.);
+	input.section("grid",0).subsection("probe",0).register_stringList("variables",optional,"p");
+	
+	input.section("grid",0).registerSubsection("monitor",numbered,optional);
+	input.section("grid",0).subsection("monitor",0).register_int("BC",optional,0);
+	input.section("grid",0).subsection("monitor",0).register_stringList("variables",optional,"p");
+	
 	input.read("grid",0);
 	
 	input.registerSection("timemarching",single,required);
@@ -157,6 +187,12 @@ void read_inputs(void) {
 	input.section("timemarching").registerSubsection("ramp",single,optional);
 	input.section("timemarching").subsection("ramp").register_double("initial",optional,1.);
 	input.section("timemarching").subsection("ramp").register_double("growth",optional,1.2);
+	input.section("timemarching").registerSubsection("adaptiveCFL",single,optional);
+	input.section("timemarching").subsection("adaptiveCFL").register_double("initial",optional,1.);
+	input.section("timemarching").subsection("adaptiveCFL").register_double("minimum",optional,0.1);
+	input.section("timemarching").subsection("adaptiveCFL").register_double("growth",optional,2.);
+	input.section("timemarching").subsection("adaptiveCFL").register_double("cut",optional,0.5);
+	input.section("timemarching").subsection("adaptiveCFL").register_double("exponent",optional,1.);
 	input.section("timemarching").register_int("numberofsteps",required);
 	input.section("timemarching").register_int("updatefrequency",optional,1000000);
 	input.section("timemarching").register_string("schedulefile",optional,"none");
@@ -175,6 +211,11 @@ void read_inputs(void) {
 	input.section("pseudotime").register_int("updatefrequency",optional,1000000);
 	input.read("pseudotime");
 	
+	input.registerSection("parallel",single,optional);
+	input.section("parallel").register_int("threads",optional,1);
+	input.section("parallel").register_string("output",optional,"synchronous");
+	input.read("parallel");
+	
 	input.readEntries();
 	
 	// Read the material file for each grid
@@ -32,6 +32,7 @@ using namespace std;
 #include "rans.h"
 #include "hc.h"
 #include "commons.h"
+#include "statistics.h"
 
 extern vector<Grid> grid;
 extern InputFile input;
@@ -40,63 +41,21 @@ extern vector<HeatConduction> hc;
 extern vector<RANS> rans;
 extern vector<Variable<double> > dt;
 extern vector<int> equations;
+extern vector<Statistics> statistics;
 
 void read_restart(int gid,int restart_step,double &time) {
 
-	fstream file;
-		
-	// Read partitionMap
-	string fileName="./restart/partitionMap_"+int2str(gid+1)+".dat";
-	int nprocs,cellGlobalId;
-	int ncells[np],nnodes[np];
-	file.open(fileName.c_str(),ios::in);	
-	if (!file.is_open()) {
-		if (Rank==0) cerr << "[E] Restart file " << fileName  << " couldn't be opened" << endl;
-		exit(1);
-	}
-	file >> nprocs;
-	vector<vector<int> > partitionMap;
-	partitionMap.resize(nprocs);
-	for (int p=0;p<nprocs;++p) {
-		file >> nnodes[p];
-		file >> ncells[p];
-		partitionMap[p].resize(ncells[p]);
-		for (int c=0;c<ncells[p];++c) {
-			file >> cellGlobalId;
-			partitionMap[p][c]=cellGlobalId;
-		}
-	}
-	file.close();
-	
-	// Read time file
-	string dirname="./restart/"+int2str(restart_step);
-	fileName=dirname+"/time.dat";
-	double dump;
-	if (Rank==0) { 
-		file.open(fileName.c_str());
-		// Read physical time
-		file >> time;
-		// Read residual normalization information
-		if (equations[gid]==NS) {
-			file >> ns[gid].first_residuals[0] >> ns[gid].first_residuals[1] >> ns[gid].first_residuals[2];
-			if (turbulent[gid]) file >> rans[gid].first_residuals[0] >> rans[gid].first_residuals[1];
-			else file >> dump >> dump;
-		} else {
-			file >> dump >> dump >> dump;
-			file >> dump;
-		}
-		if (equations[gid]==HEAT) file >> hc[gid].first_residual;
-		else file >> dump;
-		file.close();
-	}	
+	// Opens either the single file restart format or the older one file per variable format
+	RestartFile restart(gid);
+	restart.open(restart_step);
+	time=restart.header.time;
 	
-	for (int g=0;g<grid.size();++g) {
-		if (equations[gid]==NS) {
-			ns[gid].read_restart(restart_step,partitionMap);
-			if (turbulent[gid]) rans[gid].read_restart(restart_step,partitionMap);
-		}
-		if (equations[gid]==HEAT) hc[gid].read_restart(restart_step,partitionMap);
+	if (equations[gid]==NS) {
+		ns[gid].read_restart(restart);
+		if (turbulent[gid]) rans[gid].read_restart(restart);
 	}
+	if (equations[gid]==HEAT) hc[gid].read_restart(restart);
+	statistics[gid].read_restart(restart);
 	
 	return;
 }
@@ -24,6 +24,8 @@
 #include "inputs.h"
 #include "bc.h"
 #include "bc_interface.h"
+#include "kdtree.h"
+#include <algorithm>
 
 extern InputFile input;
 extern vector<Grid> grid;
@@ -32,7 +34,29 @@ extern vector<vector<BC_Interface> > interface;
 extern vector<int> equations;
 extern vector<bool> turbulent;
 
-void set_bcs(int gid) {
+struct wall_face_compare {
+	const vector<double> *faces;
+	int dir;
+	bool operator() (int a,int b) const { return (*faces)[6*a+dir]<(*faces)[6*b+dir]; }
+};
+
+// Insert the wall faces in median order so that the kdtree stays balanced
+// even when the wall faces come in spatially sorted order
+void kd_insert_balanced(kdtree *kd,vector<double> &faces,vector<int> &order,int begin,int end,int dir) {
+	if (begin>=end) return;
+	int mid=begin+(end-begin)/2;
+	wall_face_compare compare;
+	compare.faces=&faces;
+	compare.dir=dir;
+	nth_element(order.begin()+begin,order.begin()+mid,order.begin()+end,compare);
+	int nsf=order[mid];
+	kd_insert3(kd,faces[6*nsf],faces[6*nsf+1],faces[6*nsf+2],&faces[6*nsf+3]);
+	kd_insert_balanced(kd,faces,order,begin,mid,(dir+1)%3);
+	kd_insert_balanced(kd,faces,order,mid+1,end,(dir+1)%3);
+	return;
+}
+
+void set_bcs(int gid,bool cached) {
 	
 	// Loop through each boundary condition region and apply sequentially
 	int count=input.section("grid",gid).subsection("BC",0).count;
@@ -55,7 +79,8 @@ void set_bcs(int gid) {
 			pick=pick.substr(0,2);
 		}
 
-		if (region.get_string("region")=="box") {
+		// Faces loaded from the setup cache already have their boundary conditions
+		if (!cached && region.get_string("region")=="box") {
 			for (int f=0;f<grid[gid].faceCount;++f) {
 				// if the face is not already marked as internal or partition boundary
 				// And if the face centroid falls within the defined box
@@ -132,7 +157,8 @@ void set_bcs(int gid) {
 
 	grid[gid].boundaryFaceCount.resize(count);
 	for (int b=0;b<count;++b) grid[gid].boundaryFaceCount[b].resize(np);
-	grid[gid].globalBoundaryFaceCount.resize(count);
+	// A cached grid comes with the global counts already filled in, these are recounted
+	grid[gid].globalBoundaryFaceCount.assign(count,0);
 	for (int b=0;b<count;++b) {
 		grid[gid].boundaryFaceCount[b][Rank]=0;
 		for (int f=0;f<grid[gid].faceCount;++f) if(grid[gid].face[f].bc==b) grid[gid].boundaryFaceCount[b][Rank]++; 
@@ -162,99 +188,82 @@ void set_bcs(int gid) {
 
 
 
+	// The setup cache has the wall distances
+	if (cached) return;
+	
 	if (Rank==0) cout << "[I] Finding closest wall distances" << endl;
 	
 	MPI_Allgather(&number_of_nsf[Rank],1,MPI_INT,&number_of_nsf[0],1,MPI_INT,MPI_COMM_WORLD);
 
 	int nsf_sum=0;
 	int displacements[np];
+	int recv_counts[np];
 	// Total number of wall faces
 	for (int p=0;p<np;++p) {
-		displacements[p]=nsf_sum;
+		displacements[p]=6*nsf_sum;
+		recv_counts[p]=6*number_of_nsf[p];
 		nsf_sum+=number_of_nsf[p];
 	}
 
-	// Collect wall face centroids
-	vector<double> noSlipFaces_x(nsf_sum);
-	vector<double> noSlipFaces_y(nsf_sum);
-	vector<double> noSlipFaces_z(nsf_sum);
-
-	// Collect wall face normals
-	vector<double> noSlipFaces_Nx(nsf_sum);
-	vector<double> noSlipFaces_Ny(nsf_sum);
-	vector<double> noSlipFaces_Nz(nsf_sum);
+	// Collect wall face centroids and normals packed as (x,y,z,Nx,Ny,Nz) in a single exchange
+	vector<double> noSlipFaces(6*nsf_sum+1);
 
 	count=0;
 	for (int f=0;f<grid[gid].faceCount;++f) { // loop all the local faces
 		if (grid[gid].face[f].bc>=0 && bc[gid][grid[gid].face[f].bc].type==WALL && bc[gid][grid[gid].face[f].bc].kind!=SLIP) {
-			noSlipFaces_x[displacements[Rank]+count]=grid[gid].face[f].centroid[0];
-			noSlipFaces_y[displacements[Rank]+count]=grid[gid].face[f].centroid[1];
-			noSlipFaces_z[displacements[Rank]+count]=grid[gid].face[f].centroid[2];
-			noSlipFaces_Nx[displacements[Rank]+count]=grid[gid].face[f].normal[0];
-			noSlipFaces_Ny[displacements[Rank]+count]=grid[gid].face[f].normal[1];
-			noSlipFaces_Nz[displacements[Rank]+count]=grid[gid].face[f].normal[2];
+			for (int i=0;i<3;++i) {
+				noSlipFaces[displacements[Rank]+6*count+i]=grid[gid].face[f].centroid[i];
+				noSlipFaces[displacements[Rank]+6*count+3+i]=grid[gid].face[f].normal[i];
+			}
 			count++;
 		}
 	}
 
-	MPI_Allgatherv(&noSlipFaces_x[displacements[Rank]],number_of_nsf[Rank],MPI_DOUBLE,&noSlipFaces_x[0],&number_of_nsf[0],displacements,MPI_DOUBLE,MPI_COMM_WORLD);
-	MPI_Allgatherv(&noSlipFaces_y[displacements[Rank]],number_of_nsf[Rank],MPI_DOUBLE,&noSlipFaces_y[0],&number_of_nsf[0],displacements,MPI_DOUBLE,MPI_COMM_WORLD);
-	MPI_Allgatherv(&noSlipFaces_z[displacements[Rank]],number_of_nsf[Rank],MPI_DOUBLE,&noSlipFaces_z[0],&number_of_nsf[0],displacements,MPI_DOUBLE,MPI_COMM_WORLD);
-
-	MPI_Allgatherv(&noSlipFaces_Nx[displacements[Rank]],number_of_nsf[Rank],MPI_DOUBLE,&noSlipFaces_Nx[0],&number_of_nsf[0],displacements,MPI_DOUBLE,MPI_COMM_WORLD);
-	MPI_Allgatherv(&noSlipFaces_Ny[displacements[Rank]],number_of_nsf[Rank],MPI_DOUBLE,&noSlipFaces_Ny[0],&number_of_nsf[0],displacements,MPI_DOUBLE,MPI_COMM_WORLD);
-	MPI_Allgatherv(&noSlipFaces_Nz[displacements[Rank]],number_of_nsf[Rank],MPI_DOUBLE,&noSlipFaces_Nz[0],&number_of_nsf[0],displacements,MPI_DOUBLE,MPI_COMM_WORLD);
+	MPI_Allgatherv(&noSlipFaces[displacements[Rank]],recv_counts[Rank],MPI_DOUBLE,&noSlipFaces[0],recv_counts,displacements,MPI_DOUBLE,MPI_COMM_WORLD);
 
+	// Insert the wall face centroids to a kdtree
+	// The data pointer of each node points to the wall face normal
+	kdtree *kd=kd_create(3);
+	vector<int> order(nsf_sum);
+	for (int nsf=0;nsf<nsf_sum;++nsf) order[nsf]=nsf;
+	kd_insert_balanced(kd,noSlipFaces,order,0,nsf_sum,0);
+	
+	kdres *res;
+	double *fN;
 	Vec3D thisCentroid;
-	Vec3D fN;
-	double thisDistance;
 	// Loop all cells to find the closest distance to the wall
 	for (int c=0;c<grid[gid].cell.size();++c) {
 		grid[gid].cell[c].closest_wall_distance=1.e20;
-               
-		for (int nsf=0;nsf<nsf_sum;++nsf) {
-			thisCentroid[0]=noSlipFaces_x[nsf];
-			thisCentroid[1]=noSlipFaces_y[nsf];
-			thisCentroid[2]=noSlipFaces_z[nsf];
-			thisDistance=fabs(grid[gid].cell[c].centroid-thisCentroid);
-			if (grid[gid].cell[c].closest_wall_distance>thisDistance) {
-				grid[gid].cell[c].closest_wall_distance=thisDistance;
-			}
-	        }
+		if (nsf_sum==0) continue;
+		res=kd_nearest3(kd,grid[gid].cell[c].centroid[0],grid[gid].cell[c].centroid[1],grid[gid].cell[c].centroid[2]);
+		kd_res_item3(res,&thisCentroid[0],&thisCentroid[1],&thisCentroid[2]);
+		grid[gid].cell[c].closest_wall_distance=fabs(grid[gid].cell[c].centroid-thisCentroid);
+		kd_res_free(res);
 	}
 
 	// Loop all faces to find the closest distance to the wall
-        for (int f=0;f<grid[gid].faceCount;++f) {
-        	grid[gid].face[f].closest_wall_distance=1.e20;
+	for (int f=0;f<grid[gid].faceCount;++f) {
+		grid[gid].face[f].closest_wall_distance=1.e20;
 
 		// If the face is not a no-slip wall
-                if (grid[gid].face[f].bc<0 || bc[gid][grid[gid].face[f].bc].type!=WALL || bc[gid][grid[gid].face[f].bc].kind==SLIP) {
-                    for (int nsf=0;nsf<nsf_sum;++nsf) {
-                        thisCentroid[0]=noSlipFaces_x[nsf];
-                        thisCentroid[1]=noSlipFaces_y[nsf];
-                        thisCentroid[2]=noSlipFaces_z[nsf];
-                        thisDistance=fabs(grid[gid].face[f].centroid-thisCentroid);
-                        if (grid[gid].face[f].closest_wall_distance>thisDistance) {
-                                grid[gid].face[f].closest_wall_distance=thisDistance;
-                                fN[0]=noSlipFaces_Nx[nsf];
-                                fN[1]=noSlipFaces_Ny[nsf];
-                                fN[2]=noSlipFaces_Nz[nsf];
-                        }
-                    }
-                    grid[gid].face[f].dissipation_factor=1.-fabs(fN[0]*grid[gid].face[f].normal[0]+fN[1]*grid[gid].face[f].normal[1]+fN[2]*grid[gid].face[f].normal[2]);
-                } else {
-                       grid[gid].face[f].closest_wall_distance=0.;
-                       grid[gid].face[f].dissipation_factor=0.;
-        	}
+		if (grid[gid].face[f].bc<0 || bc[gid][grid[gid].face[f].bc].type!=WALL || bc[gid][grid[gid].face[f].bc].kind==SLIP) {
+			if (nsf_sum==0) {
+				grid[gid].face[f].dissipation_factor=1.;
+				continue;
+			}
+			res=kd_nearest3(kd,grid[gid].face[f].centroid[0],grid[gid].face[f].centroid[1],grid[gid].face[f].centroid[2]);
+			fN=(double *)kd_res_item3(res,&thisCentroid[0],&thisCentroid[1],&thisCentroid[2]);
+			grid[gid].face[f].closest_wall_distance=fabs(grid[gid].face[f].centroid-thisCentroid);
+			grid[gid].face[f].dissipation_factor=1.-fabs(fN[0]*grid[gid].face[f].normal[0]+fN[1]*grid[gid].face[f].normal[1]+fN[2]*grid[gid].face[f].normal[2]);
+			kd_res_free(res);
+		} else {
+			grid[gid].face[f].closest_wall_distance=0.;
+			grid[gid].face[f].dissipation_factor=0.;
+		}
 	}
 
-
-	noSlipFaces_x.clear();
-	noSlipFaces_Nx.clear();
-	noSlipFaces_y.clear();
-	noSlipFaces_Ny.clear();
-	noSlipFaces_z.clear();
-	noSlipFaces_Nz.clear();
+	kd_free(kd);
+	noSlipFaces.clear();
 
 	return;
 }
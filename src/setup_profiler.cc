@@ -0,0 +1,137 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer 
+ 
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include "setup_profiler.h"
+#include "utilities.h"
+#include <mpi.h>
+#include <sys/resource.h>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+
+extern int Rank,np;
+
+SetupProfiler::SetupProfiler() {
+	running=false;
+	setup_start_time=-1.;
+}
+
+double SetupProfiler::peak_rss(void) {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF,&usage);
+	return double(usage.ru_maxrss)/1024.; // reported in kB on Linux
+}
+
+void SetupProfiler::start(int gid,string name) {
+	if (running) stop();
+	Stage stage;
+	stage.gid=gid;
+	stage.name=name;
+	stages.push_back(stage);
+	start_time=MPI_Wtime();
+	if (setup_start_time<0.) setup_start_time=start_time;
+	start_rss=peak_rss();
+	running=true;
+	return;
+}
+
+void SetupProfiler::stop(void) {
+	if (!running) return;
+	stages.back().time=MPI_Wtime()-start_time;
+	stages.back().rss=peak_rss();
+	stages.back().rss_increase=stages.back().rss-start_rss;
+	running=false;
+	return;
+}
+
+void SetupProfiler::report(void) {
+	
+	stop();
+	double total_time=(setup_start_time<0.) ? 0. : MPI_Wtime()-setup_start_time;
+	
+	// Ranks only go through different stages if something is badly wrong, but check anyway
+	int count=stages.size();
+	int min_count,max_count;
+	MPI_Allreduce(&count,&min_count,1,MPI_INT,MPI_MIN,MPI_COMM_WORLD);
+	MPI_Allreduce(&count,&max_count,1,MPI_INT,MPI_MAX,MPI_COMM_WORLD);
+	if (min_count!=max_count) {
+		if (Rank==0) cerr << "[W] Setup stages differ between ranks, skipping the setup profile" << endl;
+		return;
+	}
+	if (count==0) return;
+	
+	// [stage] time and [count+stage] memory values
+	vector<double> values (3*count+1),min_values (3*count+1),max_values (3*count+1),sum_values (3*count+1);
+	for (int s=0;s<count;++s) {
+		values[s]=stages[s].time;
+		values[count+s]=stages[s].rss;
+		values[2*count+s]=stages[s].rss_increase;
+	}
+	values[3*count]=total_time;
+	MPI_Reduce(&values[0],&min_values[0],values.size(),MPI_DOUBLE,MPI_MIN,0,MPI_COMM_WORLD);
+	MPI_Reduce(&values[0],&max_values[0],values.size(),MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+	MPI_Reduce(&values[0],&sum_values[0],values.size(),MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+	
+	if (Rank==0) {
+		cout << "[I] Setup profile (wall time in seconds over " << np << " ranks, peak resident memory per rank in MB)" << endl;
+		cout << "[I] " << setw(5) << "grid" << "  " << left << setw(32) << "stage" << right
+			<< setw(11) << "min" << setw(11) << "avg" << setw(11) << "max" << setw(11) << "max/avg"
+			<< setw(11) << "peak RSS" << setw(11) << "increase" << endl;
+		cout << fixed;
+		for (int s=0;s<count;++s) {
+			double average=sum_values[s]/double(np);
+			cout << "[I] " << setw(5) << stages[s].gid+1 << "  " << left << setw(32) << stages[s].name << right
+				<< setprecision(3) << setw(11) << min_values[s] << setw(11) << average << setw(11) << max_values[s]
+				<< setprecision(2) << setw(11) << ((average>0.) ? max_values[s]/average : 1.)
+				<< setprecision(1) << setw(11) << max_values[count+s] << setw(11) << max_values[2*count+s] << endl;
+		}
+		cout << "[I] Total setup time = " << setprecision(3) << max_values[3*count] << " sec" << endl;
+		cout.unsetf(ios::floatfield);
+		cout << setprecision(6);
+		
+		ofstream file;
+		file.open("setup_profile.json",ios::out);
+		file << "{" << endl;
+		file << "\t\"ranks\": " << np << "," << endl;
+		file << "\t\"threads\": " << thread_count() << "," << endl;
+		file << "\t\"total_time_max\": " << max_values[3*count] << "," << endl;
+		file << "\t\"stages\": [" << endl;
+		for (int s=0;s<count;++s) {
+			file << "\t\t{\"grid\": " << stages[s].gid+1 << ", \"stage\": \"" << stages[s].name << "\""
+				<< ", \"time_min\": " << min_values[s]
+				<< ", \"time_avg\": " << sum_values[s]/double(np)
+				<< ", \"time_max\": " << max_values[s]
+				<< ", \"rss_max_mb\": " << max_values[count+s]
+				<< ", \"rss_increase_max_mb\": " << max_values[2*count+s] << "}";
+			if (s<count-1) file << ",";
+			file << endl;
+		}
+		file << "\t]" << endl;
+		file << "}" << endl;
+		file.close();
+	}
+	
+	stages.clear();
+	setup_start_time=-1.;
+	
+	return;
+}
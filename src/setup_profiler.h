@@ -0,0 +1,57 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer 
+ 
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#ifndef SETUP_PROFILER_H
+#define SETUP_PROFILER_H
+
+#include <string>
+#include <vector>
+using namespace std;
+
+// Wall time and peak resident memory of each preprocessing stage
+// Starting a stage ends the running one. All ranks go through the same stages,
+// report() combines them (min/avg/max over ranks), prints a table and writes
+// ./setup_profile.json from rank 0
+class SetupProfiler {
+public:
+	SetupProfiler();
+	void start(int gid,string name);
+	void stop(void);
+	void report(void);
+	
+private:
+	struct Stage {
+		int gid;
+		string name;
+		double time;
+		double rss; // Peak resident memory at the end of the stage (MB)
+		double rss_increase; // How much the peak grew during the stage (MB)
+	};
+	vector<Stage> stages;
+	bool running;
+	double start_time,start_rss,setup_start_time;
+	double peak_rss(void);
+};
+
+extern SetupProfiler setup_profiler;
+
+#endif
@@ -0,0 +1,346 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+using namespace std;
+
+#include "utilities.h"
+#include "grid.h"
+#include "inputs.h"
+#include "statistics.h"
+
+// A cell can't have more boundary faces than this
+#define STATISTICS_MAX_CELL_FACES 64
+
+extern vector<Grid> grid;
+extern InputFile input;
+
+bool cell_var_is_vec3d(string name);
+bool face_var_is_vec3d(string name);
+void get_cell_var(int gid,string name,int i,vector<double> &data);
+void get_face_var(int gid,string name,int i,int b,vector<double> &data);
+
+Statistics::Statistics() {
+	count=0;
+	start=0;
+	window=0;
+	minmax=false;
+}
+
+void Statistics::initialize(int g) {
+	
+	gid=g;
+	start=input.section("grid",gid).subsection("writeoutput").get_int("statisticsstart");
+	window=input.section("grid",gid).subsection("writeoutput").get_int("statisticswindow");
+	minmax=(input.section("grid",gid).subsection("writeoutput").get_string("statisticsminmax")=="on");
+	
+	vector<string> varList=input.section("grid",gid).subsection("writeoutput").get_stringList("statisticsvariables");
+	for (int var=0;var<varList.size();++var) {
+		if (varList[var]==" " || varList[var]=="null") continue;
+		add_field(cellFields,varList[var],cell_var_is_vec3d(varList[var]) ? 3 : 1,grid[gid].cellCount);
+	}
+	
+	bcOffset.resize(grid[gid].bcCount+1);
+	bcOffset[0]=0;
+	for (int b=0;b<grid[gid].bcCount;++b) bcOffset[b+1]=bcOffset[b]+grid[gid].boundaryFaces[b].size();
+	
+	varList=input.section("grid",gid).subsection("writeoutput").get_stringList("statisticssurfacevariables");
+	for (int var=0;var<varList.size();++var) {
+		if (varList[var]==" " || varList[var]=="null") continue;
+		add_field(faceFields,varList[var],face_var_is_vec3d(varList[var]) ? 3 : 1,bcOffset.back());
+	}
+	if (!faceFields.empty()) set_face_keys();
+	
+	if (active() && grid[gid].Rank==0) {
+		cout << "[I grid=" << gid+1 << " ] Time statistics start after time step " << start;
+		if (window>0) cout << " and cover " << window << " time steps";
+		cout << endl;
+	}
+	
+	return;
+}
+
+void Statistics::add_field(vector<StatisticsField> &fields,string name,int components,int size) {
+	
+	// Restart entries are named sstat.<var> at most
+	if (name.size()+6>=RESTART_NAME_LENGTH) {
+		if (grid[gid].Rank==0) cerr << "[E] Statistics variable name " << name << " is too long" << endl;
+		exit(1);
+	}
+	
+	StatisticsField field;
+	field.name=name;
+	field.components=components;
+	field.mean.resize(size*components,0.);
+	field.m2.resize(size*components,0.);
+	if (minmax) {
+		field.min.resize(size*components,0.);
+		field.max.resize(size*components,0.);
+	}
+	fields.push_back(field);
+	
+	return;
+}
+
+vector<int> sorted_global_nodes(int gid,int f) {
+	vector<int> nodes;
+	for (int fn=0;fn<grid[gid].face[f].nodes.size();++fn) nodes.push_back(grid[gid].node[grid[gid].face[f].nodes[fn]].globalId);
+	sort(nodes.begin(),nodes.end());
+	return nodes;
+}
+
+void Statistics::set_face_keys(void) {
+	
+	// A boundary face is identified by its parent cell and its position among the boundary faces of that cell,
+	// ordered by their sorted global node ids
+	faceKeys.resize(bcOffset.back());
+	for (int b=0;b<grid[gid].bcCount;++b) {
+		for (int k=0;k<grid[gid].boundaryFaces[b].size();++k) {
+			int f=grid[gid].boundaryFaces[b][k];
+			Cell &parent=grid[gid].cell[grid[gid].face[f].parent];
+			vector<int> nodes=sorted_global_nodes(gid,f);
+			int position=0;
+			for (int cf=0;cf<parent.faces.size();++cf) {
+				int f2=parent.faces[cf];
+				if (f2!=f && grid[gid].face[f2].bc>=0 && sorted_global_nodes(gid,f2)<nodes) position++;
+			}
+			faceKeys[bcOffset[b]+k]=(long long)(parent.globalId)*STATISTICS_MAX_CELL_FACES+position;
+		}
+	}
+	
+	return;
+}
+
+void Statistics::update(int timeStep) {
+	
+	if (!active() || timeStep<=start) return;
+	if (window>0 && timeStep>start+window) return;
+	count++;
+	
+	vector<double> values;
+	for (int var=0;var<cellFields.size();++var) {
+		values.resize(grid[gid].cellCount);
+		for (int i=0;i<cellFields[var].components;++i) {
+			::get_cell_var(gid,cellFields[var].name,i,values);
+			sample(cellFields[var],values,i);
+		}
+	}
+	
+	vector<double> bcValues;
+	for (int var=0;var<faceFields.size();++var) {
+		values.resize(bcOffset.back());
+		for (int i=0;i<faceFields[var].components;++i) {
+			for (int b=0;b<grid[gid].bcCount;++b) {
+				bcValues.assign(grid[gid].boundaryFaces[b].size(),0.);
+				::get_face_var(gid,faceFields[var].name,i,b,bcValues);
+				for (int k=0;k<bcValues.size();++k) values[bcOffset[b]+k]=bcValues[k];
+			}
+			sample(faceFields[var],values,i);
+		}
+	}
+	
+	return;
+}
+
+void Statistics::sample(StatisticsField &field,vector<double> &values,int i) {
+	
+	double weight=1./double(count);
+	int n=values.size();
+	#pragma omp parallel for schedule(static)
+	for (int k=0;k<n;++k) {
+		int index=k*field.components+i;
+		double delta=values[k]-field.mean[index];
+		field.mean[index]+=delta*weight;
+		field.m2[index]+=delta*(values[k]-field.mean[index]);
+		if (minmax) {
+			if (count==1 || values[k]<field.min[index]) field.min[index]=values[k];
+			if (count==1 || values[k]>field.max[index]) field.max[index]=values[k];
+		}
+	}
+	
+	return;
+}
+
+StatisticsField *Statistics::find(vector<StatisticsField> &fields,string name,string &quantity) {
+	
+	size_t split=name.find('_');
+	if (split==string::npos) return NULL;
+	quantity=name.substr(0,split);
+	if (quantity!="mean" && quantity!="rms" && !(minmax && (quantity=="min" || quantity=="max"))) return NULL;
+	for (int var=0;var<fields.size();++var) {
+		if (fields[var].name==name.substr(split+1)) return &fields[var];
+	}
+	return NULL;
+}
+
+void Statistics::get(StatisticsField &field,string quantity,int i,int first,vector<double> &data) {
+	
+	for (int k=0;k<data.size();++k) {
+		int index=(first+k)*field.components+i;
+		if (quantity=="mean") data[k]=field.mean[index];
+		else if (quantity=="rms") data[k]=(count>0) ? sqrt(field.m2[index]/double(count)) : 0.;
+		else if (quantity=="min") data[k]=field.min[index];
+		else if (quantity=="max") data[k]=field.max[index];
+	}
+	
+	return;
+}
+
+bool Statistics::get_cell_var(string name,int i,vector<double> &data) {
+	
+	string quantity;
+	StatisticsField *field=find(cellFields,name,quantity);
+	if (field==NULL) return false;
+	get(*field,quantity,i,0,data);
+	return true;
+}
+
+bool Statistics::get_face_var(string name,int i,int b,vector<double> &data) {
+	
+	string quantity;
+	StatisticsField *field=find(faceFields,name,quantity);
+	if (field==NULL) return false;
+	get(*field,quantity,i,bcOffset[b],data);
+	return true;
+}
+
+vector<string> Statistics::output_variables(bool surface) {
+	
+	vector<StatisticsField> &fields=surface ? faceFields : cellFields;
+	vector<string> varList;
+	for (int var=0;var<fields.size();++var) {
+		varList.push_back("mean_"+fields[var].name);
+		varList.push_back("rms_"+fields[var].name);
+		if (minmax) {
+			varList.push_back("min_"+fields[var].name);
+			varList.push_back("max_"+fields[var].name);
+		}
+	}
+	return varList;
+}
+
+void Statistics::reset(StatisticsField &field) {
+	fill(field.mean.begin(),field.mean.end(),0.);
+	fill(field.m2.begin(),field.m2.end(),0.);
+	fill(field.min.begin(),field.min.end(),0.);
+	fill(field.max.begin(),field.max.end(),0.);
+	return;
+}
+
+void Statistics::pack(StatisticsField &field,vector<double> &buffer) {
+	
+	int n=field.mean.size();
+	buffer.resize(n*stride());
+	for (int k=0;k<n;++k) {
+		buffer[k*stride()]=field.mean[k];
+		buffer[k*stride()+1]=field.m2[k];
+		if (minmax) {
+			buffer[k*stride()+2]=field.min[k];
+			buffer[k*stride()+3]=field.max[k];
+		}
+	}
+	
+	return;
+}
+
+void Statistics::unpack(StatisticsField &field,vector<double> &buffer) {
+	
+	int n=field.mean.size();
+	for (int k=0;k<n;++k) {
+		field.mean[k]=buffer[k*stride()];
+		field.m2[k]=buffer[k*stride()+1];
+		if (minmax) {
+			field.min[k]=buffer[k*stride()+2];
+			field.max[k]=buffer[k*stride()+3];
+		}
+	}
+	
+	return;
+}
+
+void Statistics::write_restart(RestartFile &restart) {
+	
+	if (!active() || count==0) return;
+	
+	// The sample count is a single record written by rank 0
+	vector<long long> countKey;
+	vector<double> countValue;
+	if (grid[gid].Rank==0) {
+		countKey.push_back(0);
+		countValue.push_back(count);
+	}
+	restart.add("stat.count",1,countKey,countValue);
+	
+	vector<double> buffer;
+	for (int var=0;var<cellFields.size();++var) {
+		pack(cellFields[var],buffer);
+		restart.add("stat."+cellFields[var].name,stride()*cellFields[var].components,buffer);
+	}
+	for (int var=0;var<faceFields.size();++var) {
+		pack(faceFields[var],buffer);
+		restart.add("sstat."+faceFields[var].name,stride()*faceFields[var].components,faceKeys,buffer);
+	}
+	
+	return;
+}
+
+void Statistics::read_restart(RestartFile &restart) {
+	
+	if (!active() || !restart.has("stat.count",1,true)) return;
+	
+	// Carry on from the saved statistics only if all of them are there in the same form
+	bool complete=true;
+	for (int var=0;var<cellFields.size();++var) {
+		if (!restart.has("stat."+cellFields[var].name,stride()*cellFields[var].components,false)) complete=false;
+	}
+	for (int var=0;var<faceFields.size();++var) {
+		if (!restart.has("sstat."+faceFields[var].name,stride()*faceFields[var].components,true)) complete=false;
+	}
+	
+	vector<double> buffer;
+	vector<long long> countKey (1,0);
+	if (complete) {
+		restart.read("stat.count",1,countKey,buffer);
+		count=int(buffer[0]);
+		for (int var=0;var<cellFields.size();++var) {
+			restart.read("stat."+cellFields[var].name,stride()*cellFields[var].components,buffer);
+			unpack(cellFields[var],buffer);
+		}
+		for (int var=0;var<faceFields.size();++var) {
+			if (!restart.read("sstat."+faceFields[var].name,stride()*faceFields[var].components,faceKeys,buffer)) complete=false;
+			unpack(faceFields[var],buffer);
+		}
+	}
+	
+	if (complete) {
+		if (grid[gid].Rank==0) cout << "[I grid=" << gid+1 << " ] Continuing time statistics from " << count << " samples" << endl;
+	} else {
+		if (grid[gid].Rank==0) cout << "[W grid=" << gid+1 << " ] Time statistics in the restart file don't match the requested ones, starting over" << endl;
+		count=0;
+		for (int var=0;var<cellFields.size();++var) reset(cellFields[var]);
+		for (int var=0;var<faceFields.size();++var) reset(faceFields[var]);
+	}
+	
+	return;
+}
@@ -0,0 +1,80 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "restart_file.h"
+
+// Running statistics of one variable
+// Values of cell or boundary face i are stored at [i*components]
+class StatisticsField {
+public:
+	string name;
+	int components;
+	vector<double> mean,m2; // m2 is the sum of squared deviations from the mean
+	vector<double> min,max;
+};
+
+// Time statistics of selected cell and boundary face variables for unsteady runs
+// Every time step within the window updates the statistics in place with Welford's algorithm, 
+// so no time history is kept and the memory cost is fixed
+// Results are available to the outputs as mean_<var>, rms_<var>, min_<var> and max_<var>,
+// where rms is the root mean square of the fluctuations around the mean
+class Statistics {
+public:
+	int gid;
+	int start; // Samples are taken at the time steps after this one
+	int window; // Number of time steps to sample, 0 for no limit
+	bool minmax; // Also track the minimum and maximum
+	int count; // Number of samples taken so far
+	vector<StatisticsField> cellFields,faceFields;
+	vector<int> bcOffset; // Position of the first boundary face of each boundary condition in the face fields
+	vector<long long> faceKeys; // Boundary face ids that don't depend on the partitioning, for the restart
+	
+	Statistics();
+	void initialize(int gid);
+	bool active(void) { return !cellFields.empty() || !faceFields.empty(); }
+	void update(int timeStep);
+	bool get_cell_var(string name,int i,vector<double> &data);
+	bool get_face_var(string name,int i,int b,vector<double> &data);
+	vector<string> output_variables(bool surface);
+	void write_restart(RestartFile &restart);
+	void read_restart(RestartFile &restart);
+	
+private:
+	void set_face_keys(void);
+	void add_field(vector<StatisticsField> &fields,string name,int components,int size);
+	void sample(StatisticsField &field,vector<double> &values,int i);
+	StatisticsField *find(vector<StatisticsField> &fields,string name,string &quantity);
+	void get(StatisticsField &field,string quantity,int i,int first,vector<double> &data);
+	void reset(StatisticsField &field);
+	int stride(void) { return minmax ? 4 : 2; }
+	void pack(StatisticsField &field,vector<double> &buffer);
+	void unpack(StatisticsField &field,vector<double> &buffer);
+};
+
+#endif
@@ -0,0 +1,103 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include "tecplot_binary.h"
+#include <mpi.h>
+#include <cstring>
+#include <limits>
+
+extern int Rank,np;
+
+void TecplotBinaryJob::put_int(string &block,int value) {
+	block.append((const char *) &value,sizeof(int));
+	return;
+}
+
+void TecplotBinaryJob::put_float(string &block,float value) {
+	block.append((const char *) &value,sizeof(float));
+	return;
+}
+
+void TecplotBinaryJob::put_double(string &block,double value) {
+	block.append((const char *) &value,sizeof(double));
+	return;
+}
+
+void TecplotBinaryJob::put_string(string &block,string value) {
+	// Each character goes as a 32 bit integer, terminated by a zero
+	for (int i=0;i<value.size();++i) put_int(block,int(value[i]));
+	put_int(block,0);
+	return;
+}
+
+void TecplotBinaryJob::put_ints(string &block,vector<int> &values) {
+	if (!values.empty()) block.append((const char *) &values[0],values.size()*sizeof(int));
+	return;
+}
+
+void TecplotBinaryJob::put_values(string &block,vector<double> &values,int range) {
+	for (int i=0;i<values.size();++i) {
+		rangeMin[range]=min(rangeMin[range],values[i]);
+		rangeMax[range]=max(rangeMax[range],values[i]);
+	}
+	if (!values.empty()) block.append((const char *) &values[0],values.size()*sizeof(double));
+	return;
+}
+
+int TecplotBinaryJob::new_range(void) {
+	rangeMin.push_back(numeric_limits<double>::max());
+	rangeMax.push_back(-numeric_limits<double>::max());
+	return rangeMin.size()-1;
+}
+
+void TecplotBinaryJob::put_ranges(string &block,int section,vector<int> &ranges) {
+	for (int i=0;i<ranges.size();++i) {
+		placeholderSection.push_back(section);
+		placeholderRange.push_back(ranges[i]);
+		placeholderPosition.push_back(block.size());
+		put_double(block,0.);
+		put_double(block,0.);
+	}
+	return;
+}
+
+void TecplotBinaryJob::commit(void) {
+	
+	int nRanges=rangeMin.size();
+	if (nRanges>0) {
+		vector<double> globalMin (nRanges),globalMax (nRanges);
+		MPI_Allreduce(&rangeMin[0],&globalMin[0],nRanges,MPI_DOUBLE,MPI_MIN,MPI_COMM_WORLD);
+		MPI_Allreduce(&rangeMax[0],&globalMax[0],nRanges,MPI_DOUBLE,MPI_MAX,MPI_COMM_WORLD);
+		for (int p=0;p<placeholderSection.size();++p) {
+			double pair[2];
+			pair[0]=globalMin[placeholderRange[p]];
+			pair[1]=globalMax[placeholderRange[p]];
+			// Empty variables
+			if (pair[0]>pair[1]) pair[0]=pair[1]=0.;
+			sections[placeholderSection[p]].replace(placeholderPosition[p],sizeof(pair),(const char *) pair,sizeof(pair));
+		}
+	}
+	
+	SharedFileJob::commit();
+	
+	return;
+}
@@ -0,0 +1,63 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#ifndef TECPLOT_BINARY_H
+#define TECPLOT_BINARY_H
+
+#include <string>
+#include <vector>
+#include "async_output.h"
+using namespace std;
+
+// Tecplot binary data file (.plt, version 112) written by all ranks into a single file
+// Each rank packs its blocks with the functions below
+// The header and the zone data headers are packed only by proc 0
+// The variable ranges in the zone data headers are completed in commit once all ranks know theirs
+
+#define TECPLOT_ZONE_MARKER 299.
+#define TECPLOT_EOH_MARKER 357.
+#define TECPLOT_DOUBLE 2
+#define TECPLOT_FEQUADRILATERAL 3
+#define TECPLOT_FEPOLYHEDRON 7
+
+class TecplotBinaryJob : public SharedFileJob {
+public:
+	void commit(void);
+protected:
+	void put_int(string &block,int value);
+	void put_float(string &block,float value);
+	void put_double(string &block,double value);
+	void put_string(string &block,string value);
+	void put_ints(string &block,vector<int> &values);
+	// Packs the values of a variable and updates its range
+	void put_values(string &block,vector<double> &values,int range);
+	// Adds a variable range and returns its index
+	int new_range(void);
+	// Leaves room for the min/max pairs of the given ranges in a section of proc 0
+	void put_ranges(string &block,int section,vector<int> &ranges);
+private:
+	vector<double> rangeMin,rangeMax;
+	vector<int> placeholderSection,placeholderRange;
+	vector<long long> placeholderPosition;
+};
+
+#endif
@@ -76,6 +76,30 @@ void set_time_step_options(void) {
 		}
 	}
 	
+	cfl_adaptive=input.section("timemarching").subsection("adaptiveCFL").is_found;
+	cfl_adaptive_initial=input.section("timemarching").subsection("adaptiveCFL").get_double("initial");
+	cfl_adaptive_min=input.section("timemarching").subsection("adaptiveCFL").get_double("minimum");
+	cfl_adaptive_growth=input.section("timemarching").subsection("adaptiveCFL").get_double("growth");
+	cfl_adaptive_cut=input.section("timemarching").subsection("adaptiveCFL").get_double("cut");
+	cfl_adaptive_exponent=input.section("timemarching").subsection("adaptiveCFL").get_double("exponent");
+	if (cfl_adaptive) {
+		if (time_step_type!=CFL_MAX && time_step_type!=CFL_LOCAL) {
+			cerr << "[E] Input entry timemarching -> adaptiveCFL needs CFLmax or CFLlocal to be specified!!" << endl;
+			exit(1);
+		}
+		if (time_step_ramp || cfl_schedule) {
+			cerr << "[E] Input entry timemarching -> adaptiveCFL can't be used together with ramp or schedule file!!" << endl;
+			exit(1);
+		}
+		if (cfl_adaptive_growth<1. || cfl_adaptive_cut<=0. || cfl_adaptive_cut>=1.) {
+			cerr << "[E] Input entry timemarching -> adaptiveCFL needs growth>=1 and 0<cut<1!!" << endl;
+			exit(1);
+		}
+		// The CFL specified above is the upper limit, adapt_cfl sets the CFL of each grid before its time step
+		cfl_adaptive_current.resize(grid.size(),-1.);
+		cfl_adaptive_last_res.resize(grid.size(),-1.);
+	}
+	
 	// Allocate the time step variable
 	dt.resize(grid.size());
 	for (int gid=0;gid<grid.size();++gid) dt[gid].allocate(gid);
@@ -140,10 +164,38 @@ void update_pseudo_time_step_options(void) {
 	return;
 }
 
+void adapt_cfl(int gid) {
+	
+	double &CFL=(time_step_type==CFL_MAX) ? CFLmax : CFLlocal;
+	double target=(time_step_type==CFL_MAX) ? CFLmaxTarget : CFLlocalTarget;
+	
+	double &current=cfl_adaptive_current[gid];
+	double &last_res=cfl_adaptive_last_res[gid];
+	
+	if (current<0.) {
+		current=cfl_adaptive_initial;
+		last_res=-1.;
+	} else if (equations[gid]==NS) {
+		// CFL_n=CFL_n-1*(res_n-2/res_n-1)^exponent, with the change per step limited
+		double factor=1.;
+		if (ns[gid].linear_failed) factor=cfl_adaptive_cut;
+		else if (last_res>0. && ns[gid].res>0.) factor=pow(last_res/ns[gid].res,cfl_adaptive_exponent);
+		factor=max(cfl_adaptive_cut,min(factor,cfl_adaptive_growth));
+		current*=factor;
+		last_res=ns[gid].res;
+	}
+	current=max(cfl_adaptive_min,min(current,target));
+	CFL=current;
+	
+	return;
+}
+
 void update_time_step(int timeStep,double &time,double &max_cfl,int gid) {
 	
+	if (cfl_adaptive && !cfl_retry) adapt_cfl(gid);
+	
 	// TODO: What to do with ramping when restarting
-	if (time_step_ramp) {
+	if (time_step_ramp && !cfl_retry) {
 		if (timeStep==1) {
 			if (time_step_type==FIXED) time_step_current=time_step_ramp_initial;
 			if (time_step_type==CFL_MAX) CFLmax=time_step_ramp_initial;
@@ -288,3 +340,20 @@ void update_pseudo_time_step(int ps_step,double &max_cfl,int gid) {
 	return;
 }
 
+
+bool rollback_time_step(int timeStep,double &time,double &max_cfl,int gid) {
+	
+	// Nothing to cut down to
+	if (!cfl_adaptive || cfl_adaptive_current[gid]<=cfl_adaptive_min) return false;
+	
+	double &CFL=(time_step_type==CFL_MAX) ? CFLmax : CFLlocal;
+	cfl_adaptive_current[gid]=max(cfl_adaptive_min,cfl_adaptive_current[gid]*cfl_adaptive_cut);
+	CFL=cfl_adaptive_current[gid];
+	
+	time-=time_step_current;
+	cfl_retry=true;
+	update_time_step(timeStep,time,max_cfl,gid);
+	cfl_retry=false;
+	
+	return true;
+}
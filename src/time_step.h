@@ -54,4 +54,12 @@ bool ps_time_step_ramp;
 double ps_time_step_ramp_initial,ps_time_step_ramp_growth;
 
 string schedule_file_name;
-bool cfl_schedule;
\ No newline at end of file
+bool cfl_schedule;
+
+// Switched evolution relaxation: CFL follows the drop of the NS residual
+bool cfl_adaptive;
+double cfl_adaptive_initial,cfl_adaptive_min,cfl_adaptive_growth,cfl_adaptive_cut,cfl_adaptive_exponent;
+// Controller state of each grid
+vector<double> cfl_adaptive_current; // negative until the controller starts, survives re-reading the inputs
+vector<double> cfl_adaptive_last_res;
+bool cfl_retry=false; // recomputing the time step of a rolled back step
\ No newline at end of file
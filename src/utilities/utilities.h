@@ -33,6 +33,10 @@ using namespace std;
 
 #include "vec3d.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 string int2str(int number);
 
 bool fexists(const char *filename);
@@ -43,4 +47,31 @@ bool withinSphere(Vec3D point, Vec3D center, double radius);
 
 int gelimd(vector<vector<double> > &a,vector<double> &b,vector<double> &x);
 
+// Index of the calling thread within the rank and the number of threads per rank
+// Both fall back to a single thread if the code is built without OpenMP
+inline int thread_id(void) {
+#ifdef _OPENMP
+	return omp_get_thread_num();
+#else
+	return 0;
+#endif
+}
+
+inline int thread_count(void) {
+#ifdef _OPENMP
+	return omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+// Number of threads in the current parallel region, which can be less than thread_count()
+inline int team_size(void) {
+#ifdef _OPENMP
+	return omp_get_num_threads();
+#else
+	return 1;
+#endif
+}
+
 #endif
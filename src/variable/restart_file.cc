@@ -0,0 +1,420 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#include "restart_file.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+struct global_id_compare {
+	int gid;
+	bool operator() (int a,int b) const { return grid[gid].cell[a].globalId<grid[gid].cell[b].globalId; }
+};
+
+RestartFile::RestartFile(int g) {
+	
+	gid=g;
+	legacy=false;
+	memset(&header,0,sizeof(header));
+	strcpy(header.magic,"FCFDRST");
+	header.version=RESTART_FILE_VERSION;
+	header.globalCellCount=grid[gid].globalCellCount;
+	for (int i=0;i<6;++i) header.first_residuals[i]=-1.;
+	
+	// File views need monotonically increasing displacements
+	order.resize(grid[gid].cellCount);
+	for (int c=0;c<grid[gid].cellCount;++c) order[c]=c;
+	global_id_compare compare;
+	compare.gid=gid;
+	sort(order.begin(),order.end(),compare);
+	
+	return;
+}
+
+MPI_Datatype RestartFile::cell_type(int components) {
+	
+	// Selects the local cells at their global id positions in a variable's data block
+	MPI_Datatype one_cell,file_type;
+	MPI_Type_contiguous(components,MPI_DOUBLE,&one_cell);
+	MPI_Type_commit(&one_cell);
+	vector<int> displacements (order.size()+1);
+	for (int i=0;i<order.size();++i) displacements[i]=grid[gid].cell[order[i]].globalId;
+	MPI_Type_create_indexed_block(order.size(),1,&displacements[0],one_cell,&file_type);
+	MPI_Type_commit(&file_type);
+	MPI_Type_free(&one_cell);
+	
+	return file_type;
+}
+
+int RestartFile::new_entry(string name,int components,int keyed) {
+	
+	if (name.size()>=RESTART_NAME_LENGTH) {
+		if (grid[gid].Rank==0) cerr << "[E] Restart variable name " << name << " is longer than " << RESTART_NAME_LENGTH-1 << " characters" << endl;
+		MPI_Abort(MPI_COMM_WORLD,1);
+	}
+	
+	RestartTableEntry entry;
+	memset(&entry,0,sizeof(entry));
+	strncpy(entry.name,name.c_str(),RESTART_NAME_LENGTH-1);
+	entry.components=components;
+	entry.keyed=keyed;
+	table.push_back(entry);
+	data.resize(table.size());
+	keys.resize(table.size());
+	keyedStart.resize(table.size(),0);
+	keyedTotal.resize(table.size(),0);
+	
+	return table.size()-1;
+}
+
+void RestartFile::add(string name,int components,vector<double> &values) {
+	
+	vector<double> &buffer=data[new_entry(name,components,0)];
+	buffer.resize(grid[gid].cellCount*components);
+	for (int i=0;i<order.size();++i) {
+		for (int j=0;j<components;++j) buffer[i*components+j]=values[order[i]*components+j];
+	}
+	
+	return;
+}
+
+void RestartFile::add(string name,int components,vector<long long> &recordKeys,vector<double> &values) {
+	
+	int v=new_entry(name,components,1);
+	keys[v]=recordKeys;
+	data[v]=values;
+	long long count=recordKeys.size();
+	MPI_Allreduce(&count,&keyedTotal[v],1,MPI_LONG_LONG,MPI_SUM,MPI_COMM_WORLD);
+	MPI_Exscan(&count,&keyedStart[v],1,MPI_LONG_LONG,MPI_SUM,MPI_COMM_WORLD);
+	if (grid[gid].Rank==0) keyedStart[v]=0;
+	
+	return;
+}
+
+void RestartFile::write(string name) {
+	
+	fileName=name;
+	header.nVars=table.size();
+	
+	// Assign the data offsets
+	long long offset=sizeof(RestartHeader)+table.size()*sizeof(RestartTableEntry);
+	for (int v=0;v<table.size();++v) {
+		table[v].offset=offset;
+		if (table[v].keyed) offset+=sizeof(long long)+keyedTotal[v]*(sizeof(long long)+table[v].components*sizeof(double));
+		else offset+=(long long)(header.globalCellCount)*table[v].components*sizeof(double);
+	}
+	
+	MPI_File fh;
+	if (MPI_File_open(MPI_COMM_WORLD,(char *)fileName.c_str(),MPI_MODE_CREATE | MPI_MODE_WRONLY,MPI_INFO_NULL,&fh)!=MPI_SUCCESS) {
+		if (grid[gid].Rank==0) cerr << "[E] Restart file " << fileName << " couldn't be opened for writing" << endl;
+		MPI_Abort(MPI_COMM_WORLD,1);
+	}
+	MPI_File_set_size(fh,0);
+	
+	if (grid[gid].Rank==0) {
+		MPI_File_write_at(fh,0,&header,sizeof(RestartHeader),MPI_BYTE,MPI_STATUS_IGNORE);
+		if (table.size()>0) MPI_File_write_at(fh,sizeof(RestartHeader),&table[0],table.size()*sizeof(RestartTableEntry),MPI_BYTE,MPI_STATUS_IGNORE);
+	}
+	
+	double dummy;
+	for (int v=0;v<table.size();++v) {
+		if (table[v].keyed) {
+			// Records are stored in rank order
+			MPI_File_set_view(fh,0,MPI_BYTE,MPI_BYTE,(char *)"native",MPI_INFO_NULL);
+			MPI_Offset keyOffset=table[v].offset+sizeof(long long);
+			MPI_Offset dataOffset=keyOffset+keyedTotal[v]*sizeof(long long);
+			if (grid[gid].Rank==0) MPI_File_write_at(fh,table[v].offset,&keyedTotal[v],1,MPI_LONG_LONG,MPI_STATUS_IGNORE);
+			long long dummyKey;
+			MPI_File_write_at_all(fh,keyOffset+keyedStart[v]*sizeof(long long),keys[v].empty() ? &dummyKey : &keys[v][0],keys[v].size(),MPI_LONG_LONG,MPI_STATUS_IGNORE);
+			MPI_File_write_at_all(fh,dataOffset+keyedStart[v]*table[v].components*sizeof(double),data[v].empty() ? &dummy : &data[v][0],data[v].size(),MPI_DOUBLE,MPI_STATUS_IGNORE);
+			continue;
+		}
+		MPI_Datatype file_type=cell_type(table[v].components);
+		MPI_File_set_view(fh,table[v].offset,MPI_DOUBLE,file_type,(char *)"native",MPI_INFO_NULL);
+		MPI_File_write_all(fh,data[v].empty() ? &dummy : &data[v][0],data[v].size(),MPI_DOUBLE,MPI_STATUS_IGNORE);
+		MPI_Type_free(&file_type);
+	}
+	
+	MPI_File_close(&fh);
+	
+	return;
+}
+
+bool RestartFile::open(int restart_step) {
+	
+	string dirname="./restart/"+int2str(restart_step)+"/";
+	fileName=dirname+"restart."+int2str(gid+1);
+	
+	if (!fexists(fileName.c_str())) {
+		// Fall back to the older format
+		legacy=true;
+		legacyDir=dirname;
+		read_legacy_header(restart_step);
+		return true;
+	}
+	
+	MPI_File fh;
+	if (MPI_File_open(MPI_COMM_WORLD,(char *)fileName.c_str(),MPI_MODE_RDONLY,MPI_INFO_NULL,&fh)!=MPI_SUCCESS) {
+		if (grid[gid].Rank==0) cerr << "[E] Restart file " << fileName << " couldn't be opened" << endl;
+		MPI_Abort(MPI_COMM_WORLD,1);
+	}
+	
+	// Rank 0 reads the header and the variable table and broadcasts them
+	if (grid[gid].Rank==0) MPI_File_read_at(fh,0,&header,sizeof(RestartHeader),MPI_BYTE,MPI_STATUS_IGNORE);
+	MPI_Bcast(&header,sizeof(RestartHeader),MPI_BYTE,0,MPI_COMM_WORLD);
+	
+	if (strcmp(header.magic,"FCFDRST")!=0 || header.version>RESTART_FILE_VERSION) {
+		if (grid[gid].Rank==0) cerr << "[E] " << fileName << " is not a valid restart file" << endl;
+		MPI_Abort(MPI_COMM_WORLD,1);
+	}
+	if (header.globalCellCount!=grid[gid].globalCellCount) {
+		if (grid[gid].Rank==0) cerr << "[E] Restart file " << fileName << " has " << header.globalCellCount << " cells while the grid has " << grid[gid].globalCellCount << endl;
+		MPI_Abort(MPI_COMM_WORLD,1);
+	}
+	
+	table.resize(header.nVars);
+	if (grid[gid].Rank==0 && header.nVars>0) MPI_File_read_at(fh,sizeof(RestartHeader),&table[0],header.nVars*sizeof(RestartTableEntry),MPI_BYTE,MPI_STATUS_IGNORE);
+	if (header.nVars>0) MPI_Bcast(&table[0],header.nVars*sizeof(RestartTableEntry),MPI_BYTE,0,MPI_COMM_WORLD);
+	
+	MPI_File_close(&fh);
+	
+	return true;
+}
+
+bool RestartFile::has(string name,int components,bool keyed) {
+	
+	if (legacy) return false;
+	for (int v=0;v<table.size();++v) {
+		if (name==table[v].name) return (table[v].components==components && table[v].keyed==keyed);
+	}
+	return false;
+}
+
+void RestartFile::read(string name,int components,vector<double> &values) {
+	
+	vector<double> buffer;
+	int v=find(name);
+	if (table[v].components!=components || table[v].keyed) {
+		if (grid[gid].Rank==0) cerr << "[E] Variable " << name << " in restart file " << fileName << " doesn't have " << components << " components per cell" << endl;
+		MPI_Abort(MPI_COMM_WORLD,1);
+	}
+	read_data(v,buffer);
+	
+	values.resize(grid[gid].cellCount*components);
+	for (int i=0;i<order.size();++i) {
+		for (int j=0;j<components;++j) values[order[i]*components+j]=buffer[i*components+j];
+	}
+	
+	return;
+}
+
+bool RestartFile::read(string name,int components,vector<long long> &recordKeys,vector<double> &values) {
+	
+	int v=find(name);
+	if (table[v].components!=components || !table[v].keyed) {
+		if (grid[gid].Rank==0) cerr << "[E] Variable " << name << " in restart file " << fileName << " doesn't have " << components << " components per record" << endl;
+		MPI_Abort(MPI_COMM_WORLD,1);
+	}
+	
+	MPI_File fh;
+	MPI_File_open(MPI_COMM_WORLD,(char *)fileName.c_str(),MPI_MODE_RDONLY,MPI_INFO_NULL,&fh);
+	long long total;
+	MPI_File_read_at_all(fh,table[v].offset,&total,1,MPI_LONG_LONG,MPI_STATUS_IGNORE);
+	vector<long long> fileKeys (total);
+	vector<double> fileData (total*components);
+	long long dummyKey;
+	double dummy;
+	MPI_File_read_at_all(fh,table[v].offset+sizeof(long long),total>0 ? &fileKeys[0] : &dummyKey,total,MPI_LONG_LONG,MPI_STATUS_IGNORE);
+	MPI_File_read_at_all(fh,table[v].offset+(1+total)*sizeof(long long),total>0 ? &fileData[0] : &dummy,total*components,MPI_DOUBLE,MPI_STATUS_IGNORE);
+	MPI_File_close(&fh);
+	
+	// Look up the requested keys
+	vector<pair<long long,long long> > sorted (total);
+	for (long long r=0;r<total;++r) sorted[r]=make_pair(fileKeys[r],r);
+	sort(sorted.begin(),sorted.end());
+	bool found=true;
+	values.assign(recordKeys.size()*components,0.);
+	for (int r=0;r<recordKeys.size();++r) {
+		vector<pair<long long,long long> >::iterator it=lower_bound(sorted.begin(),sorted.end(),make_pair(recordKeys[r],(long long)(-1)));
+		if (it==sorted.end() || it->first!=recordKeys[r]) {
+			found=false;
+			continue;
+		}
+		for (int j=0;j<components;++j) values[r*components+j]=fileData[it->second*components+j];
+	}
+	int allFound=found;
+	MPI_Allreduce(MPI_IN_PLACE,&allFound,1,MPI_INT,MPI_MIN,MPI_COMM_WORLD);
+	
+	return allFound;
+}
+
+int RestartFile::find(string name) {
+	
+	for (int v=0;v<table.size();++v) if (name==table[v].name) return v;
+	if (grid[gid].Rank==0) cerr << "[E] Variable " << name << " couldn't be found in restart file " << fileName << endl;
+	MPI_Abort(MPI_COMM_WORLD,1);
+	return -1;
+}
+
+void RestartFile::read_data(int v,vector<double> &buffer) {
+	
+	buffer.resize(order.size()*table[v].components);
+	
+	MPI_File fh;
+	MPI_File_open(MPI_COMM_WORLD,(char *)fileName.c_str(),MPI_MODE_RDONLY,MPI_INFO_NULL,&fh);
+	MPI_Datatype file_type=cell_type(table[v].components);
+	MPI_File_set_view(fh,table[v].offset,MPI_DOUBLE,file_type,(char *)"native",MPI_INFO_NULL);
+	double dummy;
+	MPI_File_read_all(fh,buffer.empty() ? &dummy : &buffer[0],buffer.size(),MPI_DOUBLE,MPI_STATUS_IGNORE);
+	MPI_Type_free(&file_type);
+	MPI_File_close(&fh);
+	
+	return;
+}
+
+void RestartFile::read_legacy_header(int restart_step) {
+	
+	fstream file;
+	int Rank=grid[gid].Rank;
+	int np=grid[gid].np;
+	int globalCellCount=grid[gid].globalCellCount;
+	
+	// Rank 0 reads partitionMap and flattens it to the global ids in file order
+	vector<int> fileGlobalIds;
+	if (Rank==0) {
+		string mapFileName="./restart/partitionMap_"+int2str(gid+1)+".dat";
+		int nprocs,ncells,nnodes;
+		file.open(mapFileName.c_str(),ios::in);	
+		if (!file.is_open()) {
+			cerr << "[E] Restart file " << mapFileName  << " couldn't be opened" << endl;
+			MPI_Abort(MPI_COMM_WORLD,1);
+		}
+		file >> nprocs;
+		fileGlobalIds.reserve(globalCellCount);
+		for (int p=0;p<nprocs;++p) {
+			file >> nnodes;
+			file >> ncells;
+			for (int c=0;c<ncells;++c) {
+				int id;
+				file >> id;
+				fileGlobalIds.push_back(id);
+			}
+		}
+		file.close();
+		if (fileGlobalIds.size()!=globalCellCount) {
+			cerr << "[E] Restart file " << mapFileName << " has " << fileGlobalIds.size() << " cells while the grid has " << globalCellCount << endl;
+			MPI_Abort(MPI_COMM_WORLD,1);
+		}
+	}
+	
+	// Split the file into contiguous slices, one per rank
+	vector<int> sliceCounts (np),sliceDispls (np);
+	for (int p=0;p<np;++p) {
+		sliceCounts[p]=globalCellCount/np+((p<globalCellCount%np) ? 1 : 0);
+		sliceDispls[p]=(p==0) ? 0 : sliceDispls[p-1]+sliceCounts[p-1];
+	}
+	legacyStart=sliceDispls[Rank];
+	legacyCount=sliceCounts[Rank];
+	vector<int> sliceGlobalIds (legacyCount+1);
+	MPI_Scatterv(Rank==0 ? &fileGlobalIds[0] : NULL,&sliceCounts[0],&sliceDispls[0],MPI_INT,&sliceGlobalIds[0],legacyCount,MPI_INT,0,MPI_COMM_WORLD);
+	
+	// Group the slice by the owner ranks
+	legacySendCounts.assign(np,0);
+	for (int i=0;i<legacyCount;++i) legacySendCounts[grid[gid].maps.cellOwner[sliceGlobalIds[i]]]++;
+	legacySendDispls.assign(np,0);
+	for (int p=1;p<np;++p) legacySendDispls[p]=legacySendDispls[p-1]+legacySendCounts[p-1];
+	legacySendOrder.resize(legacyCount);
+	vector<int> counter (legacySendDispls);
+	vector<int> sendGlobalIds (legacyCount+1);
+	for (int i=0;i<legacyCount;++i) {
+		int owner=grid[gid].maps.cellOwner[sliceGlobalIds[i]];
+		legacySendOrder[counter[owner]]=i;
+		sendGlobalIds[counter[owner]]=sliceGlobalIds[i];
+		counter[owner]++;
+	}
+	
+	legacyRecvCounts.resize(np);
+	MPI_Alltoall(&legacySendCounts[0],1,MPI_INT,&legacyRecvCounts[0],1,MPI_INT,MPI_COMM_WORLD);
+	legacyRecvDispls.assign(np,0);
+	for (int p=1;p<np;++p) legacyRecvDispls[p]=legacyRecvDispls[p-1]+legacyRecvCounts[p-1];
+	vector<int> recvGlobalIds (order.size()+1);
+	MPI_Alltoallv(&sendGlobalIds[0],&legacySendCounts[0],&legacySendDispls[0],MPI_INT,&recvGlobalIds[0],&legacyRecvCounts[0],&legacyRecvDispls[0],MPI_INT,MPI_COMM_WORLD);
+	
+	// order is sorted by global id, so the position of a received cell is found with a binary search
+	vector<int> sortedGlobalIds (order.size());
+	for (int i=0;i<order.size();++i) sortedGlobalIds[i]=grid[gid].cell[order[i]].globalId;
+	legacyPosition.resize(order.size());
+	for (int i=0;i<order.size();++i) {
+		legacyPosition[i]=lower_bound(sortedGlobalIds.begin(),sortedGlobalIds.end(),recvGlobalIds[i])-sortedGlobalIds.begin();
+	}
+	
+	// Read time file
+	string timeFileName=legacyDir+"time.dat";
+	if (Rank==0) { 
+		file.open(timeFileName.c_str());
+		// Read physical time and residual normalization information
+		file >> header.time;
+		for (int i=0;i<6;++i) file >> header.first_residuals[i];
+		file.close();
+	}
+	MPI_Bcast(&header,sizeof(RestartHeader),MPI_BYTE,0,MPI_COMM_WORLD);
+	
+	return;
+}
+
+void RestartFile::read_legacy_data(string name,int components,vector<double> &buffer) {
+	
+	int np=grid[gid].np;
+	
+	// Collectively read this rank's slice of the file
+	vector<double> slice (legacyCount*components+1);
+	MPI_File fh;
+	if (MPI_File_open(MPI_COMM_WORLD,(char *)name.c_str(),MPI_MODE_RDONLY,MPI_INFO_NULL,&fh)!=MPI_SUCCESS) {
+		if (grid[gid].Rank==0) cerr << "[E] Restart file " << name << " couldn't be opened" << endl;
+		MPI_Abort(MPI_COMM_WORLD,1);
+	}
+	MPI_File_read_at_all(fh,legacyStart*components*sizeof(double),&slice[0],legacyCount*components,MPI_DOUBLE,MPI_STATUS_IGNORE);
+	MPI_File_close(&fh);
+	
+	// Send the cells to their owners
+	vector<double> sendBuffer (legacyCount*components+1);
+	for (int i=0;i<legacyCount;++i) {
+		for (int j=0;j<components;++j) sendBuffer[i*components+j]=slice[legacySendOrder[i]*components+j];
+	}
+	vector<int> sendCounts (np),sendDispls (np),recvCounts (np),recvDispls (np);
+	for (int p=0;p<np;++p) {
+		sendCounts[p]=legacySendCounts[p]*components;
+		sendDispls[p]=legacySendDispls[p]*components;
+		recvCounts[p]=legacyRecvCounts[p]*components;
+		recvDispls[p]=legacyRecvDispls[p]*components;
+	}
+	vector<double> recvBuffer (order.size()*components+1);
+	MPI_Alltoallv(&sendBuffer[0],&sendCounts[0],&sendDispls[0],MPI_DOUBLE,&recvBuffer[0],&recvCounts[0],&recvDispls[0],MPI_DOUBLE,MPI_COMM_WORLD);
+	
+	// Put them in ascending global id order
+	buffer.resize(order.size()*components);
+	for (int i=0;i<order.size();++i) {
+		for (int j=0;j<components;++j) buffer[legacyPosition[i]*components+j]=recvBuffer[i*components+j];
+	}
+	
+	return;
+}
@@ -0,0 +1,152 @@
+/************************************************************************
+	
+	Copyright 2007-2010 Emre Sozer
+
+	Contact: emresozer@freecfd.com
+
+	This file is a part of Free CFD
+
+	Free CFD is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    Free CFD is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    For a copy of the GNU General Public License,
+    see <http://www.gnu.org/licenses/>.
+
+*************************************************************************/
+#ifndef RESTART_FILE_H
+#define RESTART_FILE_H
+
+#include <mpi.h>
+#include <string>
+#include <vector>
+#include <cstring>
+using namespace std;
+
+#include "grid.h"
+#include "variable.h"
+
+#define RESTART_FILE_VERSION 1
+#define RESTART_NAME_LENGTH 16
+
+extern vector<Grid> grid;
+
+// Restart files hold all the variables of all the solvers of a grid in a single binary file
+// File layout:
+//   RestartHeader
+//   RestartTableEntry for each variable
+//   Data of each variable, ordered by global cell id
+// Each rank writes and reads its own cells directly at their global positions with collective MPI-IO
+// Keyed entries hold data that doesn't belong to cells, such as boundary face values:
+//   Record count (long long), the keys of the records (long long) and their data
+// Every rank reads a keyed entry whole, so they are meant for small data
+
+struct RestartHeader {
+	char magic[8]; // "FCFDRST"
+	int version;
+	int globalCellCount;
+	int nVars;
+	int pad;
+	double time;
+	double first_residuals[6]; // Navier-Stokes (3), RANS (2) and heat conduction (1) residual normalizations
+};
+
+struct RestartTableEntry {
+	char name[RESTART_NAME_LENGTH];
+	int components; // Number of doubles per cell or per record
+	int keyed; // 1 for keyed entries, 0 for cell data
+	long long offset; // Byte offset of the data in the file
+};
+
+class RestartFile {
+public:
+	int gid;
+	bool legacy; // Reading from the older one file per variable format
+	string legacyDir;
+	// Only needed for the legacy format
+	// Each rank reads a contiguous slice of the file and sends the cells to their owners
+	long long legacyStart; // Position of the first cell of the slice in the file
+	int legacyCount; // Number of cells in the slice
+	vector<int> legacySendOrder; // Slice positions grouped by the owner rank
+	vector<int> legacySendCounts,legacySendDispls,legacyRecvCounts,legacyRecvDispls;
+	vector<int> legacyPosition; // Position in order of each received cell
+	RestartHeader header;
+	vector<RestartTableEntry> table;
+	vector<vector<double> > data; // Local data of each variable to be written, in ascending global id order
+	vector<vector<long long> > keys; // Local keys of each keyed entry to be written
+	vector<long long> keyedStart,keyedTotal; // Position of the first local record and the total record count
+	vector<int> order; // Local cell indices sorted in ascending global id
+	
+	RestartFile(int gid);
+	// Writing
+	template <class TYPE> void add(string name,Variable<TYPE> &var);
+	void add(string name,int components,vector<double> &values); // values of local cell c at [c*components]
+	void add(string name,int components,vector<long long> &recordKeys,vector<double> &values); // Keyed, collective
+	void write(string fileName);
+	// Reading
+	bool open(int restart_step);
+	bool has(string name,int components,bool keyed);
+	template <class TYPE> void read(string name,Variable<TYPE> &var);
+	void read(string name,int components,vector<double> &values);
+	bool read(string name,int components,vector<long long> &recordKeys,vector<double> &values); // false if any key is missing
+	
+private:
+	string fileName;
+	int new_entry(string name,int components,int keyed);
+	MPI_Datatype cell_type(int components);
+	int find(string name);
+	void read_data(int v,vector<double> &buffer);
+	void read_legacy_header(int restart_step);
+	void read_legacy_data(string name,int components,vector<double> &buffer);
+};
+
+// Copies between cell values and the flat buffers of the restart file
+inline void restart_pack(double &value,double *buffer) {buffer[0]=value;}
+inline void restart_pack(Vec3D &value,double *buffer) {for (int j=0;j<3;++j) buffer[j]=value[j];}
+inline void restart_unpack(const double *buffer,double &value) {value=buffer[0];}
+inline void restart_unpack(const double *buffer,Vec3D &value) {for (int j=0;j<3;++j) value[j]=buffer[j];}
+
+template <class TYPE>
+void RestartFile::add(string name,Variable<TYPE> &var) {
+	
+	int components=sizeof(TYPE)/sizeof(double);
+	vector<double> &buffer=data[new_entry(name,components,0)];
+	buffer.resize(grid[gid].cellCount*components);
+	for (int i=0;i<order.size();++i) {
+		restart_pack(var.cell(order[i]),&buffer[i*components]);
+	}
+	
+	return;
+}
+
+template <class TYPE>
+void RestartFile::read(string name,Variable<TYPE> &var) {
+	
+	int components=sizeof(TYPE)/sizeof(double);
+	vector<double> buffer;
+	
+	if (legacy) {
+		read_legacy_data(legacyDir+name+"."+int2str(gid+1),components,buffer);
+	} else {
+		int v=find(name);
+		if (table[v].components!=components) {
+			if (grid[gid].Rank==0) cerr << "[E] Variable " << name << " in restart file " << fileName << " has " << table[v].components << " components, expected " << components << endl;
+			MPI_Abort(MPI_COMM_WORLD,1);
+		}
+		read_data(v,buffer);
+	}
+	
+	for (int i=0;i<order.size();++i) {
+		restart_unpack(&buffer[i*components],var.cell(order[i]));
+	}
+	
+	return;
+}
+
+#endif
@@ -25,6 +25,7 @@
 #define VARIABLE
 
 #include "grid.h"
+#include "utilities.h"
 
 extern vector<Grid> grid;
 
@@ -36,9 +37,7 @@ public:
 	vector<vector<TYPE> > bcValue; // Stores the bc data if specified on a certain bc
 	vector<TYPE> cellData, faceData, nodeData;
 	bool cellStore, faceStore, nodeStore;
-	TYPE temp;
-	map<int,double>::iterator it;
-	set<int>::iterator sit;
+	vector<TYPE> temp; // Scratch space for on-demand evaluations, one per thread
 	// Function pointers
 	// Store addresses of functions to be used when data is requested
 	// Can be simple fetch from array if the variable is stored
@@ -74,8 +73,6 @@ public:
 	
 	vector<TYPE> cell_gradient (int c);
 	void mpi_update(void);
-	void dump_cell_data(string fileName);
-	void read_cell_data(string fileName,vector<vector<int> > &partitionMap);
 	
 };
 
@@ -83,6 +80,7 @@ public:
 template <class TYPE> 
 void Variable<TYPE>::allocate (int g) {
 	gid=g;
+	temp.resize(thread_count());
 	if (cellStore) {
 		cellData.resize(grid[gid].cell.size()); // Store in internal cells + inter-partition ghosts
 		get_cell=&Variable::cell_fetch;
@@ -138,12 +136,12 @@ TYPE &Variable<TYPE>::face_calculate (int f) {
 	}
 	// Run the face averaging map from the grid class
 	std::map<int,double>::iterator it;
-	temp=0.;
-	it=grid[gid].face[f].average.begin();
+	TYPE &value=temp[thread_id()];
+	value=0.;
 	for ( it=grid[gid].face[f].average.begin() ; it != grid[gid].face[f].average.end(); it++ ) {
-			temp+=(*it).second*(this->*get_cell)((*it).first);
+			value+=(*it).second*(this->*get_cell)((*it).first);
 	}
-	return temp;
+	return value;
 }
 
 template <class TYPE>
@@ -182,12 +180,13 @@ TYPE &Variable<TYPE>::node_calculate (int n) {
 //		return temp;
 //	}
 	// Run the node averaging map from the grid class
-	temp=0.;
-	it=grid[gid].node[n].average.begin();
+	std::map<int,double>::iterator it;
+	TYPE &value=temp[thread_id()];
+	value=0.;
 	for ( it=grid[gid].node[n].average.begin() ; it != grid[gid].node[n].average.end(); it++ ) {
-		temp+=(*it).second*(this->*get_cell)((*it).first);
+		value+=(*it).second*(this->*get_cell)((*it).first);
 	}
-	return temp;
+	return value;
 }
 
 template <class TYPE>
@@ -225,50 +224,5 @@ TYPE &Variable<TYPE>::bc (int b,int f) {
 	return bcValue[b][0];
 }
 
-template <class TYPE>
-void Variable<TYPE>::dump_cell_data(string fileName) {
-
-	ofstream file;
-	// Write variables
-	int size=sizeof(TYPE);
-	for (int p=0;p<grid[gid].np;++p) {
-		if (grid[gid].Rank==p) {
-			if (grid[gid].Rank==0) file.open(fileName.c_str(),ios::binary); 
-			else file.open(fileName.c_str(), ios::app | ios::binary);
-			
-			for (int c=0;c<grid[gid].cellCount;++c) file.write((char*) &cell(c),size);
-			file.close();
-		}
-		MPI_Barrier(MPI_COMM_WORLD);
-	}
-	return;
-}
-
-template <class TYPE>
-void Variable<TYPE>::read_cell_data(string fileName,vector<vector<int> > &partitionMap) {
-	
-	string data="";
-	TYPE dummy;
-	ifstream file;
-	file.open(fileName.c_str(),ios::in | ios::binary);
-
-	int id;
-	int size=sizeof(TYPE);
-	for (int p=0;p<partitionMap.size();++p) {
-		for (int c=0;c<partitionMap[p].size();++c) {
-			// Get local cell id
-			id=-1;
-			if (grid[gid].maps.cellGlobal2Local.find(partitionMap[p][c])!=grid[gid].maps.cellGlobal2Local.end()) {
-				id=grid[gid].maps.cellGlobal2Local[partitionMap[p][c]];
-			}
-			// If id is negative, that means the cell currently lies on another partition
-			if (id>=0) { file.read((char*) &cell(id),size); } else { file.read((char*) &dummy,size); }
-		}
-	}
-	file.close();
-
-	return;
-}
-
 #endif
 
@@ -32,6 +32,7 @@ using namespace std;
 #include "rans.h"
 #include "hc.h"
 #include "commons.h"
+#include "statistics.h"
 
 extern vector<Grid> grid;
 extern InputFile input;
@@ -41,60 +42,28 @@ extern vector<RANS> rans;
 extern vector<bool> turbulent;
 extern vector<Variable<double> > dt;
 extern vector<int> equations;
+extern vector<Statistics> statistics;
 
 void write_restart(int gid,int timeStep,double time) {
 
-	string fileName;
-	
 	// Create the restart folder
-	ofstream file;
 	mkdir("./restart",S_IRWXU);
 	string dirname="./restart/"+int2str(timeStep);
 	mkdir(dirname.c_str(),S_IRWXU);
-
-	// write partition map
-	for (int p=0;p<np;++p) {
-		if (Rank==p) {
-			fileName="./restart/partitionMap_"+int2str(gid+1)+".dat";
-			if (Rank==0) { 
-				file.open(fileName.c_str());
-				file << np << endl;
-			}
-			else { file.open(fileName.c_str(), ios::app); }
-			file << grid[gid].nodeCount << "\t" << grid[gid].cellCount << endl;
-			for (int c=0;c<grid[gid].cellCount;++c) file << grid[gid].cell[c].globalId << endl;
-			file.close();
-		}
-		MPI_Barrier(MPI_COMM_WORLD);
-	}
 	
-	// Write time file
-	fileName=dirname+"/time.dat";
-	if (Rank==0) { 
-		file.open(fileName.c_str());
-		// Write physical time
-		file << time << endl;
-		// Write residual normalization information
-		if (equations[gid]==NS) {
-			file << ns[gid].first_residuals[0] << "\t" << ns[gid].first_residuals[1] << "\t" << ns[gid].first_residuals[2] << endl;
-			if (turbulent[gid]) file << rans[gid].first_residuals[0] << "\t" << rans[gid].first_residuals[1] << endl;
-			else file << -1. << "\t" << -1. << endl;
-		} else {
-			file << -1. << "\t" << -1. << "\t" << -1. << endl;	
-			file << -1. << "\t" << -1. << endl;	
-		}
-		if (equations[gid]==HEAT) file << hc[gid].first_residual << endl;
-		else file << -1 << endl;
-		file.close();
-	}		
-	
-	string gs="."+int2str(gid+1);
-	dt[gid].dump_cell_data(dirname+"/dt"+gs);
+	// All the variables of this grid go to a single file
+	RestartFile restart(gid);
+	restart.header.time=time;
+	restart.add("dt",dt[gid]);
 	if (equations[gid]==NS) {
-		ns[gid].write_restart(timeStep);
-		if (turbulent[gid]) rans[gid].write_restart(timeStep);
+		ns[gid].write_restart(restart);
+		if (turbulent[gid]) rans[gid].write_restart(restart);
 	}
-	if (equations[gid]==HEAT) hc[gid].write_restart(timeStep);	
+	if (equations[gid]==HEAT) hc[gid].write_restart(restart);
+	statistics[gid].write_restart(restart);
+	restart.write(dirname+"/restart."+int2str(gid+1));
+	
+	return;
 }
 
 
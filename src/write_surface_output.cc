@@ -32,6 +32,9 @@ using namespace std;
 #include "rans.h"
 #include "hc.h"
 #include "commons.h"
+#include "async_output.h"
+#include "tecplot_binary.h"
+#include "statistics.h"
 
 extern vector<Grid> grid;
 extern InputFile input;
@@ -41,87 +44,312 @@ extern vector<RANS> rans;
 extern vector<Variable<double> > dt;
 extern vector<int> equations;
 extern vector<Loads> loads;
+extern AsyncOutput output_queue;
+extern vector<Statistics> statistics;
 
 namespace surface_output {
 	int timeStep,gid;
+	string prefix; // File names start with this
 	vector<string> varList;
 	vector<bool> var_is_vec3d;
 }
 using namespace surface_output;
 
-void write_surface_tec_header(int b);
-void write_surface_tec_nodes(int i);
-void write_surface_tec_var(int ov,int i,int b);
-void write_surface_tec_cells(int b);
+void get_face_var(int ov,int i,int b,vector<double> &data);
+bool face_var_is_vec3d(string name);
+void submit_surface_output(void);
+void take_surface_snapshot(vector<vector<vector<vector<double> > > > &values);
+void write_tec_values(ostream &file, vector<double> &data);
+
+// Tecplot surface output, one zone per boundary condition
+// The boundary face values are copied on the main thread at the output step
+class SurfaceTecplotJob : public SharedFileJob {
+public:
+	int gid,timeStep;
+	vector<string> varList;
+	vector<bool> var_is_vec3d;
+	vector<vector<vector<vector<double> > > > values; // [bc][variable][component][boundary face]
+	SurfaceTecplotJob();
+	void format(void);
+private:
+	void write_surface_tec_header(ostream &file,int b);
+	void write_surface_tec_nodes(ostream &file,int i);
+	void write_surface_tec_cells(ostream &file,int b);
+};
+
+// Binary Tecplot file with an FEQUADRILATERAL zone per boundary condition
+// The node coordinates are stored in the first zone and shared by the others
+class SurfaceTecplotBinaryJob : public TecplotBinaryJob {
+public:
+	int gid,timeStep;
+	vector<string> varList;
+	vector<vector<vector<vector<double> > > > values; // [bc][variable][component][boundary face]
+	SurfaceTecplotBinaryJob();
+	void format(void);
+};
 
 void write_surface_output(int gridid, int step) {
 	mkdir("./surface_output",S_IRWXU);
 	gid=gridid;
 	timeStep=step;
+	prefix="surface";
 	varList=input.section("grid",gid).subsection("writeoutput").get_stringList("surfacevariables");
+	submit_surface_output();
+	return;
+}
+
+// Time statistics go to files of their own, named statistics_<step>_<grid>
+void write_surface_statistics(int gridid, int step) {
+	mkdir("./surface_output",S_IRWXU);
+	gid=gridid;
+	timeStep=step;
+	prefix="statistics";
+	varList=statistics[gid].output_variables(true);
+	submit_surface_output();
+	return;
+}
+
+void submit_surface_output(void) {
 	var_is_vec3d.resize(varList.size());
-	int nVar=0;
 	for (int var=0; var<varList.size(); ++var) {
-		if (varList[var]!="null") nVar++;
-		var_is_vec3d[var]=false;
-		if (varList[var]=="V" || varList[var]=="tau") {
-			var_is_vec3d[var]=true;
-			nVar+=2;
-		}
+		var_is_vec3d[var]=face_var_is_vec3d(varList[var]);
 	}
 
 	string format=input.section("grid",gid).subsection("writeoutput").get_string("format");
 
 	if (format=="tecplot") {
+		output_queue.submit(new SurfaceTecplotJob);
+	} else if (format=="tecplotbinary") {
+		output_queue.submit(new SurfaceTecplotBinaryJob);
+	}	
+	return;
+}
+
+bool face_var_is_vec3d(string name) {
+	// Time statistics have the components of the sampled variable
+	size_t split=name.find('_');
+	if (split!=string::npos) {
+		string quantity=name.substr(0,split);
+		if (quantity=="mean" || quantity=="rms" || quantity=="min" || quantity=="max") name=name.substr(split+1);
+	}
+	return (name=="V" || name=="tau");
+}
+
+// Gets a boundary face variable by name, for users other than the surface output
+void get_face_var(int gridid,string name,int i,int b,vector<double> &data) {
+	gid=gridid;
+	varList.assign(1,name);
+	get_face_var(0,i,b,data);
+	return;
+}
+
+SurfaceTecplotJob::SurfaceTecplotJob() {
 	
-		for (int b=0;b<grid[gid].bcCount;++b) {
-			// Write tecplot output file
-			if (Rank==0) write_surface_tec_header(b);
-			
+	gid=surface_output::gid;
+	timeStep=surface_output::timeStep;
+	varList=surface_output::varList;
+	var_is_vec3d=surface_output::var_is_vec3d;
+	fileName="./surface_output/"+prefix+"_"+int2str(timeStep)+"_"+int2str(gid+1)+".dat";
+	if (Rank==0) {
+		string link_comm="ln -sf "+fileName+" ./"+prefix+"_latest_"+int2str(gid+1)+".dat";
+		system(link_comm.c_str());
+	}
+	
+	take_surface_snapshot(values);
+	
+	return;
+}
+
+void take_surface_snapshot(vector<vector<vector<vector<double> > > > &values) {
+	
+	values.resize(grid[gid].bcCount);
+	for (int b=0;b<grid[gid].bcCount;++b) {
+		values[b].resize(varList.size());
+		for (int ov=0;ov<varList.size();++ov) {
+			if (varList[ov]=="null") continue;
+			int nn=1;
+			if (var_is_vec3d[ov]) nn=3;
+			values[b][ov].resize(nn);
+			for (int i=0;i<nn;++i) {
+				values[b][ov][i].resize(grid[gid].boundaryFaces[b].size(),0.);
+				get_face_var(ov,i,b,values[b][ov][i]);
+			}
+		}
+	}
+	
+	return;
+}
+
+void SurfaceTecplotJob::format(void) {
+	
+	// Each block is a section so that the ranks' contributions are interleaved in the file
+	vector<ostringstream *> blocks;
+	for (int b=0;b<grid[gid].bcCount;++b) {
+		blocks.push_back(new ostringstream);
+		if (Rank==0) write_surface_tec_header(*blocks.back(),b);
+		
+		if (b==0) {
+			for (int i=0;i<3;++i) {
+				blocks.push_back(new ostringstream);
+				write_surface_tec_nodes(*blocks.back(),i);
+			}
+		}
+		
+		for (int ov=0;ov<varList.size();++ov) {
+			for (int i=0;i<values[b][ov].size();++i) {
+				blocks.push_back(new ostringstream);
+				write_tec_values(*blocks.back(),values[b][ov][i]);
+			}
+		}
+		
+		blocks.push_back(new ostringstream);
+		write_surface_tec_cells(*blocks.back(),b);
+	}
+	// The snapshot is not needed anymore
+	vector<vector<vector<vector<double> > > >().swap(values);
+	
+	sections.resize(blocks.size());
+	for (int s=0;s<blocks.size();++s) {
+		sections[s]=blocks[s]->str();
+		delete blocks[s];
+	}
+	
+	return;
+}
+
+SurfaceTecplotBinaryJob::SurfaceTecplotBinaryJob() {
+	
+	gid=surface_output::gid;
+	timeStep=surface_output::timeStep;
+	varList=surface_output::varList;
+	take_surface_snapshot(values);
+	
+	fileName="./surface_output/"+prefix+"_"+int2str(timeStep)+"_"+int2str(gid+1)+".plt";
+	if (Rank==0) {
+		string link_comm="ln -sf "+fileName+" ./"+prefix+"_latest_"+int2str(gid+1)+".plt";
+		system(link_comm.c_str());
+	}
+	
+	return;
+}
+
+void SurfaceTecplotBinaryJob::format(void) {
+	
+	int bcCount=grid[gid].bcCount;
+	
+	// Variable names, same on all ranks
+	vector<string> names;
+	names.push_back("x"); names.push_back("y"); names.push_back("z");
+	for (int ov=0;ov<varList.size();++ov) {
+		if (bcCount==0) break;
+		if (values[0][ov].size()==3) {
+			names.push_back(varList[ov]+"_x");
+			names.push_back(varList[ov]+"_y");
+			names.push_back(varList[ov]+"_z");
+		} else if (values[0][ov].size()==1) {
+			names.push_back(varList[ov]);
+		}
+	}
+	int nVars=names.size();
+	
+	// Ranges of the variables stored in each zone, the other zones don't store the coordinates
+	vector<vector<int> > ranges (bcCount);
+	for (int b=0;b<bcCount;++b) {
+		for (int var=((b==0) ? 0 : 3);var<nVars;++var) ranges[b].push_back(new_range());
+	}
+	
+	sections.push_back("");
+	if (Rank==0) {
+		string &block=sections.back();
+		// Header
+		block.append("#!TDV112");
+		put_int(block,1); // Byte order
+		put_int(block,0); // Full file type
+		put_string(block,"Surface_"+int2str(gid+1));
+		put_int(block,nVars);
+		for (int var=0;var<nVars;++var) put_string(block,names[var]);
+		// Zone headers
+		for (int b=0;b<bcCount;++b) {
+			put_float(block,TECPLOT_ZONE_MARKER);
+			put_string(block,"BC_"+int2str(b+1));
+			put_int(block,-1); // Parent zone
+			put_int(block,-1); // Strand id
+			put_double(block,0.); // Solution time
+			put_int(block,-1); // Not used
+			put_int(block,TECPLOT_FEQUADRILATERAL);
+			put_int(block,1); // Specify variable locations
+			for (int var=0;var<nVars;++var) put_int(block,(var<3) ? 0 : 1); // Nodes, then cell centered
+			put_int(block,0); // No raw face neighbors
+			put_int(block,0); // No user defined face neighbor connections
+			put_int(block,grid[gid].global_bc_nodeCount);
+			put_int(block,grid[gid].globalBoundaryFaceCount[b]);
+			for (int i=0;i<3;++i) put_int(block,0); // Cell dimensions, not used
+			put_int(block,0); // No auxiliary data
+		}
+		put_float(block,TECPLOT_EOH_MARKER);
+	}
+	
+	for (int b=0;b<bcCount;++b) {
+		// Zone data header
+		sections.push_back("");
+		if (Rank==0) {
+			string &block=sections.back();
+			put_float(block,TECPLOT_ZONE_MARKER);
+			for (int var=0;var<nVars;++var) put_int(block,TECPLOT_DOUBLE);
+			put_int(block,0); // No passive variables
 			if (b==0) {
-				for (int i=0;i<3;++i) {
-					for (int p=0;p<np;++p) {
-						if(Rank==p) write_surface_tec_nodes(i);
-						MPI_Barrier(MPI_COMM_WORLD);
-					}
-				}
+				put_int(block,0); // No variable sharing
+			} else {
+				put_int(block,1); // Coordinates are shared with the first zone
+				for (int var=0;var<nVars;++var) put_int(block,(var<3) ? 0 : -1);
 			}
-			
-			for (int ov=0;ov<varList.size();++ov) {
-				int nn=1;
-				if (var_is_vec3d[ov]) nn=3;
-				for (int i=0;i<nn;++i) {
-					for (int p=0;p<np;++p) {
-						if(Rank==p) write_surface_tec_var(ov,i,b);
-						MPI_Barrier(MPI_COMM_WORLD);
-					}
-					
+			put_int(block,-1); // No connectivity sharing
+			put_ranges(block,sections.size()-1,ranges[b]);
+		}
+		
+		int range=0;
+		if (b==0) {
+			for (int i=0;i<3;++i) {
+				vector<double> data;
+				for (int n=0;n<grid[gid].nodeCount;++n) {
+					// Note that some nodes are repeated in different partitions
+					if (grid[gid].node[n].bc_output_id>=grid[gid].node_bc_output_offset) data.push_back(grid[gid].node[n][i]);
 				}
+				sections.push_back("");
+				put_values(sections.back(),data,ranges[b][range++]);
 			}
-			
-			for (int p=0;p<np;++p) {
-				if(Rank==p) write_surface_tec_cells(b);
-				MPI_Barrier(MPI_COMM_WORLD);
+		}
+		
+		for (int ov=0;ov<varList.size();++ov) {
+			for (int i=0;i<values[b][ov].size();++i) {
+				sections.push_back("");
+				put_values(sections.back(),values[b][ov][i],ranges[b][range++]);
 			}
 		}
-	} 	
+		
+		// Connectivity, zero based, triangles repeat their last node
+		vector<int> connectivity;
+		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
+			int f=grid[gid].boundaryFaces[b][bf];
+			for (int fn=0;fn<3;++fn) connectivity.push_back(grid[gid].faceNode(f,fn).bc_output_id);
+			if (grid[gid].face[f].nodes.size()==4) connectivity.push_back(grid[gid].faceNode(f,3).bc_output_id);
+			else connectivity.push_back(grid[gid].faceNode(f,2).bc_output_id);
+		}
+		sections.push_back("");
+		put_ints(sections.back(),connectivity);
+	}
+	// The snapshot is not needed anymore
+	vector<vector<vector<vector<double> > > >().swap(values);
+	
 	return;
 }
 
-void write_surface_tec_header(int b) {
+void SurfaceTecplotJob::write_surface_tec_header(ostream &file,int b) {
 	
-	ofstream file;
-	string fileName="./surface_output/surface_"+int2str(timeStep)+"_"+int2str(gid+1)+".dat";
-	string link_comm="ln -sf "+fileName+" ./surface_latest_"+int2str(gid+1)+".dat";
-	system(link_comm.c_str());
-	
-	// Proc 0 creates the output file and writes variable list
+	// Proc 0 writes variable list
 	int nvars=3;
 
-	if (b==0) {
-		file.open((fileName).c_str(),ios::out);
-		file << "VARIABLES = \"x\", \"y\", \"z\" ";
-	}
+	if (b==0) file << "VARIABLES = \"x\", \"y\", \"z\" ";
 	
 	for (int var=0;var<varList.size();++var) {
 		if (var_is_vec3d[var]) {
@@ -136,10 +364,7 @@ void write_surface_tec_header(int b) {
 			nvars++;
 		}
 	}
-	file << endl;
-	
-
-	if (b!=0) file.open((fileName).c_str(),ios::app);
+	if (b==0) file << endl;
 	
 	file << "ZONE, T=\"BC_" << b+1 << "\", ZONETYPE=FEQUADRILATERAL, DATAPACKING=BLOCK" << endl;
 	if (b==0) file << "NODES=" << grid[gid].global_bc_nodeCount << ", ";
@@ -153,259 +378,167 @@ void write_surface_tec_header(int b) {
 	return;
 }
 	
-void write_surface_tec_nodes(int i) {
-	
-	ofstream file;
-	string fileName="./surface_output/surface_"+int2str(timeStep)+"_"+int2str(gid+1)+".dat";
+void SurfaceTecplotJob::write_surface_tec_nodes(ostream &file,int i) {
 	
-	file.open((fileName).c_str(),ios::app);
-	file << scientific << setprecision(8);
-	
-	int count=0;
+	vector<double> data;
 	for (int n=0;n<grid[gid].nodeCount;++n) {
 		// Note that some nodes are repeated in different partitions
-		if (grid[gid].node[n].bc_output_id>=grid[gid].node_bc_output_offset) {
-			// Write node coordinates
-			file << grid[gid].node[n][i];
-			count++;
-			if (count%10==0) file << "\n";
-			else file << "\t";
-		}
+		if (grid[gid].node[n].bc_output_id>=grid[gid].node_bc_output_offset) data.push_back(grid[gid].node[n][i]);
 	}
+	write_tec_values(file,data);
 	file << endl;
-	file.close();
 	
 	return;
 }
 			
 			
-void write_surface_tec_var(int ov,int i,int b) {
+void get_face_var(int ov,int i,int b,vector<double> &data) {
 
-	ofstream file;
-	string fileName="./surface_output/surface_"+int2str(timeStep)+"_"+int2str(gid+1)+".dat";
-	
-	file.open((fileName).c_str(),ios::app);
-	file << scientific << setprecision(8);
-	
+	if (statistics[gid].get_face_var(varList[ov],i,b,data)) return;
 	if (varList[ov]=="p") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			//int parent=grid[gid].face[grid[gid].boundaryFaces[b][bf]].parent;
-			//file << ns[gid].p.cell(parent); // DEBUG
-			file << ns[gid].p.face(grid[gid].boundaryFaces[b][bf]);
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=ns[gid].p.face(grid[gid].boundaryFaces[b][bf]);
 		}
 	} else if (varList[ov]=="T") {
 		if (equations[gid]==NS)	{
 			for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-				file << ns[gid].T.face(grid[gid].boundaryFaces[b][bf]);
-				if ((bf+1)%10==0) file << "\n";
-				else file << "\t";
+				data[bf]=ns[gid].T.face(grid[gid].boundaryFaces[b][bf]);
 			}
 		} else if (equations[gid]==HEAT) {
 			for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-				file << hc[gid].T.face(grid[gid].boundaryFaces[b][bf]);
-				if ((bf+1)%10==0) file << "\n";
-				else file << "\t";
+				data[bf]=hc[gid].T.face(grid[gid].boundaryFaces[b][bf]);
 			}
 		}
 	} else if (varList[ov]=="rho") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << ns[gid].rho.face(grid[gid].boundaryFaces[b][bf]);
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=ns[gid].rho.face(grid[gid].boundaryFaces[b][bf]);
 		}
 	} else if (varList[ov]=="dt") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << dt[gid].face(grid[gid].boundaryFaces[b][bf]);
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=dt[gid].face(grid[gid].boundaryFaces[b][bf]);
 		}
 	} else if (varList[ov]=="mu") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << ns[gid].material.viscosity(ns[gid].T.face(grid[gid].boundaryFaces[b][bf]));
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=ns[gid].material.viscosity(ns[gid].T.face(grid[gid].boundaryFaces[b][bf]));
 		}
 	} else if (varList[ov]=="lambda") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << ns[gid].material.therm_cond(ns[gid].T.face(grid[gid].boundaryFaces[b][bf]));
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=ns[gid].material.therm_cond(ns[gid].T.face(grid[gid].boundaryFaces[b][bf]));
 		}
 	} else if (varList[ov]=="Cp") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << ns[gid].material.Cp(ns[gid].T.face(grid[gid].boundaryFaces[b][bf]));
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=ns[gid].material.Cp(ns[gid].T.face(grid[gid].boundaryFaces[b][bf]));
 		}
 	} else if (varList[ov]=="resp") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << ns[gid].update[0].face(grid[gid].boundaryFaces[b][bf]);
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=ns[gid].update[0].face(grid[gid].boundaryFaces[b][bf]);
 		}
 	} else if (varList[ov]=="resT") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << ns[gid].update[4].face(grid[gid].boundaryFaces[b][bf]);
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=ns[gid].update[4].face(grid[gid].boundaryFaces[b][bf]);
 		}
 	} else if (varList[ov]=="limiterp") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << ns[gid].limiter[0].face(grid[gid].boundaryFaces[b][bf]);
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=ns[gid].limiter[0].face(grid[gid].boundaryFaces[b][bf]);
 		}
 	} else if (varList[ov]=="limiterT") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << ns[gid].limiter[4].face(grid[gid].boundaryFaces[b][bf]);
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=ns[gid].limiter[4].face(grid[gid].boundaryFaces[b][bf]);
 		}
 	} else if (varList[ov]=="mdot") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << ns[gid].mdot.face(grid[gid].boundaryFaces[b][bf]);
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=ns[gid].mdot.face(grid[gid].boundaryFaces[b][bf]);
 		}
 	} else if (varList[ov]=="qdot") {
 		if (equations[gid]==NS)	{
 			for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-				file << ns[gid].qdot.face(grid[gid].boundaryFaces[b][bf]);
-				if ((bf+1)%10==0) file << "\n";
-				else file << "\t";
+				data[bf]=ns[gid].qdot.face(grid[gid].boundaryFaces[b][bf]);
 			}
 		} else if (equations[gid]==HEAT) {
 			for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-				file << hc[gid].qdot.face(grid[gid].boundaryFaces[b][bf]);
-				if ((bf+1)%10==0) file << "\n";
-				else file << "\t";
+				data[bf]=hc[gid].qdot.face(grid[gid].boundaryFaces[b][bf]);
 			}
 		}
 	} else if (varList[ov]=="yplus") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << rans[gid].yplus.face(grid[gid].boundaryFaces[b][bf]);
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=rans[gid].yplus.face(grid[gid].boundaryFaces[b][bf]);
 		}
 	} else if (varList[ov]=="k") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << rans[gid].k.face(grid[gid].boundaryFaces[b][bf]);
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=rans[gid].k.face(grid[gid].boundaryFaces[b][bf]);
 		}
 	} else if (varList[ov]=="omega") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << rans[gid].omega.face(grid[gid].boundaryFaces[b][bf]);
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=rans[gid].omega.face(grid[gid].boundaryFaces[b][bf]);
 		}
 	} else if (varList[ov]=="mu_t") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << rans[gid].mu_t.face(grid[gid].boundaryFaces[b][bf]);
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=rans[gid].mu_t.face(grid[gid].boundaryFaces[b][bf]);
 		}
 	} else if (varList[ov]=="Mach") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << fabs(ns[gid].V.face(grid[gid].boundaryFaces[b][bf]))/ns[gid].material.a(ns[gid].p.face(grid[gid].boundaryFaces[b][bf]),ns[gid].T.face(grid[gid].boundaryFaces[b][bf]));
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=fabs(ns[gid].V.face(grid[gid].boundaryFaces[b][bf]))/ns[gid].material.a(ns[gid].p.face(grid[gid].boundaryFaces[b][bf]),ns[gid].T.face(grid[gid].boundaryFaces[b][bf]));
 		}
 	} else if (varList[ov]=="rank") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << Rank;
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=Rank;
 		}
 	} else if (varList[ov]=="V") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << ns[gid].V.face(grid[gid].boundaryFaces[b][bf])[i];
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=ns[gid].V.face(grid[gid].boundaryFaces[b][bf])[i];
 		}
 	} else if (varList[ov]=="gradp") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << ns[gid].gradp.face(grid[gid].boundaryFaces[b][bf])[i];
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=ns[gid].gradp.face(grid[gid].boundaryFaces[b][bf])[i];
 		}
 	} else if (varList[ov]=="gradu") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << ns[gid].gradu.face(grid[gid].boundaryFaces[b][bf])[i];
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=ns[gid].gradu.face(grid[gid].boundaryFaces[b][bf])[i];
 		}
 	} else if (varList[ov]=="gradv") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << ns[gid].gradv.face(grid[gid].boundaryFaces[b][bf])[i];
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=ns[gid].gradv.face(grid[gid].boundaryFaces[b][bf])[i];
 		}
 	} else if (varList[ov]=="gradw") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << ns[gid].gradw.face(grid[gid].boundaryFaces[b][bf])[i];
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=ns[gid].gradw.face(grid[gid].boundaryFaces[b][bf])[i];
 		}
 	} else if (varList[ov]=="gradT") {
 		if (equations[gid]==NS) {
 			for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-				file << ns[gid].gradT.face(grid[gid].boundaryFaces[b][bf])[i];
-				if ((bf+1)%10==0) file << "\n";
-				else file << "\t";
+				data[bf]=ns[gid].gradT.face(grid[gid].boundaryFaces[b][bf])[i];
 			}
 		} else if (equations[gid]==HEAT) {
 			for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-				file << hc[gid].gradT.face(grid[gid].boundaryFaces[b][bf])[i];
-				if ((bf+1)%10==0) file << "\n";
-				else file << "\t";
+				data[bf]=hc[gid].gradT.face(grid[gid].boundaryFaces[b][bf])[i];
 			}
 		}
 	} else if (varList[ov]=="resV") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << ns[gid].update[i+1].face(grid[gid].boundaryFaces[b][bf]);
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=ns[gid].update[i+1].face(grid[gid].boundaryFaces[b][bf]);
 		}
 	} else if (varList[ov]=="limiterV") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << ns[gid].limiter[i+1].face(grid[gid].boundaryFaces[b][bf]);
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=ns[gid].limiter[i+1].face(grid[gid].boundaryFaces[b][bf]);
 		}
 	} else if (varList[ov]=="gradk") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << rans[gid].gradk.face(grid[gid].boundaryFaces[b][bf])[i];
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=rans[gid].gradk.face(grid[gid].boundaryFaces[b][bf])[i];
 		}
 	} else if (varList[ov]=="gradomega") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << rans[gid].gradomega.face(grid[gid].boundaryFaces[b][bf])[i];
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=rans[gid].gradomega.face(grid[gid].boundaryFaces[b][bf])[i];
 		}
 	} else if (varList[ov]=="tau") {
 		for (int bf=0;bf<grid[gid].boundaryFaces[b].size();++bf) {
-			file << ns[gid].tau.face(grid[gid].boundaryFaces[b][bf])[i];
-			if ((bf+1)%10==0) file << "\n";
-			else file << "\t";
+			data[bf]=ns[gid].tau.face(grid[gid].boundaryFaces[b][bf])[i];
 		}
 	}
 	
-	file.close();
-		
 	return;
-} 
+}
 			
-void write_surface_tec_cells(int b) {
-	
-	ofstream file;
-	string fileName="./surface_output/surface_"+int2str(timeStep)+"_"+int2str(gid+1)+".dat";
-	
-	file.open((fileName).c_str(),ios::app);
+void SurfaceTecplotJob::write_surface_tec_cells(ostream &file,int b) {
 	
 	// Transform this logic: map node indices to this output node list
 	
@@ -426,8 +559,6 @@ void write_surface_tec_cells(int b) {
 		file << endl;
 	}
 	
-	file.close();
-	
 	return;
 	
 }
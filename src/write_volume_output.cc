@@ -23,6 +23,7 @@
 #include <iostream>
 #include <fstream>
 #include <iomanip>
+#include <algorithm>
 using namespace std;
 
 #include "utilities.h"
@@ -33,6 +34,16 @@ using namespace std;
 #include "rans.h"
 #include "hc.h"
 #include "commons.h"
+#include "async_output.h"
+#include "tecplot_binary.h"
+#include "statistics.h"
+#include "cmake_vars.h"
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_PCGNS
+#include <pcgnslib.h>
+#endif
 
 extern vector<Grid> grid;
 extern InputFile input;
@@ -42,25 +53,172 @@ extern vector<RANS> rans;
 extern vector<Variable<double> > dt;
 extern vector<int> equations;
 extern vector<Loads> loads;
+extern AsyncOutput output_queue;
+extern vector<Statistics> statistics;
 
 namespace volume_output {
 	int timeStep,gid;
+	string prefix; // File names start with this
 	vector<string> varList;
 	vector<bool> var_is_vec3d;
 }
 using namespace volume_output;
 		
-void write_tec_header(void);
-void write_tec_nodes(int i);
-void write_tec_var(int ov, int i);
-void write_tec_face_node_counts(void);
-void write_tec_face_nodes(void);
-void write_tec_left(void);
-void write_tec_right(void);
-void write_vtk(void);
-void write_vtk_parallel(void);
-void write_vtk_legacy(void);
-void write_visit_parallel(void);
+void get_cell_var(int ov, int i, vector<double> &data);
+bool cell_var_is_vec3d(string name);
+void submit_volume_output(void);
+void write_tec_values(ostream &file, vector<double> &data);
+
+// Copy of the requested cell variables, taken on the main thread at the output step
+// The output jobs only read from this and the grid, so they can run alongside the solver
+class VolumeSnapshot {
+public:
+	int gid,timeStep;
+	string prefix;
+	vector<string> varList;
+	vector<bool> var_is_vec3d;
+	vector<vector<vector<double> > > values; // [variable][component][cell]
+	void take(void);
+	string name(void) { return prefix+"_"+int2str(timeStep)+"_"+int2str(gid+1); }
+	// Folder of the files written by each rank, within ./volume_output
+	string directory(void) { return (prefix=="volume" ? "" : prefix+"_")+int2str(timeStep); }
+};
+
+void VolumeSnapshot::take(void) {
+	gid=volume_output::gid;
+	timeStep=volume_output::timeStep;
+	prefix=volume_output::prefix;
+	varList=volume_output::varList;
+	var_is_vec3d=volume_output::var_is_vec3d;
+	values.resize(varList.size());
+	for (int ov=0;ov<varList.size();++ov) {
+		if (varList[ov]=="null") continue;
+		int nn=1;
+		if (var_is_vec3d[ov]) nn=3;
+		values[ov].resize(nn);
+		for (int i=0;i<nn;++i) {
+			values[ov][i].resize(grid[gid].cellCount,0.);
+			get_cell_var(ov,i,values[ov][i]);
+		}
+	}
+	return;
+}
+
+class VolumeTecplotJob : public SharedFileJob {
+public:
+	VolumeSnapshot snapshot;
+	VolumeTecplotJob();
+	void format(void);
+private:
+	void write_tec_header(ostream &file);
+	void write_tec_nodes(ostream &file, int i);
+	void write_tec_face_node_counts(ostream &file);
+	void write_tec_face_nodes(ostream &file);
+	void write_tec_left(ostream &file);
+	void write_tec_right(ostream &file);
+};
+
+// Binary Tecplot file with a single FEPOLYHEDRON zone, double precision data
+class VolumeTecplotBinaryJob : public TecplotBinaryJob {
+public:
+	VolumeSnapshot snapshot;
+	int faceNodeOffset; // Number of face nodes written by the lower ranks
+	VolumeTecplotBinaryJob();
+	void format(void);
+private:
+	bool write_face(int f);
+};
+
+#ifdef HAVE_PCGNS
+// Parallel CGNS output
+// The grid goes to ./volume_output/grid_<grid>.cgns once per run
+// Each snapshot only holds a FlowSolution and links to the grid file
+// Cells are written in one section per element type, each rank writing a contiguous range of each
+class CGNSLayout {
+public:
+	bool gridWritten;
+	vector<ElementType_t> types;
+	vector<string> sectionNames;
+	vector<cgsize_t> sectionStart; // First element id of each section
+	vector<cgsize_t> sectionEnd; // Last element id of each section
+	vector<cgsize_t> rankStart; // First element id of this rank in each section
+	vector<vector<int> > localCells; // Local cells of each section
+	vector<vector<cgsize_t> > connectivity; // Local connectivity of each section, only kept until the grid is written
+	cgsize_t cellTotal; // Number of elements in all sections
+	CGNSLayout();
+	void set(int gid);
+	void write_grid(int gid);
+private:
+	bool element(int gid,int c,int &t,vector<int> &nodes);
+};
+
+vector<CGNSLayout> cgns_layout;
+
+class VolumeCGNSJob : public OutputJob {
+public:
+	VolumeSnapshot snapshot;
+	vector<vector<vector<double> > > sectionValues; // [variable component][section][cell]
+	vector<string> names;
+	VolumeCGNSJob();
+	void format(void);
+	void commit(void);
+};
+#endif
+
+// Binary VTU files keep all the arrays in raw form after the XML part
+// Each array is preceded by its size, or by a block table if compressed
+class AppendedData {
+public:
+	bool compress;
+	string data;
+	AppendedData();
+	template <class TYPE> void append(vector<TYPE> &values);
+private:
+	void append_bytes(const char *bytes,unsigned long long size);
+};
+
+class VolumeVTKJob : public OutputJob {
+public:
+	VolumeSnapshot snapshot;
+	string filePath,fileName,parallelFileName;
+	string data,parallelData;
+	bool binary; // Raw appended binary data instead of ascii
+	bool compress; // zlib compression of the binary data
+	bool coordinates64; // Double precision node coordinates
+	vector<bool> var_is_float64; // Double precision cell variables
+	AppendedData appended;
+	VolumeVTKJob();
+	void format(void);
+	void write(void);
+private:
+	void write_vtk(ostream &file);
+	void write_vtu_binary(ostream &file);
+	void write_vtk_parallel(ostream &file);
+	string float_type(bool float64);
+};
+
+class VolumeVTKLegacyJob : public OutputJob {
+public:
+	VolumeSnapshot snapshot;
+	string filePath,fileName,visitFileName;
+	string data,visitData;
+	VolumeVTKLegacyJob();
+	void format(void);
+	void write(void);
+private:
+	void write_vtk_legacy(ostream &file);
+	void write_visit_parallel(ostream &file);
+};
+
+void write_string(string fileName,string &data) {
+	ofstream file;
+	file.open((fileName).c_str(),ios::out);
+	file << data;
+	file.close();
+	// Release the memory right away
+	string().swap(data);
+	return;
+}
 
 void write_loads(int gid,int step,double time) {
 	ofstream file;
@@ -88,86 +246,123 @@ void write_volume_output(int gridid, int step) {
 	mkdir("./volume_output",S_IRWXU);
 	gid=gridid;
 	timeStep=step;
+	prefix="volume";
 	varList=input.section("grid",gid).subsection("writeoutput").get_stringList("volumevariables");
+	submit_volume_output();
+	return;
+}
+
+// Time statistics go to files of their own, named statistics_<step>_<grid>
+void write_volume_statistics(int gridid, int step) {
+	mkdir("./volume_output",S_IRWXU);
+	gid=gridid;
+	timeStep=step;
+	prefix="statistics";
+	varList=statistics[gid].output_variables(false);
+	submit_volume_output();
+	return;
+}
+
+void submit_volume_output(void) {
 	var_is_vec3d.resize(varList.size());
-	int nVar=0;
 	for (int var=0; var<varList.size(); ++var) {
-		if (varList[var]!="null") nVar++;
-		var_is_vec3d[var]=false;
-		if (varList[var]=="V" || varList[var].substr(0,4)=="grad" || varList[var]=="resV" || varList[var]=="limiterV") {
-			var_is_vec3d[var]=true;
-			nVar+=2;
-		}
+		var_is_vec3d[var]=cell_var_is_vec3d(varList[var]);
 	}
 	
 	string format=input.section("grid",gid).subsection("writeoutput").get_string("format");
 	if (format=="tecplot") {
 		// Write tecplot output file		
-		if (Rank==0) write_tec_header();
-		for (int i=0;i<3;++i) {
-			for (int p=0;p<np;++p) {
-				if(Rank==p) write_tec_nodes(i);
-				MPI_Barrier(MPI_COMM_WORLD);
-			}
-		}
-		for (int ov=0;ov<varList.size();++ov) {
-			int nn=1;
-			if (var_is_vec3d[ov]) nn=3;
-			for (int i=0;i<nn;++i) {
-				for (int p=0;p<np;++p) {
-					if(Rank==p) write_tec_var(ov,i);
-					MPI_Barrier(MPI_COMM_WORLD);
-				}
-				
-			}
-		}
-		
-		for (int p=0;p<np;++p) {
-			if(Rank==p) write_tec_face_node_counts();
-			MPI_Barrier(MPI_COMM_WORLD);
-		}
-		 
-		for (int p=0;p<np;++p) {
-			if(Rank==p) write_tec_face_nodes();
-			MPI_Barrier(MPI_COMM_WORLD);
-		}
-
-		for (int p=0;p<np;++p) {
-			if(Rank==p) write_tec_left();
-			MPI_Barrier(MPI_COMM_WORLD);
-		}
-
-		for (int p=0;p<np;++p) {
-			if(Rank==p) write_tec_right();
-			MPI_Barrier(MPI_COMM_WORLD);
-		}
-
+		output_queue.submit(new VolumeTecplotJob);
+	} else if (format=="tecplotbinary") {
+		output_queue.submit(new VolumeTecplotBinaryJob);
+	} else if (format=="cgns") {
+#ifdef HAVE_PCGNS
+		output_queue.submit(new VolumeCGNSJob);
+#else
+		if (Rank==0) cerr << "[E] Built without parallel CGNS, cgns output format is not available" << endl;
+		MPI_Abort(MPI_COMM_WORLD,1);
+#endif
 	} else if (format=="vtk") {
 		// Write vtk output file
-		if (Rank==0) write_vtk_parallel();
-		MPI_Barrier(MPI_COMM_WORLD);
-		write_vtk();	
+		output_queue.submit(new VolumeVTKJob);
 	} else if (format=="vtklegacy") {
 		// Write vtk output file
-		if (Rank==0) write_visit_parallel();
-		MPI_Barrier(MPI_COMM_WORLD);
-		write_vtk_legacy();	
+		output_queue.submit(new VolumeVTKLegacyJob);
 	}
 
+	return;
+}
 
+bool cell_var_is_vec3d(string name) {
+	// Time statistics have the components of the sampled variable
+	size_t split=name.find('_');
+	if (split!=string::npos) {
+		string quantity=name.substr(0,split);
+		if (quantity=="mean" || quantity=="rms" || quantity=="min" || quantity=="max") name=name.substr(split+1);
+	}
+	return (name=="V" || name.substr(0,4)=="grad" || name=="resV" || name=="limiterV");
+}
+
+// Gets a cell variable by name, for users other than the volume output
+void get_cell_var(int gridid,string name,int i,vector<double> &data) {
+	gid=gridid;
+	varList.assign(1,name);
+	get_cell_var(0,i,data);
 	return;
 }
 
-void write_tec_header(void) {
+VolumeTecplotJob::VolumeTecplotJob() {
+	snapshot.take();
+	fileName="./volume_output/"+snapshot.name()+".dat";
+	if (Rank==0) {
+		string link_comm="ln -sf "+fileName+" ./"+snapshot.prefix+"_latest_"+int2str(snapshot.gid+1)+".dat";
+		system(link_comm.c_str());
+	}
+}
+
+void VolumeTecplotJob::format(void) {
 	
-	ofstream file;
-	string fileName="./volume_output/volume_"+int2str(timeStep)+"_"+int2str(gid+1)+".dat";
-	string link_comm="ln -sf "+fileName+" ./volume_latest_"+int2str(gid+1)+".dat";
-	system(link_comm.c_str());
+	// Each block is a section so that the ranks' contributions are interleaved in the file
+	vector<ostringstream *> blocks;
+	blocks.push_back(new ostringstream);
+	if (Rank==0) write_tec_header(*blocks.back());
+	for (int i=0;i<3;++i) {
+		blocks.push_back(new ostringstream);
+		write_tec_nodes(*blocks.back(),i);
+	}
+	for (int ov=0;ov<snapshot.varList.size();++ov) {
+		for (int i=0;i<snapshot.values[ov].size();++i) {
+			blocks.push_back(new ostringstream);
+			write_tec_values(*blocks.back(),snapshot.values[ov][i]);
+		}
+	}
+	// The snapshot is not needed anymore
+	vector<vector<vector<double> > >().swap(snapshot.values);
+	blocks.push_back(new ostringstream);
+	write_tec_face_node_counts(*blocks.back());
+	blocks.push_back(new ostringstream);
+	write_tec_face_nodes(*blocks.back());
+	blocks.push_back(new ostringstream);
+	write_tec_left(*blocks.back());
+	blocks.push_back(new ostringstream);
+	write_tec_right(*blocks.back());
 	
-	// Proc 0 creates the output file and writes variable list
+	sections.resize(blocks.size());
+	for (int s=0;s<blocks.size();++s) {
+		sections[s]=blocks[s]->str();
+		delete blocks[s];
+	}
 	
-	file.open((fileName).c_str(),ios::out);
+	return;
+}
+
+void VolumeTecplotJob::write_tec_header(ostream &file) {
+	
+	int gid=snapshot.gid;
+	vector<string> &varList=snapshot.varList;
+	vector<bool> &var_is_vec3d=snapshot.var_is_vec3d;
+	
+	// Proc 0 writes variable list
 	file << "VARIABLES = \"x\", \"y\", \"z\" ";
 	int nvars=3;
 	for (int var=0;var<varList.size();++var) {
@@ -198,259 +393,204 @@ void write_tec_header(void) {
 	return;
 }
 	
-void write_tec_nodes(int i) {
+void VolumeTecplotJob::write_tec_nodes(ostream &file, int i) {
 	
-	ofstream file;
-	string fileName="./volume_output/volume_"+int2str(timeStep)+"_"+int2str(gid+1)+".dat";
-	
-	file.open((fileName).c_str(),ios::app);
-	file << scientific << setprecision(8);
-
-	int count=0;
+	int gid=snapshot.gid;
+	vector<double> data;
+	data.reserve(grid[gid].nodeCount);
 	for (int n=0;n<grid[gid].nodeCount;++n) {
 		// Note that some nodes are repeated in different partitions
-		if (grid[gid].node[n].output_id>=grid[gid].node_output_offset) {
-			// Write node coordinates
-			file << grid[gid].node[n][i];
-			count++;
-			if (count%10==0) file << "\n";
-			else file << "\t";
-		}
+		if (grid[gid].node[n].output_id>=grid[gid].node_output_offset) data.push_back(grid[gid].node[n][i]);
 	}
+	
+	write_tec_values(file,data);
 	file << endl;
-	file.close();
 	
 	return;
 }
 			
 			
-void write_tec_var(int ov, int i) {
-
-	ofstream file;
-	string fileName="./volume_output/volume_"+int2str(timeStep)+"_"+int2str(gid+1)+".dat";
+// Formatting the numbers is the expensive part of the ASCII output
+// Each thread formats a contiguous chunk of the data, chunks are then written in order
+// This produces exactly the same file as a serial write, 10 values per line
+void write_tec_values(ostream &file, vector<double> &data) {
+	
+	// The region may get fewer threads than requested, chunks are sized by the actual team
+	// Slots of threads that didn't start stay empty
+	int nThreads=thread_count();
+	vector<string> chunks (nThreads);
 	
-	file.open((fileName).c_str(),ios::app);
-	file << scientific << setprecision(8);
+	#pragma omp parallel
+	{
+	int t=thread_id();
+	int chunk_size=data.size()/team_size()+1;
+	int begin=min(int(data.size()),t*chunk_size);
+	int end=min(int(data.size()),begin+chunk_size);
+	ostringstream chunk;
+	chunk << scientific << setprecision(8);
+	for (int c=begin;c<end;++c) {
+		chunk << data[c];
+		if ((c+1)%10==0) chunk << "\n";
+		else chunk << "\t";
+	}
+	chunks[t]=chunk.str();
+	}
 	
+	for (int t=0;t<nThreads;++t) file << chunks[t];
+	
+	return;
+}
+
+void get_cell_var(int ov, int i, vector<double> &data) {
+	
+	if (statistics[gid].get_cell_var(varList[ov],i,data)) return;
 	if (varList[ov]=="p") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << ns[gid].p.cell(c);
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=ns[gid].p.cell(c);
 		}
 	} else if (varList[ov]=="T") {
 		if (equations[gid]==NS)	{
 			for (int c=0;c<grid[gid].cellCount;++c) {
-				file << ns[gid].T.cell(c);
-				if ((c+1)%10==0) file << "\n";
-				else file << "\t";
+				data[c]=ns[gid].T.cell(c);
 			}
 		} else if (equations[gid]==HEAT) {
 			for (int c=0;c<grid[gid].cellCount;++c) {
-				file << hc[gid].T.cell(c);
-				if ((c+1)%10==0) file << "\n";
-				else file << "\t";
+				data[c]=hc[gid].T.cell(c);
 			}
 		}
 	} else if (varList[ov]=="rho") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << ns[gid].rho.cell(c);
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=ns[gid].rho.cell(c);
 		}
 	} else if (varList[ov]=="dt") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << dt[gid].cell(c);
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=dt[gid].cell(c);
 		}
 	} else if (varList[ov]=="mu") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << ns[gid].material.viscosity(ns[gid].T.cell(c));
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=ns[gid].material.viscosity(ns[gid].T.cell(c));
 		}
 	} else if (varList[ov]=="lambda") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << ns[gid].material.therm_cond(ns[gid].T.cell(c));
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=ns[gid].material.therm_cond(ns[gid].T.cell(c));
 		}
 	} else if (varList[ov]=="Cp") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << ns[gid].material.Cp(ns[gid].T.cell(c));
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=ns[gid].material.Cp(ns[gid].T.cell(c));
 		}
 	} else if (varList[ov]=="resp") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << ns[gid].update[0].cell(c);
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=ns[gid].update[0].cell(c);
 		}
 	} else if (varList[ov]=="resT") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << ns[gid].update[4].cell(c);
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=ns[gid].update[4].cell(c);
 		}
 	} else if (varList[ov]=="limiterp") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << ns[gid].limiter[0].cell(c);
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=ns[gid].limiter[0].cell(c);
 		}
 	} else if (varList[ov]=="limiterT") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << ns[gid].limiter[4].cell(c);
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=ns[gid].limiter[4].cell(c);
 		}
 	} else if (varList[ov]=="k") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << rans[gid].k.cell(c);
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=rans[gid].k.cell(c);
 		}
 	} else if (varList[ov]=="omega") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << rans[gid].omega.cell(c);
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=rans[gid].omega.cell(c);
 		}
 	} else if (varList[ov]=="mu_t") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << rans[gid].mu_t.cell(c);
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=rans[gid].mu_t.cell(c);
 		}
 	} else if (varList[ov]=="Mach") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << fabs(ns[gid].V.cell(c))/ns[gid].material.a(ns[gid].p.cell(c),ns[gid].T.cell(c));
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=fabs(ns[gid].V.cell(c))/ns[gid].material.a(ns[gid].p.cell(c),ns[gid].T.cell(c));
 		}
 	} else if (varList[ov]=="rank") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << Rank;
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=Rank;
 		}
 	} else if (varList[ov]=="volume") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << grid[gid].cell[c].volume;
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=grid[gid].cell[c].volume;
 		}
 	} else if (varList[ov]=="percent_grad_error") {
 		if (gradient_test==LINEAR) {
 			for (int c=0;c<grid[gid].cellCount;++c) {
-				file << (ns[gid].gradp.cell(c)[0]-1.)*100.;
-				if ((c+1)%10==0) file << "\n";
-				else file << "\t";
+				data[c]=(ns[gid].gradp.cell(c)[0]-1.)*100.;
 			}
 		} else if (gradient_test==QUADRATIC) {
  			for (int c=0;c<grid[gid].cellCount;++c) {
-				file << (ns[gid].gradp.cell(c)[0]-(2.*grid[gid].cell[c].centroid[0]+3.*(max_x-min_x)))*100.;
-				if ((c+1)%10==0) file << "\n";
-				else file << "\t";
+				data[c]=(ns[gid].gradp.cell(c)[0]-(2.*grid[gid].cell[c].centroid[0]+3.*(max_x-min_x)))*100.;
 			}
 		}
 	} else if (varList[ov]=="V") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << ns[gid].V.cell(c)[i];
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=ns[gid].V.cell(c)[i];
 		}
 	} else if (varList[ov]=="gradp") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << ns[gid].gradp.cell(c)[i];
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=ns[gid].gradp.cell(c)[i];
 		}
 	} else if (varList[ov]=="gradu") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << ns[gid].gradu.cell(c)[i];
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=ns[gid].gradu.cell(c)[i];
 		}
 	} else if (varList[ov]=="gradv") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << ns[gid].gradv.cell(c)[i];
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=ns[gid].gradv.cell(c)[i];
 		}
 	} else if (varList[ov]=="gradw") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << ns[gid].gradw.cell(c)[i];
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=ns[gid].gradw.cell(c)[i];
 		}
 	} else if (varList[ov]=="gradT") {
 		if (equations[gid]==NS) {
 			for (int c=0;c<grid[gid].cellCount;++c) {
-				file << ns[gid].gradT.cell(c)[i];
-				if ((c+1)%10==0) file << "\n";
-				else file << "\t";
+				data[c]=ns[gid].gradT.cell(c)[i];
 			}
 		} else if (equations[gid]==HEAT) {
 			for (int c=0;c<grid[gid].cellCount;++c) {
-				file << hc[gid].gradT.cell(c)[i];
-				if ((c+1)%10==0) file << "\n";
-				else file << "\t";
+				data[c]=hc[gid].gradT.cell(c)[i];
 			}
 		}
 	} else if (varList[ov]=="gradrho") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << ns[gid].rho.cell_gradient(c)[i];
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=ns[gid].rho.cell_gradient(c)[i];
 		}
 	} else if (varList[ov]=="resV") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << ns[gid].update[i+1].cell(c);
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=ns[gid].update[i+1].cell(c);
 		}
 	} else if (varList[ov]=="limiterV") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << ns[gid].limiter[i+1].cell(c);
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=ns[gid].limiter[i+1].cell(c);
 		}
 	} else if (varList[ov]=="gradk") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << rans[gid].gradk.cell(c)[i];
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=rans[gid].gradk.cell(c)[i];
 		}
 	} else if (varList[ov]=="gradomega") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << rans[gid].gradomega.cell(c)[i];
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=rans[gid].gradomega.cell(c)[i];
 		}
 	} else if (varList[ov]=="grad") {
 		for (int c=0;c<grid[gid].cellCount;++c) {
-			file << ns[gid].gradp.cell(c)[i];
-			if ((c+1)%10==0) file << "\n";
-			else file << "\t";
+			data[c]=ns[gid].gradp.cell(c)[i];
 		}
 	}
-	
-	file.close();
 		
 	return;
-} 
-
-void write_tec_face_node_counts () {
+}
 
-	ofstream file;
-	string fileName="./volume_output/volume_"+int2str(timeStep)+"_"+int2str(gid+1)+".dat";
-	file.open((fileName).c_str(),ios::app);
+void VolumeTecplotJob::write_tec_face_node_counts(ostream &file) {
 
+	int gid=snapshot.gid;
 	if (Rank==0) file << "\n# node count per face" << endl;
-	int count=0;
 	int g;
 	bool write;
 	for (int f=0;f<grid[gid].faceCount;++f) {
@@ -464,18 +604,12 @@ void write_tec_face_node_counts () {
 		}
 	}
 	
-
-	file.close();
-	
 	return;
 }
 			
-void write_tec_face_nodes() {
+void VolumeTecplotJob::write_tec_face_nodes(ostream &file) {
 	
-	ofstream file;
-	string fileName="./volume_output/volume_"+int2str(timeStep)+"_"+int2str(gid+1)+".dat";
-	file.open((fileName).c_str(),ios::app);
-
+	int gid=snapshot.gid;
 	if (Rank==0) file << "# face nodes" << endl;
 	int g;
 	bool write;	
@@ -493,19 +627,14 @@ void write_tec_face_nodes() {
 			file << endl;
 		}
 	}
-				
-	file.close();
 	
 	return;
 	
 }
 
-void write_tec_left() {
+void VolumeTecplotJob::write_tec_left(ostream &file) {
 	
-	ofstream file;
-	string fileName="./volume_output/volume_"+int2str(timeStep)+"_"+int2str(gid+1)+".dat";
-	file.open((fileName).c_str(),ios::app);
-
+	int gid=snapshot.gid;
 	if (Rank==0) file << "# left elements" << endl;
 	int g;
 	bool write;
@@ -519,17 +648,12 @@ void write_tec_left() {
 		if (write) file << grid[gid].face[f].parent+grid[gid].partitionOffset[Rank]+1 << endl;
 	}
 
-	file.close();
-	
 	return;
 }
 
-void write_tec_right() {
+void VolumeTecplotJob::write_tec_right(ostream &file) {
 	
-	ofstream file;
-	string fileName="./volume_output/volume_"+int2str(timeStep)+"_"+int2str(gid+1)+".dat";
-	file.open((fileName).c_str(),ios::app);
-
+	int gid=snapshot.gid;
 	if (Rank==0) file << "# right elements" << endl;
 	int g;
 	bool write;	
@@ -547,17 +671,596 @@ void write_tec_right() {
 		}
 	}
 
-	file.close();
+	return;
+}
+
+VolumeTecplotBinaryJob::VolumeTecplotBinaryJob() {
+	
+	snapshot.take();
+	fileName="./volume_output/"+snapshot.name()+".plt";
+	if (Rank==0) {
+		string link_comm="ln -sf "+fileName+" ./"+snapshot.prefix+"_latest_"+int2str(snapshot.gid+1)+".plt";
+		system(link_comm.c_str());
+	}
+	
+	// The face node offsets continue from the lower ranks
+	int gid=snapshot.gid;
+	int count=0;
+	for (int f=0;f<grid[gid].faceCount;++f) if (write_face(f)) count+=grid[gid].face[f].nodes.size();
+	faceNodeOffset=0;
+	MPI_Exscan(&count,&faceNodeOffset,1,MPI_INT,MPI_SUM,MPI_COMM_WORLD);
+	if (Rank==0) faceNodeOffset=0;
 	
 	return;
 }
 
-void write_vtk(void) {
+bool VolumeTecplotBinaryJob::write_face(int f) {
+	// Partition faces are written by the lower rank
+	int gid=snapshot.gid;
+	if (grid[gid].face[f].bc==PARTITION_FACE) {
+		int g=grid[gid].face[f].neighbor;
+		if (grid[gid].cell[g].partition<Rank) return false;
+	}
+	return true;
+}
+
+void VolumeTecplotBinaryJob::format(void) {
+	
+	int gid=snapshot.gid;
+	vector<string> &varList=snapshot.varList;
+	
+	// Variable names and the ranges, same on all ranks
+	vector<string> names;
+	names.push_back("x"); names.push_back("y"); names.push_back("z");
+	for (int ov=0;ov<varList.size();++ov) {
+		if (snapshot.values[ov].size()==3) {
+			names.push_back(varList[ov]+"_x");
+			names.push_back(varList[ov]+"_y");
+			names.push_back(varList[ov]+"_z");
+		} else if (snapshot.values[ov].size()==1) {
+			names.push_back(varList[ov]);
+		}
+	}
+	int nVars=names.size();
+	vector<int> ranges (nVars);
+	for (int var=0;var<nVars;++var) ranges[var]=new_range();
+	
+	sections.push_back("");
+	if (Rank==0) {
+		string &block=sections.back();
+		// Header
+		block.append("#!TDV112");
+		put_int(block,1); // Byte order
+		put_int(block,0); // Full file type
+		put_string(block,"Grid_"+int2str(gid+1));
+		put_int(block,nVars);
+		for (int var=0;var<nVars;++var) put_string(block,names[var]);
+		// Zone header
+		put_float(block,TECPLOT_ZONE_MARKER);
+		put_string(block,"Grid_"+int2str(gid+1));
+		put_int(block,-1); // Parent zone
+		put_int(block,-1); // Strand id
+		put_double(block,0.); // Solution time
+		put_int(block,-1); // Not used
+		put_int(block,TECPLOT_FEPOLYHEDRON);
+		put_int(block,1); // Specify variable locations
+		for (int var=0;var<nVars;++var) put_int(block,(var<3) ? 0 : 1); // Nodes, then cell centered
+		put_int(block,0); // No raw face neighbors
+		put_int(block,0); // No user defined face neighbor connections
+		put_int(block,grid[gid].globalNodeCount);
+		put_int(block,grid[gid].globalFaceCount);
+		put_int(block,grid[gid].globalNumFaceNodes);
+		put_int(block,0); // Connected boundary faces
+		put_int(block,0); // Boundary connections
+		put_int(block,grid[gid].globalCellCount);
+		for (int i=0;i<3;++i) put_int(block,0); // Cell dimensions, not used
+		put_int(block,0); // No auxiliary data
+		put_float(block,TECPLOT_EOH_MARKER);
+		// Zone data header
+		put_float(block,TECPLOT_ZONE_MARKER);
+		for (int var=0;var<nVars;++var) put_int(block,TECPLOT_DOUBLE);
+		put_int(block,0); // No passive variables
+		put_int(block,0); // No variable sharing
+		put_int(block,-1); // No connectivity sharing
+		put_ranges(block,sections.size()-1,ranges);
+	}
+	
+	// Node coordinates
+	for (int i=0;i<3;++i) {
+		vector<double> data;
+		data.reserve(grid[gid].nodeCount);
+		for (int n=0;n<grid[gid].nodeCount;++n) {
+			// Note that some nodes are repeated in different partitions
+			if (grid[gid].node[n].output_id>=grid[gid].node_output_offset) data.push_back(grid[gid].node[n][i]);
+		}
+		sections.push_back("");
+		put_values(sections.back(),data,ranges[i]);
+	}
+	
+	// Cell variables
+	int var=3;
+	for (int ov=0;ov<varList.size();++ov) {
+		for (int i=0;i<snapshot.values[ov].size();++i) {
+			sections.push_back("");
+			put_values(sections.back(),snapshot.values[ov][i],ranges[var]);
+			vector<double>().swap(snapshot.values[ov][i]);
+			var++;
+		}
+	}
+	
+	// Face connectivity, zero based
+	vector<int> offsets,faceNodes,left,right;
+	if (Rank==0) offsets.push_back(0);
+	int offset=faceNodeOffset;
+	for (int f=0;f<grid[gid].faceCount;++f) {
+		if (!write_face(f)) continue;
+		for (int fn=0;fn<grid[gid].face[f].nodes.size();++fn) faceNodes.push_back(grid[gid].faceNode(f,fn).output_id);
+		offset+=grid[gid].face[f].nodes.size();
+		offsets.push_back(offset);
+		left.push_back(grid[gid].face[f].parent+grid[gid].partitionOffset[Rank]);
+		if (grid[gid].face[f].bc==PARTITION_FACE) {
+			int g=grid[gid].face[f].neighbor;
+			right.push_back(grid[gid].cell[g].id_in_owner+grid[gid].partitionOffset[grid[gid].cell[g].partition]);
+		} else if (grid[gid].face[f].bc>=0) {
+			right.push_back(-1);
+		} else {
+			right.push_back(grid[gid].face[f].neighbor+grid[gid].partitionOffset[Rank]);
+		}
+	}
+	sections.push_back("");
+	put_ints(sections.back(),offsets);
+	sections.push_back("");
+	put_ints(sections.back(),faceNodes);
+	sections.push_back("");
+	put_ints(sections.back(),left);
+	sections.push_back("");
+	put_ints(sections.back(),right);
+	
+	return;
+}
+
+#ifdef HAVE_PCGNS
+void cgns_check(int status) {
+	if (status!=CG_OK) {
+		cerr << "[E] CGNS output failed on rank " << Rank << ": " << cg_get_error() << endl;
+		MPI_Abort(MPI_COMM_WORLD,1);
+	}
+	return;
+}
+
+CGNSLayout::CGNSLayout() {
+	gridWritten=false;
+	cellTotal=0;
+}
+
+// Element type of a cell (index in types) from its faces, and its nodes in CGNS order
+// Returns false if the cell is not a tetra, pyramid, prism or hexa
+bool CGNSLayout::element(int gid,int c,int &t,vector<int> &nodes) {
+	
+	Cell &cell=grid[gid].cell[c];
+	int tri_count=0,quad_count=0,base=-1;
+	for (int cf=0;cf<cell.faces.size();++cf) {
+		int f=cell.faces[cf];
+		if (grid[gid].face[f].nodes.size()==3) {
+			tri_count++;
+			if (quad_count==0) base=f;
+		} else if (grid[gid].face[f].nodes.size()==4) {
+			// Pyramids and hexas are built on a quad
+			if (quad_count==0) base=f;
+			quad_count++;
+		} else return false;
+	}
+	if (tri_count==4 && quad_count==0 && cell.nodes.size()==4) t=0;
+	else if (tri_count==4 && quad_count==1 && cell.nodes.size()==5) t=1;
+	else if (tri_count==2 && quad_count==3 && cell.nodes.size()==6) t=2;
+	else if (tri_count==0 && quad_count==6 && cell.nodes.size()==8) t=3;
+	else return false;
+	// Prisms are built on a triangle
+	if (t==2) {
+		for (int cf=0;cf<cell.faces.size();++cf) if (grid[gid].face[cell.faces[cf]].nodes.size()==3) base=cell.faces[cf];
+	}
+	
+	// The base face comes first, ordered so that its normal points into the cell
+	nodes=grid[gid].face[base].nodes;
+	int base_size=nodes.size();
+	Vec3D p0=grid[gid].node[nodes[0]];
+	Vec3D normal=(grid[gid].node[nodes[1]]-p0).cross(grid[gid].node[nodes[2]]-p0);
+	if (normal.dot(cell.centroid-p0)<0.) reverse(nodes.begin()+1,nodes.end());
+	
+	// Then the apex, or the node across the side edge from each base node
+	int opposite_count=(t<2) ? 1 : base_size;
+	for (int i=0;i<opposite_count;++i) {
+		int opposite=-1;
+		for (int cf=0;cf<cell.faces.size();++cf) {
+			vector<int> &faceNodes=grid[gid].face[cell.faces[cf]].nodes;
+			for (int fn=0;fn<faceNodes.size();++fn) {
+				if (faceNodes[fn]!=nodes[i]) continue;
+				int next=faceNodes[(fn+1)%faceNodes.size()];
+				int previous=faceNodes[(fn+faceNodes.size()-1)%faceNodes.size()];
+				if (find(nodes.begin(),nodes.begin()+base_size,next)==nodes.begin()+base_size) opposite=next;
+				if (find(nodes.begin(),nodes.begin()+base_size,previous)==nodes.begin()+base_size) opposite=previous;
+			}
+		}
+		if (opposite<0 || find(nodes.begin(),nodes.end(),opposite)!=nodes.end()) return false;
+		nodes.push_back(opposite);
+	}
+	
+	return true;
+}
+
+void CGNSLayout::set(int gid) {
+	
+	types.push_back(TETRA_4); sectionNames.push_back("Tetra");
+	types.push_back(PYRA_5); sectionNames.push_back("Pyramid");
+	types.push_back(PENTA_6); sectionNames.push_back("Prism");
+	types.push_back(HEXA_8); sectionNames.push_back("Hexa");
+	
+	localCells.resize(types.size());
+	connectivity.resize(types.size());
+	int unsupported=0;
+	vector<int> nodes;
+	for (int c=0;c<grid[gid].cellCount;++c) {
+		int t;
+		if (!element(gid,c,t,nodes)) {
+			unsupported++;
+			continue;
+		}
+		localCells[t].push_back(c);
+		for (int cn=0;cn<nodes.size();++cn) connectivity[t].push_back(grid[gid].node[nodes[cn]].output_id+1);
+	}
+	
+	// Polyhedra would need NGON_n/NFACE_n sections
+	int globalUnsupported;
+	MPI_Allreduce(&unsupported,&globalUnsupported,1,MPI_INT,MPI_SUM,MPI_COMM_WORLD);
+	if (globalUnsupported>0) {
+		if (Rank==0) cerr << "[E] CGNS volume output only handles tetra, pyramid, prism and hexa cells, grid=" << gid+1 << " has " << globalUnsupported << " other cells. Use the tecplot output format instead" << endl;
+		MPI_Abort(MPI_COMM_WORLD,1);
+	}
+	
+	// Element numbering: sections one after the other, ranks in order within each section
+	vector<cgsize_t> localCounts (types.size()),globalCounts (types.size());
+	for (int t=0;t<types.size();++t) localCounts[t]=localCells[t].size();
+	rankStart.assign(types.size(),0);
+	MPI_Datatype cgsize_type=(sizeof(cgsize_t)==sizeof(int)) ? MPI_INT : MPI_LONG_LONG;
+	MPI_Allreduce(&localCounts[0],&globalCounts[0],types.size(),cgsize_type,MPI_SUM,MPI_COMM_WORLD);
+	MPI_Exscan(&localCounts[0],&rankStart[0],types.size(),cgsize_type,MPI_SUM,MPI_COMM_WORLD);
+	if (Rank==0) rankStart.assign(types.size(),0);
+	
+	// Drop the element types that are not in the grid
+	sectionStart.clear();
+	cgsize_t start=1;
+	for (int t=types.size()-1;t>=0;--t) {
+		if (globalCounts[t]==0) {
+			types.erase(types.begin()+t);
+			sectionNames.erase(sectionNames.begin()+t);
+			rankStart.erase(rankStart.begin()+t);
+			localCells.erase(localCells.begin()+t);
+			connectivity.erase(connectivity.begin()+t);
+			globalCounts.erase(globalCounts.begin()+t);
+		}
+	}
+	sectionEnd.clear();
+	for (int t=0;t<types.size();++t) {
+		sectionStart.push_back(start);
+		rankStart[t]+=start;
+		start+=globalCounts[t];
+		sectionEnd.push_back(start-1);
+	}
+	cellTotal=start-1;
+	
+	return;
+}
+
+void CGNSLayout::write_grid(int gid) {
+	
+	string fileName="./volume_output/grid_"+int2str(gid+1)+".cgns";
+	int fileIndex,baseIndex,zoneIndex,coordIndex,sectionIndex;
+	
+	cgns_check(cgp_mpi_comm(MPI_COMM_WORLD));
+	cgns_check(cgp_open(fileName.c_str(),CG_MODE_WRITE,&fileIndex));
+	cgns_check(cg_base_write(fileIndex,"Base",3,3,&baseIndex));
+	cgsize_t size[3]={grid[gid].globalNodeCount,cellTotal,0};
+	string zoneName="Grid_"+int2str(gid+1);
+	cgns_check(cg_zone_write(fileIndex,baseIndex,zoneName.c_str(),size,Unstructured,&zoneIndex));
+	
+	// Owned nodes have contiguous output ids
+	vector<double> coord;
+	for (int i=0;i<3;++i) {
+		coord.clear();
+		for (int n=0;n<grid[gid].nodeCount;++n) {
+			if (grid[gid].node[n].output_id>=grid[gid].node_output_offset) coord.push_back(grid[gid].node[n][i]);
+		}
+		string coordName="Coordinate";
+		coordName+=char('X'+i);
+		cgsize_t nodeMin=grid[gid].node_output_offset+1;
+		cgsize_t nodeMax=grid[gid].node_output_offset+coord.size();
+		cgns_check(cgp_coord_write(fileIndex,baseIndex,zoneIndex,RealDouble,coordName.c_str(),&coordIndex));
+		cgns_check(cgp_coord_write_data(fileIndex,baseIndex,zoneIndex,coordIndex,&nodeMin,&nodeMax,coord.empty() ? NULL : &coord[0]));
+	}
+	
+	for (int t=0;t<types.size();++t) {
+		cgns_check(cgp_section_write(fileIndex,baseIndex,zoneIndex,sectionNames[t].c_str(),types[t],sectionStart[t],sectionEnd[t],0,&sectionIndex));
+		cgsize_t elemMax=rankStart[t]+localCells[t].size()-1;
+		cgns_check(cgp_elements_write_data(fileIndex,baseIndex,zoneIndex,sectionIndex,rankStart[t],elemMax,connectivity[t].empty() ? NULL : &connectivity[t][0]));
+	}
+	vector<vector<cgsize_t> >().swap(connectivity);
+	
+	cgns_check(cgp_close(fileIndex));
+	gridWritten=true;
+	
+	return;
+}
+
+VolumeCGNSJob::VolumeCGNSJob() {
+	
+	snapshot.take();
+	int gid=snapshot.gid;
+	if (cgns_layout.size()<grid.size()) cgns_layout.resize(grid.size());
+	if (!cgns_layout[gid].gridWritten) {
+		cgns_layout[gid].set(gid);
+		cgns_layout[gid].write_grid(gid);
+	}
+	
+	return;
+}
+
+void VolumeCGNSJob::format(void) {
+	
+	// Reorder the values by section
+	CGNSLayout &layout=cgns_layout[snapshot.gid];
+	vector<string> &varList=snapshot.varList;
+	for (int ov=0;ov<varList.size();++ov) {
+		for (int i=0;i<snapshot.values[ov].size();++i) {
+			string name=varList[ov];
+			if (snapshot.values[ov].size()==3) name+=(i==0) ? "X" : ((i==1) ? "Y" : "Z");
+			names.push_back(name);
+			sectionValues.resize(sectionValues.size()+1);
+			sectionValues.back().resize(layout.types.size());
+			for (int t=0;t<layout.types.size();++t) {
+				for (int k=0;k<layout.localCells[t].size();++k) sectionValues.back()[t].push_back(snapshot.values[ov][i][layout.localCells[t][k]]);
+			}
+			vector<double>().swap(snapshot.values[ov][i]);
+		}
+	}
+	
+	return;
+}
+
+void VolumeCGNSJob::commit(void) {
+	
+	// Parallel CGNS is collective, so this part runs on the main thread
+	int gid=snapshot.gid;
+	CGNSLayout &layout=cgns_layout[gid];
+	string fileName="./volume_output/"+snapshot.name()+".cgns";
+	string gridFileName="grid_"+int2str(gid+1)+".cgns";
+	string zoneName="Grid_"+int2str(gid+1);
+	int fileIndex,baseIndex,zoneIndex,solutionIndex,fieldIndex;
+	
+	cgns_check(cgp_mpi_comm(MPI_COMM_WORLD));
+	cgns_check(cgp_open(fileName.c_str(),CG_MODE_WRITE,&fileIndex));
+	cgns_check(cg_base_write(fileIndex,"Base",3,3,&baseIndex));
+	cgsize_t size[3]={grid[gid].globalNodeCount,layout.cellTotal,0};
+	cgns_check(cg_zone_write(fileIndex,baseIndex,zoneName.c_str(),size,Unstructured,&zoneIndex));
+	
+	// Link to the grid
+	cgns_check(cg_goto(fileIndex,baseIndex,"Zone_t",zoneIndex,"end"));
+	cgns_check(cg_link_write("GridCoordinates",gridFileName.c_str(),("/Base/"+zoneName+"/GridCoordinates").c_str()));
+	for (int t=0;t<layout.types.size();++t) {
+		cgns_check(cg_link_write(layout.sectionNames[t].c_str(),gridFileName.c_str(),("/Base/"+zoneName+"/"+layout.sectionNames[t]).c_str()));
+	}
+	
+	cgns_check(cg_sol_write(fileIndex,baseIndex,zoneIndex,"FlowSolution",CellCenter,&solutionIndex));
+	for (int var=0;var<names.size();++var) {
+		cgns_check(cgp_field_write(fileIndex,baseIndex,zoneIndex,solutionIndex,RealDouble,names[var].c_str(),&fieldIndex));
+		for (int t=0;t<layout.types.size();++t) {
+			vector<double> &data=sectionValues[var][t];
+			cgsize_t cellMin=layout.rankStart[t];
+			cgsize_t cellMax=layout.rankStart[t]+data.size()-1;
+			cgns_check(cgp_field_write_data(fileIndex,baseIndex,zoneIndex,solutionIndex,fieldIndex,&cellMin,&cellMax,data.empty() ? NULL : &data[0]));
+		}
+	}
+	vector<vector<vector<double> > >().swap(sectionValues);
+	
+	cgns_check(cgp_close(fileIndex));
+	
+	return;
+}
+#endif
+
+VolumeVTKJob::VolumeVTKJob() {
+	snapshot.take();
+	filePath="./volume_output/"+snapshot.directory();
+	fileName=filePath+"/grid_" + int2str(snapshot.gid+1) + "_proc_"+int2str(Rank)+".vtu";
+	parallelFileName=filePath+"/grid_"+int2str(snapshot.gid+1)+"_"+snapshot.prefix+"_"+int2str(snapshot.timeStep)+".pvtu";
+	mkdir(filePath.c_str(),S_IRWXU);
+	
+	int gid=snapshot.gid;
+	binary=(input.section("grid",gid).subsection("writeoutput").get_string("vtkencoding")=="binary");
+	compress=(input.section("grid",gid).subsection("writeoutput").get_string("compression")=="zlib");
+#ifndef HAVE_ZLIB
+	if (compress && Rank==0) cerr << "[W] Built without zlib, VTK output is not compressed" << endl;
+	compress=false;
+#endif
+	appended.compress=compress;
+	vector<string> float64List=input.section("grid",gid).subsection("writeoutput").get_stringList("float64variables");
+	coordinates64=false;
+	var_is_float64.assign(snapshot.varList.size(),false);
+	for (int i=0;i<float64List.size();++i) {
+		if (float64List[i]=="coordinates") coordinates64=true;
+		for (int ov=0;ov<snapshot.varList.size();++ov) if (snapshot.varList[ov]==float64List[i]) var_is_float64[ov]=true;
+	}
+}
+
+void VolumeVTKJob::format(void) {
+	ostringstream file;
+	if (binary) write_vtu_binary(file);
+	else write_vtk(file);
+	data=file.str();
+	vector<vector<vector<double> > >().swap(snapshot.values);
+	if (Rank==0) {
+		ostringstream parallelFile;
+		write_vtk_parallel(parallelFile);
+		parallelData=parallelFile.str();
+	}
+	return;
+}
+
+void VolumeVTKJob::write(void) {
+	if (binary) {
+		// XML part, then the raw data in one go
+		ofstream file;
+		file.open((fileName).c_str(),ios::out | ios::binary);
+		file.write(data.data(),data.size());
+		file.write(appended.data.data(),appended.data.size());
+		file << "\n</AppendedData>\n</VTKFile>\n";
+		file.close();
+		string().swap(data);
+		string().swap(appended.data);
+	} else {
+		write_string(fileName,data);
+	}
+	if (Rank==0) write_string(parallelFileName,parallelData);
+	return;
+}
+
+string VolumeVTKJob::float_type(bool float64) {
+	if (!binary) return "Float32";
+	if (float64) return "Float64";
+	return "Float32";
+}
+
+AppendedData::AppendedData() {
+	compress=false;
+}
+
+template <class TYPE>
+void AppendedData::append(vector<TYPE> &values) {
+	append_bytes((const char *) (values.empty() ? NULL : &values[0]),values.size()*sizeof(TYPE));
+	return;
+}
+
+void AppendedData::append_bytes(const char *bytes,unsigned long long size) {
+	
+	if (!compress) {
+		data.append((const char *) &size,sizeof(size));
+		if (size>0) data.append(bytes,size);
+		return;
+	}
+#ifdef HAVE_ZLIB
+	// Header: number of blocks, block size, size of the last block, compressed size of each block
+	unsigned long long blockSize=1<<20;
+	unsigned long long nBlocks=(size+blockSize-1)/blockSize;
+	vector<unsigned long long> header (3+nBlocks);
+	header[0]=nBlocks;
+	header[1]=blockSize;
+	header[2]=(nBlocks==0) ? 0 : size-(nBlocks-1)*blockSize;
+	long long headerPosition=data.size();
+	data.append((const char *) &header[0],header.size()*sizeof(unsigned long long));
+	vector<Bytef> buffer (compressBound(blockSize));
+	for (unsigned long long block=0;block<nBlocks;++block) {
+		uLong blockBytes=(block==nBlocks-1) ? header[2] : blockSize;
+		uLongf compressedBytes=buffer.size();
+		int status=compress2(&buffer[0],&compressedBytes,(const Bytef *) bytes+block*blockSize,blockBytes,Z_BEST_SPEED);
+		if (status!=Z_OK) {
+			// Stored (level 0) blocks are still a valid zlib stream
+			compressedBytes=buffer.size();
+			status=compress2(&buffer[0],&compressedBytes,(const Bytef *) bytes+block*blockSize,blockBytes,Z_NO_COMPRESSION);
+		}
+		if (status!=Z_OK) {
+			cerr << "[E] zlib compression of the volume output failed on rank " << Rank << " (error " << status << ")" << endl;
+			MPI_Abort(MPI_COMM_WORLD,1);
+		}
+		header[3+block]=compressedBytes;
+		data.append((const char *) &buffer[0],compressedBytes);
+	}
+	// Now that the compressed sizes are known
+	data.replace(headerPosition,header.size()*sizeof(unsigned long long),(const char *) &header[0],header.size()*sizeof(unsigned long long));
+#endif
+	return;
+}
+
+void VolumeVTKJob::write_vtu_binary(ostream &file) {
+	
+	int gid=snapshot.gid;
+	vector<string> &varList=snapshot.varList;
+	
+	int one=1;
+	string byteOrder=(*(char *)&one==1) ? "LittleEndian" : "BigEndian";
+	
+	file << "<?xml version=\"1.0\"?>" << endl;
+	file << "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"" << byteOrder << "\" header_type=\"UInt64\"";
+	if (compress) file << " compressor=\"vtkZLibDataCompressor\"";
+	file << ">" << endl;
+	file << "<UnstructuredGrid>" << endl;
+	file << "<Piece NumberOfPoints=\"" << grid[gid].nodeCount << "\" NumberOfCells=\"" << grid[gid].cellCount << "\">" << endl;
+	
+	// Node coordinates
+	file << "<Points>" << endl;
+	file << "<DataArray NumberOfComponents=\"3\" type=\"" << float_type(coordinates64) << "\" format=\"appended\" offset=\"" << appended.data.size() << "\" />" << endl;
+	if (coordinates64) {
+		vector<double> values (3*grid[gid].nodeCount);
+		for (int n=0;n<grid[gid].nodeCount;++n) for (int i=0;i<3;++i) values[3*n+i]=grid[gid].node[n][i];
+		appended.append(values);
+	} else {
+		vector<float> values (3*grid[gid].nodeCount);
+		for (int n=0;n<grid[gid].nodeCount;++n) for (int i=0;i<3;++i) values[3*n+i]=grid[gid].node[n][i];
+		appended.append(values);
+	}
+	file << "</Points>" << endl;
+	
+	// Cell connectivity
+	file << "<Cells>" << endl;
+	vector<int> connectivity,offsets (grid[gid].cellCount);
+	vector<unsigned char> types (grid[gid].cellCount);
+	for (int c=0;c<grid[gid].cellCount;++c) {
+		for (int n=0;n<grid[gid].cell[c].nodes.size();++n) connectivity.push_back(grid[gid].cell[c].nodes[n]);
+		offsets[c]=connectivity.size();
+		if (grid[gid].cell[c].nodes.size()==4) types[c]=10; // Tetra
+		if (grid[gid].cell[c].nodes.size()==8) types[c]=12; // Hexa
+		if (grid[gid].cell[c].nodes.size()==6) types[c]=13; // Prism
+		if (grid[gid].cell[c].nodes.size()==5) types[c]=14; // Pyramid (Wedge)
+	}
+	file << "<DataArray Name=\"connectivity\" type=\"Int32\" format=\"appended\" offset=\"" << appended.data.size() << "\" />" << endl;
+	appended.append(connectivity);
+	file << "<DataArray Name=\"offsets\" type=\"Int32\" format=\"appended\" offset=\"" << appended.data.size() << "\" />" << endl;
+	appended.append(offsets);
+	file << "<DataArray Name=\"types\" type=\"UInt8\" format=\"appended\" offset=\"" << appended.data.size() << "\" />" << endl;
+	appended.append(types);
+	file << "</Cells>" << endl;
+	
+	// Cell variables, vector components are interleaved
+	file << "<CellData>" << endl;
+	for (int ov=0;ov<varList.size();++ov) {
+		if (varList[ov]=="null") continue;
+		int nn=snapshot.values[ov].size();
+		file << "<DataArray Name=\"" << varList[ov] << "\" NumberOfComponents=\"" << nn << "\" type=\"" << float_type(var_is_float64[ov]) << "\" format=\"appended\" offset=\"" << appended.data.size() << "\" />" << endl;
+		if (var_is_float64[ov]) {
+			vector<double> values (nn*grid[gid].cellCount);
+			for (int c=0;c<grid[gid].cellCount;++c) for (int i=0;i<nn;++i) values[nn*c+i]=snapshot.values[ov][i][c];
+			appended.append(values);
+		} else {
+			vector<float> values (nn*grid[gid].cellCount);
+			for (int c=0;c<grid[gid].cellCount;++c) for (int i=0;i<nn;++i) values[nn*c+i]=snapshot.values[ov][i][c];
+			appended.append(values);
+		}
+		// Free each variable as soon as it is packed
+		vector<vector<double> >().swap(snapshot.values[ov]);
+	}
+	file << "</CellData>" << endl;
+	file << "</Piece>" << endl;
+	file << "</UnstructuredGrid>" << endl;
+	file << "<AppendedData encoding=\"raw\">" << endl;
+	file << "_";
+	
+	return;
+}
+
+void VolumeVTKJob::write_vtk(ostream &file) {
+	
+	int gid=snapshot.gid;
+	vector<string> &varList=snapshot.varList;
+	vector<bool> &var_is_vec3d=snapshot.var_is_vec3d;
 	
-	string filePath="./volume_output/"+int2str(timeStep);
-	string fileName=filePath+"/grid_" + int2str(gid+1) + "_proc_"+int2str(Rank)+".vtu";
-	ofstream file;
-	file.open((fileName).c_str(),ios::out);
 	file << "<?xml version=\"1.0\"?>" << endl;
 	file << "<VTKFile type=\"UnstructuredGrid\">" << endl;
 	file << "<UnstructuredGrid>" << endl;
@@ -606,49 +1309,18 @@ void write_vtk(void) {
 	file << "<CellData format=\"ascii\">" << endl;
 	
 	for (int ov=0;ov<varList.size();++ov) {
-		// Loop vector components
+		if (varList[ov]=="null") continue;
 		// Write variable name
 		file << "<DataArray Name=\"" << varList[ov] << "\" ";
-		if (var_is_vec3d[ov]) file << "Number of Components=\"3\" ";
+		if (var_is_vec3d[ov]) file << "NumberOfComponents=\"3\" ";
 
 		file << "type=\"Float32\" format=\"ascii\" >" << endl;
-
-		if (varList[ov]=="p")             for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].p.cell(c) << endl;
-		else if (varList[ov]=="T")        for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].T.cell(c) << endl;
-		else if (varList[ov]=="rho")      for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].material.rho(ns[gid].p.cell(c),ns[gid].T.cell(c)) << endl;
-		else if (varList[ov]=="dt")       for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].T.cell(c) << endl;
-		else if (varList[ov]=="mu")       for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].material.viscosity(ns[gid].T.cell(c)) << endl;
-		else if (varList[ov]=="lambda")   for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].material.therm_cond(ns[gid].T.cell(c)) << endl;	
-		else if (varList[ov]=="Cp")       for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].material.Cp(ns[gid].T.cell(c)) << endl;
-		else if (varList[ov]=="resp")     for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].update[0].cell(c) << endl;
-		else if (varList[ov]=="resT")     for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].update[4].cell(c) << endl;
-		else if (varList[ov]=="limiterp") for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].limiter[0].cell(c) << endl; 
-		else if (varList[ov]=="limiterT") for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].limiter[4].cell(c) << endl;
-		else if (varList[ov]=="k")        for (int c=0;c<grid[gid].cellCount;++c) file << rans[gid].k.cell(c) << endl;
-		else if (varList[ov]=="omega")    for (int c=0;c<grid[gid].cellCount;++c) file << rans[gid].omega.cell(c) << endl;
-		else if (varList[ov]=="mu_t")     for (int c=0;c<grid[gid].cellCount;++c) file << rans[gid].mu_t.cell(c) << endl;
-		else if (varList[ov]=="Mach") {
-			for (int c=0;c<grid[gid].cellCount;++c) file << fabs(ns[gid].V.cell(c))/ns[gid].material.a(ns[gid].p.cell(c),ns[gid].T.cell(c)) << endl;
-		}
-		else if (varList[ov]=="rank")     for (int c=0;c<grid[gid].cellCount;++c) file << Rank << endl;
-		// Vectors
-		else if (varList[ov]=="V")       { for (int c=0;c<grid[gid].cellCount;++c) {  for (int i=0;i<3;++i) { file << ns[gid].V.cell(c)[i]     << " "; } file << endl;}} 
-		else if (varList[ov]=="gradp")   { for (int c=0;c<grid[gid].cellCount;++c) {  for (int i=0;i<3;++i) { file << ns[gid].gradp.cell(c)[i] << " "; } file << endl;}}
-		else if (varList[ov]=="gradu")   { for (int c=0;c<grid[gid].cellCount;++c) {  for (int i=0;i<3;++i) { file << ns[gid].gradu.cell(c)[i] << " "; } file << endl;}}
-		else if (varList[ov]=="gradv")   { for (int c=0;c<grid[gid].cellCount;++c) {  for (int i=0;i<3;++i) { file << ns[gid].gradv.cell(c)[i] << " "; } file << endl;}}
-		else if (varList[ov]=="gradw")   { for (int c=0;c<grid[gid].cellCount;++c) {  for (int i=0;i<3;++i) { file << ns[gid].gradw.cell(c)[i] << " "; } file << endl;}}
-		else if (varList[ov]=="gradT") {
-			if (equations[gid]==NS) {
-				for (int c=0;c<grid[gid].cellCount;++c) { for (int i=0;i<3;++i) { file << ns[gid].gradT.cell(c)[i] << " "; } file << endl;}
-			} else if (equations[gid]==HEAT) {
-				for (int c=0;c<grid[gid].cellCount;++c) { for (int i=0;i<3;++i) { file << hc[gid].gradT.cell(c)[i] << " "; } file << endl;}
-			}
-		}				
-		else if (varList[ov]=="gradrho")   { for (int c=0;c<grid[gid].cellCount;++c) { for (int i=0;i<3;++i) { file << ns[gid].rho.cell_gradient(c)[i]  << " "; } file << endl;}}
-		else if (varList[ov]=="resV")      { for (int c=0;c<grid[gid].cellCount;++c) { for (int i=0;i<3;++i) { file << ns[gid].update[1+i].cell(c)      << " "; } file << endl;}}
-		else if (varList[ov]=="limiterV")  { for (int c=0;c<grid[gid].cellCount;++c) { for (int i=0;i<3;++i) { file << ns[gid].limiter[1+i].cell(c)     << " "; } file << endl;}}
-		else if (varList[ov]=="gradk")     { for (int c=0;c<grid[gid].cellCount;++c) { for (int i=0;i<3;++i) { file << rans[gid].gradk.cell(c)[i]       << " "; } file << endl;}}
-		else if (varList[ov]=="gradomega") { for (int c=0;c<grid[gid].cellCount;++c) { for (int i=0;i<3;++i) { file << rans[gid].gradomega.cell(c)[i]   << " "; } file << endl;}}	
+		
+		if (var_is_vec3d[ov]) {
+			for (int c=0;c<grid[gid].cellCount;++c) { for (int i=0;i<3;++i) { file << snapshot.values[ov][i][c] << " "; } file << endl;}
+		} else {
+			for (int c=0;c<grid[gid].cellCount;++c) file << snapshot.values[ov][0][c] << endl;
+		}
 		file << "</DataArray>" << endl;
 	}
 	
@@ -656,54 +1328,79 @@ void write_vtk(void) {
 	file << "</Piece>" << endl;
 	file << "</UnstructuredGrid>" << endl;
 	file << "</VTKFile>" << endl;
-	file.close();
 
 	return;
 }
 
-void write_vtk_parallel(void) {
+void VolumeVTKJob::write_vtk_parallel(ostream &file) {
 	
-	string filePath="./volume_output/"+int2str(timeStep);
-	string fileName=filePath+"/grid_"+int2str(gid+1)+"_volume_"+int2str(timeStep)+".pvtu";
-	
-	mkdir("./volume_output",S_IRWXU);
-	mkdir(filePath.c_str(),S_IRWXU);
+	int gid=snapshot.gid;
+	vector<string> &varList=snapshot.varList;
+	vector<bool> &var_is_vec3d=snapshot.var_is_vec3d;
 	
-	ofstream file;
-	file.open((fileName).c_str(),ios::out);
 	file << "<?xml version=\"1.0\"?>" << endl;
 	file << "<VTKFile type=\"PUnstructuredGrid\">" << endl;
 	file << "<PUnstructuredGrid GhostLevel=\"0\">" << endl;
 	file << "<PPoints>" << endl;
-	file << "<DataArray NumberOfComponents=\"3\" type=\"Float32\" format=\"ascii\" />" << endl;
+	file << "<PDataArray NumberOfComponents=\"3\" type=\"" << float_type(coordinates64) << "\" />" << endl;
 	file << "</PPoints>" << endl;
 	
-	file << "<PCellData format=\"ascii\">" << endl;
+	file << "<PCellData>" << endl;
 	
 	for (int ov=0;ov<varList.size();++ov) {
-		// Loop vector components
+		if (varList[ov]=="null") continue;
 		// Write variable name
-		file << "<DataArray Name=\"" << varList[ov] << "\" ";
-		if (var_is_vec3d[ov]) file << "Number of Components=\"3\" ";
+		file << "<PDataArray Name=\"" << varList[ov] << "\" ";
+		if (var_is_vec3d[ov]) file << "NumberOfComponents=\"3\" ";
 
-		file << "type=\"Float32\" format=\"ascii\" >" << endl;
+		file << "type=\"" << float_type(var_is_float64[ov]) << "\" />" << endl;
 	}
 	
 	file << "</PCellData>" << endl;
 	for (int p=0;p<np;++p) file << "<Piece Source=\"grid_" << gid+1 << "_proc_" << int2str(p) << ".vtu\" />" << endl;
 	file << "</PUnstructuredGrid>" << endl;
 	file << "</VTKFile>" << endl;
-	file.close();
 
 	return;
 }
 
-void write_vtk_legacy(void) {
+VolumeVTKLegacyJob::VolumeVTKLegacyJob() {
+	snapshot.take();
+	filePath="./volume_output/"+snapshot.directory();
+	fileName=filePath+"/grid_" + int2str(snapshot.gid+1) + "_proc_"+int2str(Rank)+".vtk";
+	visitFileName="./volume_output/"+snapshot.name()+".visit";
+	mkdir(filePath.c_str(),S_IRWXU);
+	if (Rank==0) {
+		string link_comm="ln -sf ./"+snapshot.name()+".visit ./volume_output/"+snapshot.prefix+"_latest_"+int2str(snapshot.gid+1)+".visit";
+		system(link_comm.c_str());
+	}
+}
+
+void VolumeVTKLegacyJob::format(void) {
+	ostringstream file;
+	write_vtk_legacy(file);
+	data=file.str();
+	vector<vector<vector<double> > >().swap(snapshot.values);
+	if (Rank==0) {
+		ostringstream visitFile;
+		write_visit_parallel(visitFile);
+		visitData=visitFile.str();
+	}
+	return;
+}
+
+void VolumeVTKLegacyJob::write(void) {
+	write_string(fileName,data);
+	if (Rank==0) write_string(visitFileName,visitData);
+	return;
+}
+
+void VolumeVTKLegacyJob::write_vtk_legacy(ostream &file) {
+	
+	int gid=snapshot.gid;
+	vector<string> &varList=snapshot.varList;
+	vector<bool> &var_is_vec3d=snapshot.var_is_vec3d;
 	
-	string filePath="./volume_output/"+int2str(timeStep);
-	string fileName=filePath+"/grid_" + int2str(gid+1) + "_proc_"+int2str(Rank)+".vtk";
-	ofstream file;
-	file.open((fileName).c_str(),ios::out);
 	file << "# vtk DataFile Version 2.0" << endl;
 	file << "Grid_" << gid+1 << endl;
 	file << "ASCII" << endl;
@@ -731,79 +1428,31 @@ void write_vtk_legacy(void) {
 
 	
 	for (int ov=0;ov<varList.size();++ov) {
+		if (varList[ov]=="null") continue;
 		int iend=1;
-                if (var_is_vec3d[ov]) iend=3;
+		if (var_is_vec3d[ov]) iend=3;
 		
 		for (int i=0;i<iend;++i) {
 			string varName=varList[ov];
 			if (var_is_vec3d[ov]) {
-	                        if (i==0) varName+="_x";
-        	                if (i==1) varName+="_y";
-                	        if (i==2) varName+="_z";
+				if (i==0) varName+="_x";
+				if (i==1) varName+="_y";
+				if (i==2) varName+="_z";
 			}
 			file << "SCALARS " << varName << " double" << endl;
 			file << "LOOKUP_TABLE default" << endl;
-	
-			if (varList[ov]=="p")              for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].p.cell(c) << endl;
-			else if (varList[ov]=="T")         for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].T.cell(c) << endl;
-			else if (varList[ov]=="rho")       for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].material.rho(ns[gid].p.cell(c),ns[gid].T.cell(c)) << endl;
-			else if (varList[ov]=="dt")        for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].T.cell(c) << endl;
-			else if (varList[ov]=="mu")        for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].material.viscosity(ns[gid].T.cell(c)) << endl;
-			else if (varList[ov]=="lambda")    for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].material.therm_cond(ns[gid].T.cell(c)) << endl;	
-			else if (varList[ov]=="Cp")        for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].material.Cp(ns[gid].T.cell(c)) << endl;
-			else if (varList[ov]=="resp")      for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].update[0].cell(c) << endl;
-			else if (varList[ov]=="resT")      for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].update[4].cell(c) << endl;
-			else if (varList[ov]=="limiterp")  for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].limiter[0].cell(c) << endl; 
-			else if (varList[ov]=="limiterT")  for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].limiter[4].cell(c) << endl;
-			else if (varList[ov]=="k")         for (int c=0;c<grid[gid].cellCount;++c) file << rans[gid].k.cell(c) << endl;
-			else if (varList[ov]=="omega")     for (int c=0;c<grid[gid].cellCount;++c) file << rans[gid].omega.cell(c) << endl;
-			else if (varList[ov]=="mu_t")      for (int c=0;c<grid[gid].cellCount;++c) file << rans[gid].mu_t.cell(c) << endl;
-			else if (varList[ov]=="rank")      for (int c=0;c<grid[gid].cellCount;++c) file << Rank << endl;
-			// Vectors
-			else if (varList[ov]=="V")         for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].V.cell(c)[i]            << endl; 
-			else if (varList[ov]=="gradp")     for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].gradp.cell(c)[i]        << endl;
-			else if (varList[ov]=="gradu")     for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].gradu.cell(c)[i]        << endl;
-			else if (varList[ov]=="gradv")     for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].gradv.cell(c)[i]        << endl;
-			else if (varList[ov]=="gradw")     for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].gradw.cell(c)[i]        << endl;
-			else if (varList[ov]=="gradrho")   for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].rho.cell_gradient(c)[i] << endl;
-			else if (varList[ov]=="resV")      for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].update[1+i].cell(c)     << endl;
-			else if (varList[ov]=="limiterV")  for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].limiter[1+i].cell(c)    << endl;
-			else if (varList[ov]=="gradk")     for (int c=0;c<grid[gid].cellCount;++c) file << rans[gid].gradk.cell(c)[i]      << endl;
-			else if (varList[ov]=="gradomega") for (int c=0;c<grid[gid].cellCount;++c) file << rans[gid].gradomega.cell(c)[i]  << endl;	
-			else if (varList[ov]=="gradT") {
-		          if (equations[gid]==NS) {
-					                   for (int c=0;c<grid[gid].cellCount;++c) file << ns[gid].gradT.cell(c)[i] << endl;
-			  } else if (equations[gid]==HEAT) {
-				                           for (int c=0;c<grid[gid].cellCount;++c) file << hc[gid].gradT.cell(c)[i] << endl;
-			  }
-			}
-			else if (varList[ov]=="Mach") {
-                                                           for (int c=0;c<grid[gid].cellCount;++c) file << fabs(ns[gid].V.cell(c))/ns[gid].material.a(ns[gid].p.cell(c),ns[gid].T.cell(c)) << endl;
-			}
+			for (int c=0;c<grid[gid].cellCount;++c) file << snapshot.values[ov][i][c] << endl;
 		}
 	}
 	
-	file.close();
-
 	return;
 }
 
-void write_visit_parallel(void) {
-	
-	string filePath="./volume_output/"+int2str(timeStep);
-	string fileName="./volume_output/volume_"+int2str(timeStep)+"_"+int2str(gid+1)+".visit";
-	mkdir("./volume_output",S_IRWXU);
-	mkdir(filePath.c_str(),S_IRWXU);
-
-	string link_comm="ln -sf ./volume_"+int2str(timeStep)+"_"+int2str(gid+1)+".visit ./volume_output/volume_latest_"+int2str(gid+1)+".visit";
-	system(link_comm.c_str());
+void VolumeVTKLegacyJob::write_visit_parallel(ostream &file) {
 	
-	ofstream file;
-	file.open((fileName).c_str(),ios::out);
+	int gid=snapshot.gid;
 	file << "!NBLOCKS " << np << endl;
-	for(int p=0;p<np;++p) file << "./" << int2str(timeStep) << "/grid_" + int2str(gid+1) + "_proc_"+int2str(p)+".vtk" << endl;
-	file.close();
+	for(int p=0;p<np;++p) file << "./" << snapshot.directory() << "/grid_" + int2str(gid+1) + "_proc_"+int2str(p)+".vtk" << endl;
 
 	return;
 }
-